@@ -1,15 +1,286 @@
 #pragma once
 // vibe coded
 
+#include <cstdint>
 #include <cstdlib>
 #include <new>
 #include <limits>
 #include <memory>
 #include <type_traits>
 
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <vector>
+
+#if !defined(__EMSCRIPTEN__)
+#include <thread>
+#endif
+
 #if defined(_WIN32) || defined(_WIN64)
 #include <malloc.h>
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Raw 2 MiB aligned blocks for arenas that grow. On Linux these are anonymous
+// mappings and growing moves the pages with mremap instead of copying them,
+// elsewhere it is aligned malloc + memcpy.
+constexpr std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+// Linux only. THP is asked for with MADV_HUGEPAGE, with hugetlb the
+// mapping comes from the reserved pool (vm.nr_hugepages) and falls back to
+// THP when that is empty. Prefaulting touches every page of fresh memory
+// up front, split over threads, so the first tick does not pay for faults.
+struct HugePageConfig {
+    bool hugetlb = false;
+    bool prefault = true;
+    unsigned threads = 0;  // 0 for all cores
+};
+inline HugePageConfig huge_page_config;
+
+// NUMA node new mappings made by this thread prefer, -1 for the default
+// policy. Set by the workers that own a node's share of the asteroids.
+inline thread_local int huge_page_node = -1;
+
+// writes a zero to every 4 KiB page of [p, p + bytes), memory must be fresh
+static inline void huge_page_prefault(void* p, std::size_t bytes) {
+    constexpr std::size_t PAGE = 4096;
+    auto touch = [p](std::size_t begin, std::size_t end) {
+        auto base = static_cast<volatile char*>(p);
+        for (std::size_t i = begin; i < end; i += PAGE) base[i] = 0;
+    };
+#if defined(__EMSCRIPTEN__)
+    touch(0, bytes);
+#else
+    unsigned threads = huge_page_config.threads;
+    if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+    // whole huge pages per thread so no two threads fault the same one
+    std::size_t per = (bytes / threads + HUGE_PAGE_SIZE - 1) &
+                      ~(HUGE_PAGE_SIZE - 1);
+    if (threads == 1 || bytes <= per) {
+        touch(0, bytes);
+        return;
+    }
+    std::vector<std::thread> workers;
+    for (std::size_t begin = 0; begin < bytes; begin += per)
+        workers.emplace_back(touch, begin, std::min(bytes, begin + per));
+    for (auto& w : workers) w.join();
+#endif
+}
+
+#ifdef __linux__
+// mbind(MPOL_PREFERRED) by hand so there is no libnuma dependency. Must run
+// before the pages are touched, the prefault then lands them on the node.
+static inline void huge_page_bind(void* p, std::size_t bytes) {
+    constexpr int MPOL_PREFERRED_ = 1;
+    constexpr unsigned MAX_NODES = 1024;
+    const int node = huge_page_node;
+    if (node < 0 || unsigned(node) >= MAX_NODES) return;
+    unsigned long mask[MAX_NODES / (8 * sizeof(unsigned long))] = {};
+    mask[node / (8 * sizeof(unsigned long))] |=
+        1ul << (node % (8 * sizeof(unsigned long)));
+    // the kernel drops the last bit of maxnode
+    syscall(SYS_mbind, p, bytes, MPOL_PREFERRED_, mask, MAX_NODES + 1, 0u);
+}
+
+// 2 MiB aligned mapping: over-map by one huge page and trim both ends
+static inline void* huge_page_map(std::size_t bytes) {
+#ifdef MAP_HUGETLB
+    if (huge_page_config.hugetlb) {
+        void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            huge_page_bind(p, bytes);
+            return p;
+        }
+        static bool warned = false;
+        if (!warned)
+            fprintf(stderr, "hugetlb: mmap failed, falling back to THP\n");
+        warned = true;
+    }
+#endif
+    std::size_t padded = bytes + HUGE_PAGE_SIZE;
+    void* raw = mmap(nullptr, padded, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) throw std::bad_alloc();
+    auto begin = reinterpret_cast<std::uintptr_t>(raw);
+    auto aligned = (begin + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    if (aligned > begin) munmap(raw, aligned - begin);
+    std::size_t tail = begin + padded - (aligned + bytes);
+    if (tail) munmap(reinterpret_cast<void*>(aligned + bytes), tail);
+    madvise(reinterpret_cast<void*>(aligned), bytes, MADV_HUGEPAGE);
+    huge_page_bind(reinterpret_cast<void*>(aligned), bytes);
+    return reinterpret_cast<void*>(aligned);
+}
+#endif
+
+// Blocks of a huge page or more are whole huge pages. Smaller ones are
+// plain aligned malloc, so a small vector does not pin 2 MiB of RSS.
+constexpr std::size_t SMALL_BLOCK_ALIGNMENT = 64;
+
+static inline bool huge_page_block(std::size_t bytes) {
+    return bytes >= HUGE_PAGE_SIZE;
+}
+
+static inline std::size_t huge_page_round(std::size_t bytes) {
+    return (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+}
+
+static inline void* small_block_alloc(std::size_t bytes) {
+#if defined(_WIN32) || defined(_WIN64)
+    void* p = _aligned_malloc(bytes, SMALL_BLOCK_ALIGNMENT);
+    if (!p) throw std::bad_alloc();
+    return p;
+#else
+    void* p = nullptr;
+    if (posix_memalign(&p, SMALL_BLOCK_ALIGNMENT, bytes))
+        throw std::bad_alloc();
+    return p;
+#endif
+}
+
+static inline void small_block_free(void* p) noexcept {
+#if defined(_WIN32) || defined(_WIN64)
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+static inline void* huge_page_alloc(std::size_t bytes) {
+    if (!bytes) return nullptr;
+    if (!huge_page_block(bytes)) return small_block_alloc(bytes);
+    bytes = huge_page_round(bytes);
+#ifdef __linux__
+    void* p = huge_page_map(bytes);
+    if (huge_page_config.prefault) huge_page_prefault(p, bytes);
+    return p;
+#elif defined(_WIN32) || defined(_WIN64)
+    void* p = _aligned_malloc(bytes, HUGE_PAGE_SIZE);
+    if (!p) throw std::bad_alloc();
+    return p;
+#else
+    void* p = nullptr;
+    if (posix_memalign(&p, HUGE_PAGE_SIZE, bytes)) throw std::bad_alloc();
+    return p;
+#endif
+}
+
+static inline void huge_page_free(void* p, std::size_t bytes) noexcept {
+    if (!p) return;
+    if (!huge_page_block(bytes)) {
+        small_block_free(p);
+        return;
+    }
+#ifdef __linux__
+    munmap(p, huge_page_round(bytes));
+#elif defined(_WIN32) || defined(_WIN64)
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+// Keeps the first min(old_bytes, new_bytes) bytes.
+static inline void* huge_page_realloc(void* p, std::size_t old_bytes,
+                                      std::size_t new_bytes) {
+    if (!p) return huge_page_alloc(new_bytes);
+    if (!new_bytes) {
+        huge_page_free(p, old_bytes);
+        return nullptr;
+    }
+    // to, from or between small blocks
+    if (!huge_page_block(old_bytes) || !huge_page_block(new_bytes)) {
+        void* q = huge_page_alloc(new_bytes);
+        std::memcpy(q, p, old_bytes < new_bytes ? old_bytes : new_bytes);
+        huge_page_free(p, old_bytes);
+        return q;
+    }
+    old_bytes = huge_page_round(old_bytes);
+    new_bytes = huge_page_round(new_bytes);
+    if (old_bytes == new_bytes) return p;
+#ifdef __linux__
+    if (new_bytes < old_bytes) {
+        munmap(static_cast<char*>(p) + new_bytes, old_bytes - new_bytes);
+        return p;
+    }
+    // try in place first, then move the pages over into a fresh aligned
+    // mapping (MREMAP_FIXED replaces its head), no copy either way
+    void* q = mremap(p, old_bytes, new_bytes, 0);
+    if (q == MAP_FAILED) {
+        q = huge_page_map(new_bytes);
+        if (mremap(p, old_bytes, old_bytes, MREMAP_MAYMOVE | MREMAP_FIXED,
+                   q) == MAP_FAILED) {
+            std::memcpy(q, p, old_bytes);
+            munmap(p, old_bytes);
+        }
+    }
+    // only the new tail is fresh
+    if (huge_page_config.prefault)
+        huge_page_prefault(static_cast<char*>(q) + old_bytes,
+                           new_bytes - old_bytes);
+    return q;
+#else
+    void* q = huge_page_alloc(new_bytes);
+    std::memcpy(q, p, old_bytes < new_bytes ? old_bytes : new_bytes);
+    huge_page_free(p, old_bytes);
+    return q;
 #endif
+}
+
+struct HugePageCoverage {
+    std::size_t bytes = 0;       // resident bytes of the range
+    std::size_t huge_bytes = 0;  // of those, backed by huge pages
+    double fraction() const { return bytes ? double(huge_bytes) / bytes : 0; }
+};
+
+// What [p, p + bytes) actually got, from /proc/self/smaps: AnonHugePages for
+// THP, the *_Hugetlb fields for hugetlb mappings. Mappings that only partly
+// overlap the range are counted in proportion. Empty elsewhere.
+static inline HugePageCoverage huge_page_coverage(const void* p,
+                                                  std::size_t bytes) {
+    HugePageCoverage cov;
+#ifdef __linux__
+    FILE* f = fopen("/proc/self/smaps", "r");
+    if (!f) return cov;
+    auto lo = reinterpret_cast<std::uintptr_t>(p);
+    auto hi = lo + bytes;
+    char line[512];
+    double share = 0;
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long long a, b, kb;
+        // mapping header, the fields that follow belong to it
+        if (sscanf(line, "%llx-%llx ", &a, &b) == 2) {
+            auto start = std::max(std::uintptr_t(a), lo);
+            auto end = std::min(std::uintptr_t(b), hi);
+            share = end > start ? double(end - start) / double(b - a) : 0;
+            continue;
+        }
+        if (!share) continue;
+        if (sscanf(line, "Rss: %llu kB", &kb) == 1)
+            cov.bytes += std::size_t(kb * 1024 * share);
+        else if (sscanf(line, "AnonHugePages: %llu kB", &kb) == 1)
+            cov.huge_bytes += std::size_t(kb * 1024 * share);
+        // hugetlb pages are not in Rss
+        else if (sscanf(line, "Private_Hugetlb: %llu kB", &kb) == 1 ||
+                 sscanf(line, "Shared_Hugetlb: %llu kB", &kb) == 1) {
+            cov.bytes += std::size_t(kb * 1024 * share);
+            cov.huge_bytes += std::size_t(kb * 1024 * share);
+        }
+    }
+    fclose(f);
+#endif
+    return cov;
+}
 
 template<typename T>
 class HugePageAllocator {
@@ -30,13 +301,11 @@ public:
 
     pointer allocate(size_type n) {
         if (n == 0) return nullptr;
-        // compute requested bytes
-        const std::size_t bytes = n * sizeof(T);
-        return static_cast<pointer>(allocate_bytes(bytes));
+        return static_cast<pointer>(huge_page_alloc(n * sizeof(T)));
     }
 
-    void deallocate(pointer p, size_type /*n*/) noexcept {
-        free_bytes(static_cast<void*>(p));
+    void deallocate(pointer p, size_type n) noexcept {
+        huge_page_free(static_cast<void*>(p), n * sizeof(T));
     }
 
     // object construction helpers (C++17: not required by allocator concept but useful)
@@ -54,35 +323,113 @@ public:
     bool operator==(const HugePageAllocator&) const noexcept { return true; }
     bool operator!=(const HugePageAllocator& a) const noexcept { return !operator==(a); }
 
-private:
-    static constexpr std::size_t ALIGNMENT = 2 * 1024 * 1024; // 2 MiB
-    static_assert((ALIGNMENT& (ALIGNMENT - 1)) == 0, "ALIGNMENT must be power of two");
+};
 
-    static void* allocate_bytes(std::size_t bytes) {
-        if (bytes == 0) return nullptr;
+// Address space reserved up front and committed in slabs as an array grows,
+// so its elements never move. Linux and Windows only, elsewhere reserving
+// fails and SlabArray copies instead.
+static inline void* slab_reserve(std::size_t bytes) {
+#ifdef __linux__
+    void* p = mmap(nullptr, bytes, PROT_NONE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return p == MAP_FAILED ? nullptr : p;
+#elif defined(_WIN32) || defined(_WIN64)
+    return VirtualAlloc(nullptr, bytes, MEM_RESERVE, PAGE_NOACCESS);
+#else
+    (void)bytes;
+    return nullptr;
+#endif
+}
 
-        // POSIX path: prefer posix_memalign (doesn't require size multiple)
-#if defined(_WIN32) || defined(_WIN64)
-        void* p = _aligned_malloc(bytes, ALIGNMENT);
-        if (!p) throw std::bad_alloc();
-        return p;
+static inline void slab_commit(void* p, std::size_t bytes) {
+#ifdef __linux__
+    if (mprotect(p, bytes, PROT_READ | PROT_WRITE)) throw std::bad_alloc();
+#elif defined(_WIN32) || defined(_WIN64)
+    if (!VirtualAlloc(p, bytes, MEM_COMMIT, PAGE_READWRITE))
+        throw std::bad_alloc();
 #else
-        void* p = nullptr;
-        int res = posix_memalign(&p, ALIGNMENT, bytes);
-        if (res != 0) {
-            // posix_memalign returns error code (EINVAL, ENOMEM)
-            throw std::bad_alloc();
-        }
-        return p;
+    (void)p, (void)bytes;
 #endif
-    }
+}
 
-    static void free_bytes(void* p) noexcept {
-        if (!p) return;
-#if defined(_WIN32) || defined(_WIN64)
-        _aligned_free(p);
+static inline void slab_release(void* p, std::size_t bytes) noexcept {
+#ifdef __linux__
+    munmap(p, bytes);
+#elif defined(_WIN32) || defined(_WIN64)
+    (void)bytes;
+    VirtualFree(p, 0, MEM_RELEASE);
 #else
-        free(p);
+    (void)p, (void)bytes;
 #endif
+}
+
+// An array of trivially copyable T in SLAB_BYTES slabs, one after the other
+// in a range of RESERVE_BYTES reserved when the first one is committed.
+// Element i is data()[i] whatever the size, growing commits the next slab
+// and copies nothing, so pointers into it stay valid, and a small array
+// costs one slab. Without slab_reserve it grows like a vector.
+template <typename T>
+class SlabArray {
+    static_assert(std::is_trivially_copyable_v<T>, "slabs are memcpy'd");
+
+   public:
+    static constexpr std::size_t SLAB_BYTES = 16 * 1024;
+    static constexpr std::size_t RESERVE_BYTES = std::size_t(1) << 30;
+
+    SlabArray() = default;
+    SlabArray(const SlabArray& other) { *this = other; }
+    SlabArray& operator=(const SlabArray& other) {
+        if (this == &other) return *this;
+        resize(other.size_);
+        if (size_) std::memcpy(data_, other.data_, size_ * sizeof(T));
+        return *this;
     }
-};
\ No newline at end of file
+    ~SlabArray() {
+        if (reserved_)
+            slab_release(data_, RESERVE_BYTES);
+        else
+            std::free(data_);
+    }
+
+    T* data() noexcept { return data_; }
+    const T* data() const noexcept { return data_; }
+    std::size_t size() const noexcept { return size_; }
+    T& operator[](std::size_t i) noexcept { return data_[i]; }
+    const T& operator[](std::size_t i) const noexcept { return data_[i]; }
+    // what the array holds on to
+    std::size_t committed_bytes() const noexcept { return committed_; }
+
+    // new elements are zero
+    void resize(std::size_t n) {
+        std::size_t bytes =
+            (n * sizeof(T) + SLAB_BYTES - 1) / SLAB_BYTES * SLAB_BYTES;
+        if (bytes > committed_) grow(bytes);
+        if (n > size_)
+            std::memset(static_cast<void*>(data_ + size_), 0,
+                        (n - size_) * sizeof(T));
+        size_ = n;
+    }
+
+   private:
+    void grow(std::size_t bytes) {
+        if (!data_) {
+            data_ = static_cast<T*>(slab_reserve(RESERVE_BYTES));
+            reserved_ = data_ != nullptr;
+        }
+        if (reserved_) {
+            if (bytes > RESERVE_BYTES) throw std::bad_alloc();
+            slab_commit(reinterpret_cast<char*>(data_) + committed_,
+                        bytes - committed_);
+        } else {
+            void* p = std::realloc(data_, bytes);
+            if (!p) throw std::bad_alloc();
+            data_ = static_cast<T*>(p);
+        }
+        committed_ = bytes;
+    }
+
+    T* data_ = nullptr;
+    std::size_t size_ = 0;
+    std::size_t committed_ = 0;
+    bool reserved_ = false;
+};
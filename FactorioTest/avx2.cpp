@@ -1,10 +1,19 @@
 #include <immintrin.h>
 
+#include <cstddef>
+#include <cstring>
 #include <iostream>
 #include <memory>
 
 #include "fpm/ios.hpp"
+#include "blocks.hpp"
+#include "compaction.hpp"
 #include "map.hpp"
+#include "quantized.hpp"
+#include "rng.hpp"
+#include "simd_check.hpp"
+#include "spawn.hpp"
+#include "tick.hpp"
 
 using namespace std;
 
@@ -14,191 +23,341 @@ using namespace std;
 #define ASSUME_ALIGNED(ptr, N) (ptr)
 #endif
 
-static inline __m256i div32(__m256i val) {
-    return _mm256_srai_epi32(val, 5);  // divide by 32
-}
+// tick.hpp backend, 8 lanes. Masks are full lanes, tile bits are looked up
+// lane by lane, which beats vpgatherdd here.
+struct Avx2Simd {
+    static constexpr uint32_t LANES = 8;
+    using I32 = __m256i;
+    using Mask = __m256i;
 
-static inline __m256i mod32(__m256i val) {
-    __m256i mask = _mm256_set1_epi32(31);          // 0b11111
-    __m256i result = _mm256_and_si256(val, mask);  // val & 31
-    result = _mm256_add_epi32(result, _mm256_set1_epi32(32));
-    result = _mm256_and_si256(result, mask);  // wrap around to [0,31]
-    return result;
-}
+    static I32 set1(int32_t v) { return _mm256_set1_epi32(v); }
+    static I32 load(const fixed_20_11* p) {
+        return _mm256_load_si256((const __m256i*)p);
+    }
+    static I32 load(const fixed_4_11* p) {
+        return _mm256_cvtepi16_epi32(_mm_load_si128((const __m128i*)p));
+    }
+    static I32 load(const uint32_t* p) {
+        return _mm256_load_si256((const __m256i*)p);
+    }
+    static void store(fixed_20_11* p, I32 v) {
+        _mm256_store_si256((__m256i*)p, v);
+    }
 
-static uint32_t tick = 0;
+    static I32 add(I32 a, I32 b) { return _mm256_add_epi32(a, b); }
+    static I32 sub(I32 a, I32 b) { return _mm256_sub_epi32(a, b); }
+    static I32 mullo(I32 a, I32 b) { return _mm256_mullo_epi32(a, b); }
+    static I32 min(I32 a, I32 b) { return _mm256_min_epi32(a, b); }
+    static I32 max(I32 a, I32 b) { return _mm256_max_epi32(a, b); }
+    static I32 and_(I32 a, I32 b) { return _mm256_and_si256(a, b); }
+    template <int N>
+    static I32 srai(I32 a) {
+        return _mm256_srai_epi32(a, N);
+    }
+    template <int N>
+    static I32 slli(I32 a) {
+        return _mm256_slli_epi32(a, N);
+    }
+    static I32 srlv(I32 a, I32 n) { return _mm256_srlv_epi32(a, n); }
+    static I32 sllv(I32 a, I32 n) { return _mm256_sllv_epi32(a, n); }
+
+    static Mask gt(I32 a, I32 b) { return _mm256_cmpgt_epi32(a, b); }
+    static Mask or_(Mask a, Mask b) { return _mm256_or_si256(a, b); }
+    static Mask andnot(Mask a, Mask b) { return _mm256_andnot_si256(a, b); }
+    static uint32_t bits(Mask m) {
+        return uint32_t(_mm256_movemask_ps(_mm256_castsi256_ps(m)));
+    }
+
+    static Mask dot_gt0(I32 dx, I32 dy, I32 vx, I32 vy) {
+        // Widen to 64-bit to prevent overflow
+        auto lo = [](I32 v) {
+            return _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v));
+        };
+        auto hi = [](I32 v) {
+            return _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1));
+        };
+        __m256i dot_lo = _mm256_add_epi64(_mm256_mullo_epi64(lo(dx), lo(vx)),
+                                          _mm256_mullo_epi64(lo(dy), lo(vy)));
+        __m256i dot_hi = _mm256_add_epi64(_mm256_mullo_epi64(hi(dx), hi(vx)),
+                                          _mm256_mullo_epi64(hi(dy), hi(vy)));
+        __m256i zero64 = _mm256_setzero_si256();
+        // Pack 64-bit mask to 32-bit
+        return _mm256_set_m128i(
+            _mm256_cvtepi64_epi32(_mm256_cmpgt_epi64(dot_hi, zero64)),
+            _mm256_cvtepi64_epi32(_mm256_cmpgt_epi64(dot_lo, zero64)));
+    }
+    static I32 gather(const int32_t* base, I32 index) {
+        I32 out;
+        for (uint32_t j = 0; j < LANES; j++)
+            out.m256i_i32[j] = base[index.m256i_i32[j]];
+        return out;
+    }
+    // the bit goes to the sign, which is all bits() and the other masks
+    // combined with it look at
+    static Mask test_bit(I32 word, I32 bit) {
+        return _mm256_sllv_epi32(word, _mm256_sub_epi32(set1(31), bit));
+    }
+    // a / b rounded down for 0 <= a and 0 < b below 2^24: both are exact
+    // floats and the quotient is never close enough to the next integer for
+    // the division to round up to it.
+    static I32 quotient(I32 a, I32 b) {
+        return _mm256_cvttps_epi32(
+            _mm256_div_ps(_mm256_cvtepi32_ps(a), _mm256_cvtepi32_ps(b)));
+    }
+    // the same in doubles, four lanes at a time, exact for any 0 <= a
+    static I32 quotient_wide(I32 a, I32 b) {
+        auto half = [](__m128i a, __m128i b) {
+            return _mm256_cvttpd_epi32(
+                _mm256_div_pd(_mm256_cvtepi32_pd(a), _mm256_cvtepi32_pd(b)));
+        };
+        return _mm256_set_m128i(half(_mm256_extracti128_si256(a, 1),
+                                     _mm256_extracti128_si256(b, 1)),
+                                half(_mm256_castsi256_si128(a),
+                                     _mm256_castsi256_si128(b)));
+    }
+
+    // The 16 bytes at offset 13 of a record are x, y, vx | vy << 16 and 4
+    // bytes of padding, so 8 records are one 4x4 transpose per 128 bit lane
+    // away from the stride registers. pad goes back out as it came in.
+    static __m128i* fields(AsteroidFixed* r, uint32_t j) {
+        return reinterpret_cast<__m128i*>(reinterpret_cast<char*>(r + j) + 13);
+    }
+    static void load_records(AsteroidFixed* r, I32& px, I32& py, I32& v,
+                             I32& pad) {
+        // records j and j + 4
+        __m256i a = _mm256_loadu2_m128i(fields(r, 4), fields(r, 0));
+        __m256i b = _mm256_loadu2_m128i(fields(r, 5), fields(r, 1));
+        __m256i c = _mm256_loadu2_m128i(fields(r, 6), fields(r, 2));
+        __m256i d = _mm256_loadu2_m128i(fields(r, 7), fields(r, 3));
+
+        __m256i ab_lo = _mm256_unpacklo_epi32(a, b);  // x0 x1 y0 y1
+        __m256i cd_lo = _mm256_unpacklo_epi32(c, d);  // x2 x3 y2 y3
+        __m256i ab_hi = _mm256_unpackhi_epi32(a, b);  // v0 v1 p0 p1
+        __m256i cd_hi = _mm256_unpackhi_epi32(c, d);  // v2 v3 p2 p3
+        px = _mm256_unpacklo_epi64(ab_lo, cd_lo);
+        py = _mm256_unpackhi_epi64(ab_lo, cd_lo);
+        v = _mm256_unpacklo_epi64(ab_hi, cd_hi);
+        pad = _mm256_unpackhi_epi64(ab_hi, cd_hi);
+    }
+    static void store_records(AsteroidFixed* r, I32 px, I32 py, I32 v,
+                              I32 pad) {
+        __m256i xy_lo = _mm256_unpacklo_epi32(px, py);  // x0 y0 x1 y1
+        __m256i xy_hi = _mm256_unpackhi_epi32(px, py);  // x2 y2 x3 y3
+        __m256i vp_lo = _mm256_unpacklo_epi32(v, pad);  // v0 p0 v1 p1
+        __m256i vp_hi = _mm256_unpackhi_epi32(v, pad);  // v2 p2 v3 p3
+        _mm256_storeu2_m128i(fields(r, 4), fields(r, 0),
+                             _mm256_unpacklo_epi64(xy_lo, vp_lo));
+        _mm256_storeu2_m128i(fields(r, 5), fields(r, 1),
+                             _mm256_unpackhi_epi64(xy_lo, vp_lo));
+        _mm256_storeu2_m128i(fields(r, 6), fields(r, 2),
+                             _mm256_unpacklo_epi64(xy_hi, vp_hi));
+        _mm256_storeu2_m128i(fields(r, 7), fields(r, 3),
+                             _mm256_unpackhi_epi64(xy_hi, vp_hi));
+    }
+    static I32 low16(I32 v) {
+        return _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16);
+    }
+    static I32 high16(I32 v) { return _mm256_srai_epi32(v, 16); }
+
+    static void generate(const SpawnBox& box, uint32_t seed, uint32_t stream,
+                         uint64_t first, uint32_t n,
+                         const AsteroidColumns& out) {
+        generate_asteroids_avx2(box, seed, stream, first, n, out);
+    }
+};
+
+static_assert(sizeof(AsteroidFixed) == 32 &&
+                  offsetof(AsteroidFixed, position) == 13 &&
+                  offsetof(AsteroidFixed, velocity) == 21,
+              "AsteroidFixed is a packed 32 byte record");
+
+TICK_KERNELS_AVX2(TICK_INSTANTIATE)
 
 void update_asteroids_avx2(AsteroidStrideArray& asteroids, const Map* map,
-                           double platform_vel_double) {
-    auto pos_x = ASSUME_ALIGNED(
-        reinterpret_cast<int32_t*>(asteroids.position_x.data()), 32);
-    auto pos_y = ASSUME_ALIGNED(
-        reinterpret_cast<int32_t*>(asteroids.position_y.data()), 32);
-    const auto vel_x = ASSUME_ALIGNED(
-        reinterpret_cast<int16_t*>(asteroids.velocity_x.data()), 32);
-    const auto vel_y = ASSUME_ALIGNED(
-        reinterpret_cast<int16_t*>(asteroids.velocity_y.data()), 32);
-
-    const Map::TileMask EMPTY_MASK{};
-    // Precompute map bounds in fixed-point
-    const auto min_x = (map->platform_bound.left - BORDER) << FRACTION_BITS;
-    const auto max_x = (map->platform_bound.right + BORDER) << FRACTION_BITS;
-
-    const auto min_y = (map->platform_bound.bottom - BORDER) << FRACTION_BITS;
-    const auto max_y = (map->platform_bound.top + BORDER) << FRACTION_BITS;
-
-    const auto OX = map->x_offset;
-    const auto OY = map->y_offset;
-    const auto GW = map->grid_w;
-
-    const auto CENTER_X = (min_x + max_x) / 2;
-    const auto CENTER_Y = (min_y + max_y) / 2;
-
-    auto tile_indices = map->tiles.data();
-    auto tile_data = map->tile_data.data();
+                           double platform_vel) {
+    tick_asteroids<Avx2Simd, SoaLayout, DeferredCompaction, ChunkCollision>(
+        asteroids, map, platform_vel);
+}
 
+// Same tick over the cell buckets: positions come in as int16 offsets from
+// the cell and go back out as offsets, lanes that no longer fit leave for
+// their new cell after the pass.
+void update_asteroids_quantized_avx2(AsteroidQuantizedArray& asteroids,
+                                     const Map* map,
+                                     double platform_vel_double) {
     constexpr uint32_t ELEM = 8;
 
     auto platform_vel = fixed_20_11(platform_vel_double);
-    uint32_t write_index = 0;
-    uint32_t end = asteroids.size();
-
-    // I hate MSVC, why can't it unroll the loop to even avx2 with a billion
-    // hints??
-    for (uint32_t i = 0; i < end; i += ELEM) {
-        // load 8 elements at once
-        __m256i px = _mm256_load_si256((__m256i*)(pos_x + i));
-        __m256i py = _mm256_load_si256((__m256i*)(pos_y + i));
-
-        __m256i vx =
-            _mm256_cvtepi16_epi32(_mm_load_si128((__m128i*)(vel_x + i)));
-        __m256i vy =
-            _mm256_cvtepi16_epi32(_mm_load_si128((__m128i*)(vel_y + i)));
-
-        // add velocities
-        __m256i new_px = _mm256_add_epi32(px, vx);
-        __m256i new_py = _mm256_add_epi32(
-            py,
-            _mm256_add_epi32(vy, _mm256_set1_epi32(platform_vel.raw_value())));
-
-        __m256i clamped_combined_mask;
-        {
-            __m256i clamped_mask_x_low =
-                _mm256_cmpgt_epi32(_mm256_set1_epi32(min_x), new_px);
-            __m256i clamped_mask_x_high =
-                _mm256_cmpgt_epi32(new_px, _mm256_set1_epi32(max_x));
-            __m256i clamped_mask_y_low =
-                _mm256_cmpgt_epi32(_mm256_set1_epi32(min_y), new_py);
-            __m256i clamped_mask_y_high =
-                _mm256_cmpgt_epi32(new_py, _mm256_set1_epi32(max_y));
-
-            // Combine all masks with a bitwise OR
-            clamped_combined_mask =
-                _mm256_or_si256(clamped_mask_x_low, clamped_mask_x_high);
-            clamped_combined_mask =
-                _mm256_or_si256(clamped_combined_mask, clamped_mask_y_low);
-            clamped_combined_mask =
-                _mm256_or_si256(clamped_combined_mask, clamped_mask_y_high);
+    const TickBounds<Avx2Simd> bounds(map, platform_vel.raw_value());
+    const ChunkCollision<Avx2Simd> collision(map);
+    const __m256i vel_py = _mm256_set1_epi32(platform_vel.raw_value());
+    const __m256i off_min = _mm256_set1_epi32(INT16_MIN);
+    const __m256i off_max = _mm256_set1_epi32(INT16_MAX);
+
+    PROFILE_BEGIN(Phase::Update);
+    for (auto& b : asteroids.buckets) {
+        auto off_x = b.offset_x.data();
+        auto off_y = b.offset_y.data();
+        const auto vel_x = reinterpret_cast<int16_t*>(b.velocity_x.data());
+        const auto vel_y = reinterpret_cast<int16_t*>(b.velocity_y.data());
+        const __m256i base_x = _mm256_set1_epi32(b.base_x());
+        const __m256i base_y = _mm256_set1_epi32(b.base_y());
+        const uint32_t end = b.count;
+        uint64_t removed = 0;
+        uint64_t dead_bits = 0;
+
+        for (uint32_t i = 0; i < end; i += ELEM) {
+            if (!(i & 63)) removed = b.removed.words[i >> 6];
+
+            __m256i ox = _mm256_cvtepi16_epi32(
+                _mm_loadu_si128((__m128i*)(off_x + i)));
+            __m256i oy = _mm256_cvtepi16_epi32(
+                _mm_loadu_si128((__m128i*)(off_y + i)));
+            __m256i vx = _mm256_cvtepi16_epi32(
+                _mm_loadu_si128((__m128i*)(vel_x + i)));
+            __m256i vy = _mm256_cvtepi16_epi32(
+                _mm_loadu_si128((__m128i*)(vel_y + i)));
+
+            // new offsets, still relative to the cell
+            ox = _mm256_add_epi32(ox, vx);
+            oy = _mm256_add_epi32(oy, _mm256_add_epi32(vy, vel_py));
+            __m256i new_px = _mm256_add_epi32(base_x, ox);
+            __m256i new_py = _mm256_add_epi32(base_y, oy);
+
+            const uint32_t lanes =
+                end - i >= ELEM ? 0xFF : (1u << (end - i)) - 1;
+            uint32_t dead_lanes =
+                (uint32_t(removed >> (i & 63)) |
+                 removed_lanes(bounds, collision, new_px, new_py, vx, vy)) &
+                lanes;
+
+            __m256i outside = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpgt_epi32(off_min, ox),
+                                _mm256_cmpgt_epi32(ox, off_max)),
+                _mm256_or_si256(_mm256_cmpgt_epi32(off_min, oy),
+                                _mm256_cmpgt_epi32(oy, off_max)));
+            uint32_t leaving =
+                uint32_t(_mm256_movemask_ps(_mm256_castsi256_ps(outside))) &
+                lanes & ~dead_lanes;
+
+            // x0-3 y0-3 x4-7 y4-7 -> x0-7 y0-7, saturated lanes are leaving
+            __m256i packed = _mm256_permute4x64_epi64(
+                _mm256_packs_epi32(ox, oy), _MM_SHUFFLE(3, 1, 2, 0));
+            _mm_storeu_si128((__m128i*)(off_x + i),
+                             _mm256_castsi256_si128(packed));
+            _mm_storeu_si128((__m128i*)(off_y + i),
+                             _mm256_extracti128_si256(packed, 1));
+
+            for (uint32_t m = leaving; m; m &= m - 1) {
+                uint32_t k = i + std::countr_zero(m);
+                asteroids.migrants.push_back(
+                    {b.id[k], b.state[k], new_px.m256i_i32[k - i],
+                     new_py.m256i_i32[k - i], b.velocity_x[k],
+                     b.velocity_y[k]});
+            }
+            dead_bits |= uint64_t(dead_lanes | leaving) << (i & 63);
+            if ((i & 63) == 64 - ELEM || i + ELEM >= end) {
+                b.removed.store(i >> 6, dead_bits);
+                dead_bits = 0;
+            }
         }
+    }
+    PROFILE_END(Phase::Update);
 
-        __m256i min_x_vec = _mm256_set1_epi32(min_x);
-        __m256i max_x_vec = _mm256_set1_epi32(max_x);
-        __m256i clamped_px =
-            _mm256_max_epi32(min_x_vec, _mm256_min_epi32(new_px, max_x_vec));
-        clamped_px = _mm256_srai_epi32(clamped_px, FRACTION_BITS);
-
-        __m256i min_y_vec = _mm256_set1_epi32(min_y);
-        __m256i max_y_vec = _mm256_set1_epi32(max_y);
-        __m256i clamped_py =
-            _mm256_max_epi32(min_y_vec, _mm256_min_epi32(new_py, max_y_vec));
-        clamped_py = _mm256_srai_epi32(clamped_py, FRACTION_BITS);
-
-        __m256i cx = div32(clamped_px);
-        __m256i cy = div32(clamped_py);
-        __m256i tx = mod32(clamped_px);
-        __m256i ty = mod32(clamped_py);
-
-        __m256i tile_index = _mm256_add_epi32(
-            _mm256_sub_epi32(cx, _mm256_set1_epi32(OX)),
-            _mm256_mullo_epi32(_mm256_sub_epi32(cy, _mm256_set1_epi32(OY)),
-                               _mm256_set1_epi32(GW)));
-        __m256i bit_index =
-            _mm256_add_epi32(tx, _mm256_mullo_epi32(ty, _mm256_set1_epi32(32)));
-
-        __m256i dx = _mm256_srai_epi32(
-            _mm256_sub_epi32(_mm256_set1_epi32(CENTER_X), new_px),
-            FRACTION_BITS);
-        __m256i dy = _mm256_srai_epi32(
-            _mm256_sub_epi32(_mm256_set1_epi32(CENTER_Y), new_py),
-            FRACTION_BITS);
-
-        // Widen to 64-bit to prevent overflow
-        __m256i new_px_lo = _mm256_cvtepi32_epi64(_mm256_castsi256_si128(dx));
-        __m256i new_px_hi =
-            _mm256_cvtepi32_epi64(_mm256_extracti128_si256(dx, 1));
-        __m256i new_py_lo = _mm256_cvtepi32_epi64(_mm256_castsi256_si128(dy));
-        __m256i new_py_hi =
-            _mm256_cvtepi32_epi64(_mm256_extracti128_si256(dy, 1));
-
-        __m256i vy_plus =
-            _mm256_add_epi32(vy, _mm256_set1_epi32(platform_vel.raw_value()));
-
-        __m256i vx_lo = _mm256_cvtepi32_epi64(_mm256_castsi256_si128(vx));
-        __m256i vx_hi = _mm256_cvtepi32_epi64(_mm256_extracti128_si256(vx, 1));
-        __m256i vy_lo = _mm256_cvtepi32_epi64(_mm256_castsi256_si128(vy_plus));
-        __m256i vy_hi =
-            _mm256_cvtepi32_epi64(_mm256_extracti128_si256(vy_plus, 1));
-
-        // Compute dot products
-        __m256i dot_lo = _mm256_add_epi64(_mm256_mullo_epi64(new_px_lo, vx_lo),
-                                          _mm256_mullo_epi64(new_py_lo, vy_lo));
-        __m256i dot_hi = _mm256_add_epi64(_mm256_mullo_epi64(new_px_hi, vx_hi),
-                                          _mm256_mullo_epi64(new_py_hi, vy_hi));
-
-        // Compare dot <= 0
-        __m256i zero64 = _mm256_setzero_si256();
-        __m256i cond0_lo =
-            _mm256_cmpgt_epi64(zero64, dot_lo);  // dot <= 0 -> zero > dot
-        __m256i cond0_hi = _mm256_cmpgt_epi64(zero64, dot_hi);
-
-        // Pack 64-bit mask to 32-bit (so you can combine with cond1)
-        __m128i cond0_lo32 = _mm256_cvtepi64_epi32(
-            cond0_lo);  // takes lower 32-bit of each 64-bit lane
-        __m128i cond0_hi32 = _mm256_cvtepi64_epi32(cond0_hi);
-        __m256i cond0 = _mm256_set_m128i(cond0_hi32, cond0_lo32);
-
-        // Combine with cond1
-        __m256i bye = _mm256_and_si256(clamped_combined_mask, cond0);
-
-        for (uint32_t j = 0; j < ELEM; j++) {
-            const Map::TileMask* tile =
-                &tile_data[tile_indices[tile_index.m256i_i32[j]]];
-            bool colli = tile->operator[](bit_index.m256i_i32[j]);
-            bool remove = bool(colli | bye.m256i_i32[j]);
-
-            auto k = i + j;
-            asteroids.state[k] |= uint16_t(remove) << REMOVE_BIT_INDEX;
-        }
+    settle_asteroids(asteroids);
+}
 
-        _mm256_store_si256((__m256i*)(pos_x + i), new_px);
-        _mm256_store_si256((__m256i*)(pos_y + i), new_py);
-    }
+// high and low 32 bits of a * b for all 8 lanes
+static inline void mulhilo(__m256i a, __m256i b, __m256i& hi, __m256i& lo) {
+    __m256i even = _mm256_mul_epu32(a, b);
+    __m256i odd =
+        _mm256_mul_epu32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+    hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+    lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+}
 
-    // asteroids.resize(write_index);
-    tick++;
+static inline __m256i mulhi(__m256i a, __m256i b) {
+    __m256i hi, lo;
+    mulhilo(a, b, hi, lo);
+    return hi;
+}
 
-    if (tick % 32) return;
-    
-    {
-        uint32_t write_index = 0;
-        for (uint32_t i = 0; i < end; i++) {
-            const auto flags = asteroids.state[write_index] = asteroids.state[i];
-            asteroids.position_x[write_index] = asteroids.position_x[i];
-            asteroids.position_y[write_index] = asteroids.position_y[i];
-            asteroids.velocity_x[write_index] = asteroids.velocity_x[i];
-            asteroids.velocity_y[write_index] = asteroids.velocity_y[i];
-            write_index += 1 - ((flags >> REMOVE_BIT_INDEX) & 1);
+void generate_asteroids_avx2(const SpawnBox& box, uint32_t seed,
+                             uint32_t stream, uint64_t first, uint32_t n,
+                             const AsteroidColumns& out) {
+    constexpr uint32_t ELEM = 8;
+    const __m256i M0 = _mm256_set1_epi32(PHILOX_M0);
+    const __m256i M1 = _mm256_set1_epi32(PHILOX_M1);
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    const __m256i protos = _mm256_set1_epi32(box.prototypes);
+    const __m256i state_mask = _mm256_set1_epi32(0xFFFF ^ REMOVE_BIT);
+    const __m256i rx = _mm256_set1_epi32(uint32_t(box.max_x - box.min_x) + 1);
+    const __m256i ry = _mm256_set1_epi32(uint32_t(box.max_y - box.min_y) + 1);
+    const __m256i rv = _mm256_set1_epi32(uint32_t(box.max_v) * 2 + 1);
+    const __m256i min_x = _mm256_set1_epi32(box.min_x);
+    const __m256i min_y = _mm256_set1_epi32(box.min_y);
+    const __m256i max_v = _mm256_set1_epi32(box.max_v);
+    const __m256i low16 = _mm256_set1_epi32(0xFFFF);
+
+    uint32_t i = 0;
+    for (; i + ELEM <= n; i += ELEM) {
+        uint64_t index = first + i;
+        // the 8 indices may carry into the high word
+        __m256i c0 = _mm256_add_epi32(_mm256_set1_epi32(uint32_t(index)), lane);
+        __m256i carry = _mm256_cmpgt_epi32(
+            _mm256_xor_si256(_mm256_set1_epi32(uint32_t(index)),
+                             _mm256_set1_epi32(INT32_MIN)),
+            _mm256_xor_si256(c0, _mm256_set1_epi32(INT32_MIN)));
+        __m256i c1 = _mm256_sub_epi32(
+            _mm256_set1_epi32(uint32_t(index >> 32)), carry);
+        __m256i c2 = _mm256_set1_epi32(stream);
+        __m256i c3 = _mm256_setzero_si256();
+
+        uint32_t k0 = seed, k1 = 0;
+        for (uint32_t r = 0; r < 10; r++) {
+            __m256i hi0, lo0, hi1, lo1;
+            mulhilo(M0, c0, hi0, lo0);
+            mulhilo(M1, c2, hi1, lo1);
+            c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1),
+                                  _mm256_set1_epi32(k0));
+            c1 = lo1;
+            c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3),
+                                  _mm256_set1_epi32(k1));
+            c3 = lo0;
+            k0 += PHILOX_W0;
+            k1 += PHILOX_W1;
         }
-        asteroids.resize(write_index);
+
+        __m256i state = _mm256_or_si256(
+            _mm256_slli_epi32(mulhi(c0, protos), 16),
+            _mm256_and_si256(c0, state_mask));
+        __m256i px = _mm256_add_epi32(min_x, mulhi(c1, rx));
+        __m256i py = _mm256_add_epi32(min_y, mulhi(c2, ry));
+        __m256i vx = _mm256_sub_epi32(
+            _mm256_srli_epi32(
+                _mm256_mullo_epi32(_mm256_and_si256(c3, low16), rv), 16),
+            max_v);
+        __m256i vy = _mm256_sub_epi32(
+            _mm256_srli_epi32(
+                _mm256_mullo_epi32(_mm256_srli_epi32(c3, 16), rv), 16),
+            max_v);
+        // [vx0-3 vy0-3 vx4-7 vy4-7] -> [vx0-7 vy0-7]
+        __m256i v = _mm256_permute4x64_epi64(_mm256_packs_epi32(vx, vy), 0xD8);
+
+        _mm256_storeu_si256((__m256i*)(out.state + i), state);
+        _mm256_storeu_si256((__m256i*)(out.position_x + i), px);
+        _mm256_storeu_si256((__m256i*)(out.position_y + i), py);
+        _mm_storeu_si128((__m128i*)(out.velocity_x + i),
+                         _mm256_castsi256_si128(v));
+        _mm_storeu_si128((__m128i*)(out.velocity_y + i),
+                         _mm256_extracti128_si256(v, 1));
     }
-}
\ No newline at end of file
+    generate_asteroids_scalar(box, seed, stream, first + i, n - i,
+                              out.offset(i));
+}
+
+uint64_t simd_check_avx2(uint32_t seed, uint32_t rounds) {
+    return simd_check<4>("avx2.cpp", seed, rounds) +
+           simd_check<8>("avx2.cpp", seed, rounds);
+}
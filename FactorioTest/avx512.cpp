@@ -1,185 +1,163 @@
 #include <immintrin.h>
 
+#include <cstddef>
+#include <cstring>
 #include <iostream>
 #include <memory>
 
+#include "blocks.hpp"
 #include "fpm/ios.hpp"
 #include "map.hpp"
+#include "simd_check.hpp"
+#include "tick.hpp"
 
 using namespace std;
 
-#ifdef NDEBUG  // NDEBUG is typically defined in release builds
-#define ASSUME_ALIGNED(ptr, N) std::assume_aligned<N>(ptr)
-#else
-#define ASSUME_ALIGNED(ptr, N) (ptr)
-#endif
-
-static inline __m512i div32(__m512i val) {
-    return _mm512_srai_epi32(val, 5);  // divide by 32
-}
-
-static inline __m512i mod32(__m512i val) {
-    __m512i mask = _mm512_set1_epi32(31);          // 0b11111
-    __m512i result = _mm512_and_si512(val, mask);  // val & 31
-    result = _mm512_add_epi32(result, _mm512_set1_epi32(32));
-    result = _mm512_and_si512(result, mask);  // wrap around to [0,31]
-    return result;
-}
-
-void update_asteroids_avx512(AsteroidStrideArray& asteroids,
-    const Map* map, double platform_vel_double) {
-
-    auto pos_x = ASSUME_ALIGNED(
-        reinterpret_cast<int32_t*>(asteroids.position_x.data()), 32);
-    auto pos_y = ASSUME_ALIGNED(
-        reinterpret_cast<int32_t*>(asteroids.position_y.data()), 32);
-    const auto vel_x = ASSUME_ALIGNED(
-        reinterpret_cast<int16_t*>(asteroids.velocity_x.data()), 32);
-    const auto vel_y = ASSUME_ALIGNED(
-        reinterpret_cast<int16_t*>(asteroids.velocity_y.data()), 32);
-    auto flags = ASSUME_ALIGNED(asteroids.flags.data(), 32);
-
-    const Map::TileMask EMPTY_MASK{};
-    // Precompute map bounds in fixed-point
-    const auto min_x = (map->platform_bound.left - BORDER) << FRACTION_BITS;
-    const auto max_x = (map->platform_bound.right + BORDER) << FRACTION_BITS;
-
-    const auto min_y = (map->platform_bound.bottom - BORDER) << FRACTION_BITS;
-    const auto max_y = (map->platform_bound.top + BORDER) << FRACTION_BITS;
-
-    const auto OX = map->x_offset;
-    const auto OY = map->y_offset;
-    const auto GW = map->grid_w;
-
-    const auto CENTER_X = (min_x + max_x) / 2;
-    const auto CENTER_Y = (min_y + max_y) / 2;
-
-    auto tile_indices = map->tiles.data();
-    auto tile_data = map->tile_data.data();
-
-    constexpr uint32_t ELEM = 16;
-
-    auto platform_vel = fixed_20_11(platform_vel_double);
-    uint32_t write_index = 0;
-    uint32_t end = asteroids.size();
-
-    // I hate MSVC, why can't it unroll the loop to even avx2 with a billion
-    // hints??
-    for (uint32_t i = 0; i < end; i += ELEM) {
-        // load 8 elements at once
-        __m512i px = _mm512_load_si512((__m512i*)(pos_x + i));
-        __m512i py = _mm512_load_si512((__m512i*)(pos_y + i));
-
-        __m512i vx =
-            _mm512_cvtepi16_epi32(_mm256_load_si256((__m256i*)(vel_x + i)));
-        __m512i vy =
-            _mm512_cvtepi16_epi32(_mm256_load_si256((__m256i*)(vel_y + i)));
-
-        // add velocities
-        __m512i new_px = _mm512_add_epi32(px, vx);
-        __m512i new_py = _mm512_add_epi32(
-            py,
-            _mm512_add_epi32(vy, _mm512_set1_epi32(platform_vel.raw_value())));
-
-        uint16_t clamped_combined_mask;
-        {
-            uint16_t clamped_mask_x_low =
-                _mm512_cmpgt_epi32_mask(_mm512_set1_epi32(min_x), new_px);
-            uint16_t clamped_mask_x_high =
-                _mm512_cmpgt_epi32_mask(new_px, _mm512_set1_epi32(max_x));
-            uint16_t clamped_mask_y_low =
-                _mm512_cmpgt_epi32_mask(_mm512_set1_epi32(min_y), new_py);
-            uint16_t clamped_mask_y_high =
-                _mm512_cmpgt_epi32_mask(new_py, _mm512_set1_epi32(max_y));
-
-            // Combine all masks with a bitwise OR
-            clamped_combined_mask = clamped_mask_x_low | clamped_mask_x_high |
-                clamped_mask_y_low | clamped_mask_y_high;
-        }
-
-        __m512i min_x_vec = _mm512_set1_epi32(min_x);
-        __m512i max_x_vec = _mm512_set1_epi32(max_x);
-        __m512i clamped_px =
-            _mm512_max_epi32(min_x_vec, _mm512_min_epi32(new_px, max_x_vec));
-        clamped_px = _mm512_srai_epi32(clamped_px, FRACTION_BITS);
-
-        __m512i min_y_vec = _mm512_set1_epi32(min_y);
-        __m512i max_y_vec = _mm512_set1_epi32(max_y);
-        __m512i clamped_py =
-            _mm512_max_epi32(min_y_vec, _mm512_min_epi32(new_py, max_y_vec));
-        clamped_py = _mm512_srai_epi32(clamped_py, FRACTION_BITS);
-
-        __m512i cx = div32(clamped_px);
-        __m512i cy = div32(clamped_py);
-        __m512i tx = mod32(clamped_px);
-        __m512i ty = mod32(clamped_py);
-
-        __m512i tile_index = _mm512_add_epi32(
-            _mm512_sub_epi32(cx, _mm512_set1_epi32(OX)),
-            _mm512_mullo_epi32(_mm512_sub_epi32(cy, _mm512_set1_epi32(OY)),
-                _mm512_set1_epi32(GW)));
-        __m512i bit_index =
-            _mm512_add_epi32(tx, _mm512_mullo_epi32(ty, _mm512_set1_epi32(32)));
+// tick.hpp backend, 16 lanes with mask registers. Tile bits come from real
+// gathers: the tile slot, then the 32 bit word of the mask holding the bit.
+// This file used to hold a hand written stride kernel that failed validation
+// because its dot product test was dot >= 0.
+struct Avx512Simd {
+    static constexpr uint32_t LANES = 16;
+    using I32 = __m512i;
+    using Mask = __mmask16;
+
+    static I32 set1(int32_t v) { return _mm512_set1_epi32(v); }
+    static I32 load(const fixed_20_11* p) { return _mm512_load_si512(p); }
+    static I32 load(const fixed_4_11* p) {
+        return _mm512_cvtepi16_epi32(_mm256_load_si256((const __m256i*)p));
+    }
+    static I32 load(const uint32_t* p) { return _mm512_load_si512(p); }
+    static void store(fixed_20_11* p, I32 v) { _mm512_store_si512(p, v); }
+
+    static I32 add(I32 a, I32 b) { return _mm512_add_epi32(a, b); }
+    static I32 sub(I32 a, I32 b) { return _mm512_sub_epi32(a, b); }
+    static I32 mullo(I32 a, I32 b) { return _mm512_mullo_epi32(a, b); }
+    static I32 min(I32 a, I32 b) { return _mm512_min_epi32(a, b); }
+    static I32 max(I32 a, I32 b) { return _mm512_max_epi32(a, b); }
+    static I32 and_(I32 a, I32 b) { return _mm512_and_si512(a, b); }
+    template <int N>
+    static I32 srai(I32 a) {
+        return _mm512_srai_epi32(a, N);
+    }
+    template <int N>
+    static I32 slli(I32 a) {
+        return _mm512_slli_epi32(a, N);
+    }
+    static I32 srlv(I32 a, I32 n) { return _mm512_srlv_epi32(a, n); }
+    static I32 sllv(I32 a, I32 n) { return _mm512_sllv_epi32(a, n); }
 
-        __m512i dx = _mm512_srai_epi32(_mm512_sub_epi32(_mm512_set1_epi32(CENTER_X), new_px), FRACTION_BITS);
-        __m512i dy = _mm512_srai_epi32(_mm512_sub_epi32(_mm512_set1_epi32(CENTER_Y), new_py), FRACTION_BITS);
+    static Mask gt(I32 a, I32 b) { return _mm512_cmpgt_epi32_mask(a, b); }
+    static Mask or_(Mask a, Mask b) { return a | b; }
+    static Mask andnot(Mask a, Mask b) { return Mask(~a & b); }
+    static uint32_t bits(Mask m) { return m; }
 
+    static Mask dot_gt0(I32 dx, I32 dy, I32 vx, I32 vy) {
         // Widen to 64-bit to prevent overflow
-        __m512i new_px_lo =
-            _mm512_cvtepi32_epi64(_mm512_extracti32x8_epi32(dx, 0));
-        __m512i new_px_hi =
-            _mm512_cvtepi32_epi64(_mm512_extracti32x8_epi32(dx, 1));
-        __m512i new_py_lo =
-            _mm512_cvtepi32_epi64(_mm512_extracti32x8_epi32(dy, 0));
-        __m512i new_py_hi =
-            _mm512_cvtepi32_epi64(_mm512_extracti32x8_epi32(dy, 1));
-
-        __m512i vy_plus = _mm512_add_epi32(vy, _mm512_set1_epi32(platform_vel.raw_value()));
-
-        __m512i vx_lo = _mm512_cvtepi32_epi64(_mm512_extracti32x8_epi32(vx, 0));
-        __m512i vx_hi = _mm512_cvtepi32_epi64(_mm512_extracti32x8_epi32(vx, 1));
-        __m512i vy_lo = _mm512_cvtepi32_epi64(_mm512_extracti32x8_epi32(vy_plus, 0));
-        __m512i vy_hi = _mm512_cvtepi32_epi64(_mm512_extracti32x8_epi32(vy_plus, 1));
-
-        // Compute dot products
-        __m512i dot_lo = _mm512_add_epi64(_mm512_mullo_epi64(new_px_lo, vx_lo),
-            _mm512_mullo_epi64(new_py_lo, vy_lo));
-        __m512i dot_hi = _mm512_add_epi64(_mm512_mullo_epi64(new_px_hi, vx_hi),
-            _mm512_mullo_epi64(new_py_hi, vy_hi));
-
-        // Compare dot <= 0
+        auto lo = [](I32 v) {
+            return _mm512_cvtepi32_epi64(_mm512_castsi512_si256(v));
+        };
+        auto hi = [](I32 v) {
+            return _mm512_cvtepi32_epi64(_mm512_extracti32x8_epi32(v, 1));
+        };
+        __m512i dot_lo =
+            _mm512_add_epi64(_mm512_mullo_epi64(lo(dx), lo(vx)),
+                             _mm512_mullo_epi64(lo(dy), lo(vy)));
+        __m512i dot_hi =
+            _mm512_add_epi64(_mm512_mullo_epi64(hi(dx), hi(vx)),
+                             _mm512_mullo_epi64(hi(dy), hi(vy)));
         __m512i zero64 = _mm512_setzero_si512();
-        uint8_t cond0_lo = _mm512_cmp_epi64_mask(zero64, dot_lo, 2);  // dot <= 0 -> zero > dot
-        uint8_t cond0_hi = _mm512_cmp_epi64_mask(zero64, dot_hi, 2);
-        uint16_t cond0_mask = (uint16_t(cond0_hi) << 8) | cond0_lo;
-
-        // Combine with cond1
-        uint16_t bye = clamped_combined_mask & cond0_mask;
-
-        for (uint32_t j = 0; j < ELEM; j++) {
-            const Map::TileMask* tile =
-                &tile_data[tile_indices[tile_index.m512i_i32[j]]];
-            bool colli = tile->operator[](bit_index.m512i_i32[j]);
-            bool remove = bool(colli | ((bye >> j) & 1));
+        return Mask(_mm512_cmpgt_epi64_mask(dot_lo, zero64) |
+                    (_mm512_cmpgt_epi64_mask(dot_hi, zero64) << 8));
+    }
+    static I32 gather(const int32_t* base, I32 index) {
+        return _mm512_i32gather_epi32(index, base, 4);
+    }
+    static Mask test_bit(I32 word, I32 bit) {
+        return _mm512_test_epi32_mask(word,
+                                      _mm512_sllv_epi32(set1(1), bit));
+    }
+    // exact below 2^24, see Avx2Simd::quotient
+    static I32 quotient(I32 a, I32 b) {
+        return _mm512_cvttps_epi32(
+            _mm512_div_ps(_mm512_cvtepi32_ps(a), _mm512_cvtepi32_ps(b)));
+    }
+    // see Avx2Simd::quotient_wide
+    static I32 quotient_wide(I32 a, I32 b) {
+        auto half = [](__m256i a, __m256i b) {
+            return _mm512_cvttpd_epi32(
+                _mm512_div_pd(_mm512_cvtepi32_pd(a), _mm512_cvtepi32_pd(b)));
+        };
+        return _mm512_inserti64x4(
+            _mm512_castsi256_si512(half(_mm512_castsi512_si256(a),
+                                        _mm512_castsi512_si256(b))),
+            half(_mm512_extracti64x4_epi64(a, 1),
+                 _mm512_extracti64x4_epi64(b, 1)),
+            1);
+    }
 
-            auto k = i + j;
-            asteroids.state[write_index] = asteroids.state[k];
-            asteroids.flags[write_index] = asteroids.flags[k];
+    // Avx2Simd::load_records with four records per register, record j in
+    // 128 bit lane j / 4
+    static __m128i* fields(AsteroidFixed* r, uint32_t j) {
+        return reinterpret_cast<__m128i*>(reinterpret_cast<char*>(r + j) + 13);
+    }
+    // records j, j + 4, j + 8 and j + 12
+    static __m512i load4(AsteroidFixed* r, uint32_t j) {
+        __m512i v = _mm512_castsi128_si512(_mm_loadu_si128(fields(r, j)));
+        v = _mm512_inserti32x4(v, _mm_loadu_si128(fields(r, j + 4)), 1);
+        v = _mm512_inserti32x4(v, _mm_loadu_si128(fields(r, j + 8)), 2);
+        return _mm512_inserti32x4(v, _mm_loadu_si128(fields(r, j + 12)), 3);
+    }
+    static void store4(AsteroidFixed* r, uint32_t j, __m512i v) {
+        _mm_storeu_si128(fields(r, j), _mm512_castsi512_si128(v));
+        _mm_storeu_si128(fields(r, j + 4), _mm512_extracti32x4_epi32(v, 1));
+        _mm_storeu_si128(fields(r, j + 8), _mm512_extracti32x4_epi32(v, 2));
+        _mm_storeu_si128(fields(r, j + 12), _mm512_extracti32x4_epi32(v, 3));
+    }
+    static void load_records(AsteroidFixed* r, I32& px, I32& py, I32& v,
+                             I32& pad) {
+        __m512i a = load4(r, 0), b = load4(r, 1);
+        __m512i c = load4(r, 2), d = load4(r, 3);
+        __m512i ab_lo = _mm512_unpacklo_epi32(a, b);  // x0 x1 y0 y1
+        __m512i cd_lo = _mm512_unpacklo_epi32(c, d);  // x2 x3 y2 y3
+        __m512i ab_hi = _mm512_unpackhi_epi32(a, b);  // v0 v1 p0 p1
+        __m512i cd_hi = _mm512_unpackhi_epi32(c, d);  // v2 v3 p2 p3
+        px = _mm512_unpacklo_epi64(ab_lo, cd_lo);
+        py = _mm512_unpackhi_epi64(ab_lo, cd_lo);
+        v = _mm512_unpacklo_epi64(ab_hi, cd_hi);
+        pad = _mm512_unpackhi_epi64(ab_hi, cd_hi);
+    }
+    static void store_records(AsteroidFixed* r, I32 px, I32 py, I32 v,
+                              I32 pad) {
+        __m512i xy_lo = _mm512_unpacklo_epi32(px, py);
+        __m512i xy_hi = _mm512_unpackhi_epi32(px, py);
+        __m512i vp_lo = _mm512_unpacklo_epi32(v, pad);
+        __m512i vp_hi = _mm512_unpackhi_epi32(v, pad);
+        store4(r, 0, _mm512_unpacklo_epi64(xy_lo, vp_lo));
+        store4(r, 1, _mm512_unpackhi_epi64(xy_lo, vp_lo));
+        store4(r, 2, _mm512_unpacklo_epi64(xy_hi, vp_hi));
+        store4(r, 3, _mm512_unpackhi_epi64(xy_hi, vp_hi));
+    }
+    static I32 low16(I32 v) {
+        return _mm512_srai_epi32(_mm512_slli_epi32(v, 16), 16);
+    }
+    static I32 high16(I32 v) { return _mm512_srai_epi32(v, 16); }
 
-            asteroids.position_x[write_index] = fixed_20_11::from_raw_value(
-                static_cast<int32_t>(new_px.m512i_i32[j]));
-            asteroids.position_y[write_index] = fixed_20_11::from_raw_value(
-                static_cast<int32_t>(new_py.m512i_i32[j]));
+    // the AVX2 generator draws the same asteroids
+    static void generate(const SpawnBox& box, uint32_t seed, uint32_t stream,
+                         uint64_t first, uint32_t n,
+                         const AsteroidColumns& out) {
+        generate_asteroids_avx2(box, seed, stream, first, n, out);
+    }
+};
 
-            asteroids.velocity_x[write_index] = asteroids.velocity_x[k];
-            asteroids.velocity_y[write_index] = asteroids.velocity_y[k];
+static_assert(sizeof(AsteroidFixed) == 32 &&
+                  offsetof(AsteroidFixed, position) == 13 &&
+                  offsetof(AsteroidFixed, velocity) == 21,
+              "AsteroidFixed is a packed 32 byte record");
 
-            write_index += !remove & (k < end);
-        }
-    }
+TICK_KERNELS_AVX512(TICK_INSTANTIATE)
 
-    auto removed = asteroids.size() - write_index;
-    asteroids.resize(write_index);
-    // cout << "Remaining asteroids: " << asteroids.size() << " (removed " <<
-    // removed << " this tick) %8 = " << (write_index % 8) << endl;
-}
\ No newline at end of file
+uint64_t simd_check_avx512(uint32_t seed, uint32_t rounds) {
+    return simd_check<16>("avx512.cpp", seed, rounds);
+}
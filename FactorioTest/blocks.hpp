@@ -0,0 +1,103 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+#include "headers.hpp"
+
+// W asteroids side by side, every field contiguous for all lanes. With W = 8
+// a block is two cache lines and one AVX2 vector per field, with W = 16 it is
+// four and one AVX-512 vector per field.
+template <uint32_t W>
+struct alignas(64) AsteroidBlock {
+    uint32_t state[W];
+    fixed_20_11 position_x[W];
+    fixed_20_11 position_y[W];
+    fixed_4_11 velocity_x[W];
+    fixed_4_11 velocity_y[W];
+};
+
+// AoSoA store, between AsteroidFixed (one struct per asteroid) and
+// AsteroidStrideArray (one stream per field). Removal flags are the same
+// bitmap as in the stride layout, a block's flags are W adjacent bits.
+// Compaction sweeps every COMPACTION_INTERVAL ticks and keeps the order.
+template <uint32_t W>
+class AsteroidBlockArray {
+    static_assert(W == 8 || W == 16, "a block is 8 or 16 lanes");
+    size_t actual_size = 0;
+
+   public:
+    static constexpr uint32_t LANES = W;
+    using Block = AsteroidBlock<W>;
+
+    AlignedVector<Block> blocks;
+    DeadSlotMap dead_slots;
+    uint32_t tick = 0;
+
+    size_t size() const { return actual_size; }
+
+    // new slots start out removed
+    void resize(size_t n) {
+        blocks.resize((n + W - 1) / W);
+        dead_slots.resize(actual_size, n, blocks.size() * W);
+        actual_size = n;
+    }
+
+    Block& block_of(size_t i) { return blocks[i / W]; }
+    const Block& block_of(size_t i) const { return blocks[i / W]; }
+
+    // removal flags of block b, one bit per lane
+    uint32_t dead_lanes(size_t b) const {
+        size_t i = b * W;
+        return uint32_t(dead_slots.words[i >> 6] >> (i & 63)) &
+               ((1u << W) - 1);
+    }
+    void store_dead_lanes(size_t b, uint32_t lanes) {
+        size_t i = b * W;
+        uint64_t mask = uint64_t((1u << W) - 1) << (i & 63);
+        dead_slots.store(i >> 6, (dead_slots.words[i >> 6] & ~mask) |
+                                     (uint64_t(lanes) << (i & 63)));
+    }
+};
+
+// Moves the survivors down, keeping their order. A full block landing on a
+// block boundary is copied whole, a dead one is skipped whole, only the
+// blocks with holes go lane by lane.
+template <uint32_t W>
+static inline void compact_blocks(AsteroidBlockArray<W>& asteroids) {
+    using Block = AsteroidBlock<W>;
+    const size_t size = asteroids.size();
+    const size_t count = (size + W - 1) / W;
+    size_t write = 0;
+    for (size_t b = 0; b < count; b++) {
+        uint32_t lanes = (b + 1) * W <= size ? W : uint32_t(size - b * W);
+        uint32_t live = ~asteroids.dead_lanes(b) & ((1u << lanes) - 1);
+        if (!live) continue;
+        const Block& src = asteroids.blocks[b];
+        if (live == (1u << W) - 1 && write % W == 0) {
+            if (write / W != b) asteroids.blocks[write / W] = src;
+            write += W;
+            continue;
+        }
+        for (uint32_t j = 0; j < lanes; j++) {
+            if (!(live >> j & 1)) continue;
+            Block& dst = asteroids.blocks[write / W];
+            uint32_t k = write % W;
+            dst.state[k] = src.state[j];
+            dst.position_x[k] = src.position_x[j];
+            dst.position_y[k] = src.position_y[j];
+            dst.velocity_x[k] = src.velocity_x[j];
+            dst.velocity_y[k] = src.velocity_y[j];
+            write++;
+        }
+    }
+    asteroids.resize(write);
+    asteroids.dead_slots.clear();
+}
+
+// after the update pass
+template <uint32_t W>
+static inline void settle_blocks(AsteroidBlockArray<W>& asteroids) {
+    if (++asteroids.tick % COMPACTION_INTERVAL) return;
+    PROFILE_PHASE(Phase::Compaction);
+    compact_blocks(asteroids);
+}
@@ -0,0 +1,189 @@
+#pragma once
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "headers.hpp"
+
+// What a policy gets to look at once per tick, after the update pass.
+struct CompactionStats {
+    uint32_t tick;
+    uint32_t size;
+    // removed asteroids still in [0, size), counted by the kernel
+    uint32_t dead;
+    uint32_t since_sweep;
+};
+
+// Decides when a batched sweep runs. Every sweep it triggers is kept in
+// decisions so the benchmark can report them.
+class CompactionPolicy {
+   public:
+    std::vector<CompactionStats> decisions;
+    // print every decision to stderr
+    bool verbose = false;
+
+    virtual ~CompactionPolicy() = default;
+    virtual const char* name() const = 0;
+
+    bool decide(const CompactionStats& s) {
+        if (!should_compact(s)) return false;
+        decisions.push_back(s);
+        if (verbose)
+            fprintf(stderr,
+                    "%s: sweep at tick %u, %u/%u dead (%.1f%%), %u ticks "
+                    "since the last one\n",
+                    name(), s.tick, s.dead, s.size,
+                    s.size ? 100.0 * s.dead / s.size : 0.0, s.since_sweep);
+        return true;
+    }
+
+   protected:
+    virtual bool should_compact(const CompactionStats& s) = 0;
+};
+
+// the old behaviour: sweep every N ticks, dead or not
+class IntervalPolicy : public CompactionPolicy {
+    uint32_t interval;
+
+   public:
+    explicit IntervalPolicy(uint32_t interval = COMPACTION_INTERVAL)
+        : interval(std::max(interval, 1u)) {}
+    const char* name() const override { return "interval"; }
+
+   protected:
+    bool should_compact(const CompactionStats& s) override {
+        return s.tick % interval == 0;
+    }
+};
+
+// Every dead slot costs scan_cost per tick it is still walked by the update
+// pass, a sweep costs sweep_cost per slot. Sweep once the scanning left until
+// the max_interval backstop, dead * scan_cost * ticks_left, is worth at least
+// a sweep. Nothing dead, no sweep; lots dead after a brush, sweep right away.
+class CostModelPolicy : public CompactionPolicy {
+    double scan_cost;
+    double sweep_cost;
+    uint32_t max_interval;
+
+   public:
+    explicit CostModelPolicy(double scan_cost = 1.0, double sweep_cost = 1.0,
+                             uint32_t max_interval = 256)
+        : scan_cost(scan_cost),
+          sweep_cost(sweep_cost),
+          max_interval(std::max(max_interval, 1u)) {}
+    const char* name() const override { return "cost"; }
+
+   protected:
+    bool should_compact(const CompactionStats& s) override {
+        if (!s.dead) return false;
+        if (s.since_sweep >= max_interval) return true;
+        double ticks_left = double(max_interval - s.since_sweep);
+        return s.dead * scan_cost * ticks_left >= s.size * sweep_cost;
+    }
+};
+
+// "interval", "interval:N", "cost" or "cost:SCAN/SWEEP", nullptr if the
+// spec does not parse
+static inline std::unique_ptr<CompactionPolicy> make_compaction_policy(
+    const std::string& spec) {
+    auto colon = spec.find(':');
+    auto kind = spec.substr(0, colon);
+    auto arg = colon == std::string::npos ? "" : spec.substr(colon + 1);
+    try {
+        if (kind == "interval")
+            return std::make_unique<IntervalPolicy>(
+                arg.empty() ? COMPACTION_INTERVAL : uint32_t(std::stoul(arg)));
+        if (kind == "cost") {
+            if (arg.empty()) return std::make_unique<CostModelPolicy>();
+            auto slash = arg.find('/');
+            if (slash == std::string::npos) return nullptr;
+            return std::make_unique<CostModelPolicy>(
+                std::stod(arg.substr(0, slash)),
+                std::stod(arg.substr(slash + 1)));
+        }
+    } catch (const std::exception&) {
+    }
+    return nullptr;
+}
+
+// Moves the survivors of [read, read_end) down to write, keeping their order,
+// and returns the new write index. With MARK_GAP the removal bits move along
+// and the slots survivors leave behind are flagged, so the gap between write
+// and read_end never holds stale copies of live asteroids. Without it the
+// caller clears the bitmap afterwards.
+template <bool MARK_GAP>
+static inline uint32_t compact_range(AsteroidStrideArray& asteroids,
+                                     uint32_t read, uint32_t read_end,
+                                     uint32_t write) {
+    auto& removed = asteroids.dead_slots;
+    // a sleep counter goes with its asteroid, the slot it leaves starts over
+    int16_t* sleep = asteroids.sleep.empty() ? nullptr : asteroids.sleep.data();
+    for (uint32_t i = read; i < read_end; i++) {
+        const bool dead = removed.test(i);
+        asteroids.state[write] = asteroids.state[i];
+        asteroids.position_x[write] = asteroids.position_x[i];
+        asteroids.position_y[write] = asteroids.position_y[i];
+        asteroids.velocity_x[write] = asteroids.velocity_x[i];
+        asteroids.velocity_y[write] = asteroids.velocity_y[i];
+        if (sleep && i != write) {
+            sleep[write] = sleep[i];
+            sleep[i] = 0;
+        }
+        if constexpr (MARK_GAP) {
+            removed.set(write, dead);
+            if (i != write) removed.set(i, true);
+        }
+        write += !dead;
+    }
+    return write;
+}
+
+// Called by the stride kernels after the update pass, with the number of
+// removed asteroids they saw.
+//
+// In incremental mode every tick sweeps the next slice and the last tick of
+// the interval sweeps whatever is left and resizes, on the same tick the
+// batched sweep would. The surviving asteroids end up in the same order as
+// with the batched sweep; asteroids flagged after their slice was swept stay
+// in the array until the next interval.
+static inline void compact_asteroids(AsteroidStrideArray& asteroids,
+                                     uint32_t dead) {
+    auto& c = asteroids.compaction;
+    c.tick++;
+    c.dead = dead;
+    const bool last = c.tick % COMPACTION_INTERVAL == 0;
+
+    if (c.mode == CompactionMode::Batched) {
+        bool sweep = last;
+        if (c.policy)
+            sweep = c.policy->decide({c.tick, uint32_t(asteroids.size()), dead,
+                                      c.tick - c.last_sweep});
+        if (!sweep) return;
+        c.last_sweep = c.tick;
+        c.dead = 0;
+        PROFILE_PHASE(Phase::Compaction);
+        asteroids.resize(
+            compact_range<false>(asteroids, 0, uint32_t(asteroids.size()), 0));
+        asteroids.dead_slots.clear();
+        return;
+    }
+
+    PROFILE_PHASE(Phase::Compaction);
+    const auto size = uint32_t(asteroids.size());
+    // first slice of the interval, or the array shrank under us
+    if ((c.tick - 1) % COMPACTION_INTERVAL == 0 || c.read > size) {
+        c.read = c.write = 0;
+        c.slice = (size + COMPACTION_INTERVAL - 1) / COMPACTION_INTERVAL;
+    }
+
+    uint32_t read_end = last ? size : std::min(size, c.read + c.slice);
+    c.write = compact_range<true>(asteroids, c.read, read_end, c.write);
+    c.read = read_end;
+
+    if (last) {
+        asteroids.resize(c.write);
+        c.read = c.write = 0;
+        c.last_sweep = c.tick;
+    }
+}
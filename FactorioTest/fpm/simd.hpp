@@ -0,0 +1,688 @@
+#ifndef FPM_SIMD_HPP
+#define FPM_SIMD_HPP
+
+#include "fixed.hpp"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__AVX__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
+namespace fpm
+{
+
+//! Instruction sets the batch types are built on. A batch of Width lanes uses
+//! native_t<Width>: the set of the translation unit (/arch, -m flags) whose
+//! registers hold exactly Width 32 bit lanes, or generic, plain loops over an
+//! array. The set is part of the batch type, so translation units compiled for
+//! different sets never share an inline function of the same type.
+namespace simd
+{
+struct generic {};
+struct sse41 {};
+struct avx2 {};
+struct avx512 {};
+struct wasm128 {};
+
+template <unsigned int Width>
+struct native_arch { using type = generic; };
+
+#if defined(__AVX512F__)
+template <> struct native_arch<16> { using type = avx512; };
+#endif
+#if defined(__AVX2__)
+template <> struct native_arch<8> { using type = avx2; };
+#endif
+#if defined(__SSE4_1__) || defined(__AVX__)
+template <> struct native_arch<4> { using type = sse41; };
+#elif defined(__wasm_simd128__)
+template <> struct native_arch<4> { using type = wasm128; };
+#endif
+
+template <unsigned int Width>
+using native_t = typename native_arch<Width>::type;
+
+//! Lane operations on Width int32 lanes. Comparisons return a bitmask, bit j
+//! for lane j. The vector sets also expose the register as 64 bit lanes
+//! (the *64 functions) for the products of 32 bit lanes.
+template <typename Arch, unsigned int Width>
+struct backend;
+
+namespace detail
+{
+// Rounds 64 bit products p down by F fraction bits the way fixed::operator*=
+// does: p / 2**(F-1) truncated, then halved with its remainder added, i.e.
+// half away from zero. Only the low 32 bits of each lane are meaningful after.
+template <typename A, unsigned int F, bool R>
+inline typename A::reg round_products(typename A::reg p) noexcept
+{
+    const auto neg = A::srl64(p, 63);
+    if (R)
+        p = A::sub64(A::add64(p, A::set1_64(std::int64_t(1) << (F - 1))), neg);
+    else
+        p = A::add64(p, A::and_(A::sub64(A::set1_64(0), neg),
+                                A::set1_64((std::int64_t(1) << F) - 1)));
+    return A::srl64(p, F);
+}
+
+// 32 bit fixed multiplication with a 64 bit intermediate: even and odd lanes
+// are multiplied separately, mul_even widens the low half of each 64 bit lane.
+template <typename A, unsigned int F, bool R>
+inline typename A::reg mul_wide(typename A::reg a, typename A::reg b) noexcept
+{
+    const auto even = round_products<A, F, R>(A::mul_even(a, b));
+    const auto odd = round_products<A, F, R>(
+        A::mul_even(A::srl64(a, 32), A::srl64(b, 32)));
+    return A::interleave(even, odd);
+}
+
+// 16 bit fixed multiplication, the int32 intermediate is the lane itself.
+// The result still has to be wrapped to 16 bits.
+template <typename A, unsigned int F, bool R>
+inline typename A::reg mul_narrow(typename A::reg a, typename A::reg b) noexcept
+{
+    auto p = A::mullo(a, b);
+    const auto neg = A::srl(p, 31);
+    if (R)
+        p = A::sub(A::add(p, A::set1(std::int32_t(1) << (F - 1))), neg);
+    else
+        p = A::add(p, A::and_(A::sub(A::set1(0), neg),
+                              A::set1((std::int32_t(1) << F) - 1)));
+    return A::sra(p, F);
+}
+} // namespace detail
+
+template <unsigned int Width>
+struct backend<generic, Width>
+{
+    // a single lane is just the integer, so a batch of one converts freely
+    using reg = typename std::conditional<Width == 1, std::int32_t,
+                                          std::array<std::int32_t, Width>>::type;
+
+    static std::int32_t lane(const reg& v, unsigned int j) noexcept
+    {
+        if constexpr (Width == 1) return v; else return v[j];
+    }
+    static std::int32_t& lane(reg& v, unsigned int j) noexcept
+    {
+        if constexpr (Width == 1) return v; else return v[j];
+    }
+    template <typename Op>
+    static reg map(reg a, Op op) noexcept
+    {
+        reg r;
+        for (unsigned int j = 0; j < Width; j++) lane(r, j) = op(lane(a, j));
+        return r;
+    }
+    template <typename Op>
+    static reg map(reg a, reg b, Op op) noexcept
+    {
+        reg r;
+        for (unsigned int j = 0; j < Width; j++)
+            lane(r, j) = op(lane(a, j), lane(b, j));
+        return r;
+    }
+    template <typename Op>
+    static std::uint32_t mask(reg a, reg b, Op op) noexcept
+    {
+        std::uint32_t m = 0;
+        for (unsigned int j = 0; j < Width; j++)
+            m |= std::uint32_t(op(lane(a, j), lane(b, j))) << j;
+        return m;
+    }
+
+    static reg set1(std::int32_t v) noexcept
+    {
+        reg r;
+        for (unsigned int j = 0; j < Width; j++) lane(r, j) = v;
+        return r;
+    }
+    static reg load(const std::int32_t* p) noexcept
+    {
+        reg r;
+        for (unsigned int j = 0; j < Width; j++) lane(r, j) = p[j];
+        return r;
+    }
+    static void store(std::int32_t* p, reg v) noexcept
+    {
+        for (unsigned int j = 0; j < Width; j++) p[j] = lane(v, j);
+    }
+    static reg load16(const std::int16_t* p) noexcept
+    {
+        reg r;
+        for (unsigned int j = 0; j < Width; j++) lane(r, j) = p[j];
+        return r;
+    }
+    static void store16(std::int16_t* p, reg v) noexcept
+    {
+        for (unsigned int j = 0; j < Width; j++) p[j] = std::int16_t(lane(v, j));
+    }
+
+    // in unsigned arithmetic, so overflow wraps like the vector sets
+    static reg add(reg a, reg b) noexcept
+    {
+        return map(a, b, [](std::int32_t x, std::int32_t y) { return std::int32_t(std::uint32_t(x) + std::uint32_t(y)); });
+    }
+    static reg sub(reg a, reg b) noexcept
+    {
+        return map(a, b, [](std::int32_t x, std::int32_t y) { return std::int32_t(std::uint32_t(x) - std::uint32_t(y)); });
+    }
+    static reg mullo(reg a, reg b) noexcept
+    {
+        return map(a, b, [](std::int32_t x, std::int32_t y) { return std::int32_t(std::uint32_t(x) * std::uint32_t(y)); });
+    }
+    static reg min(reg a, reg b) noexcept
+    {
+        return map(a, b, [](std::int32_t x, std::int32_t y) { return x < y ? x : y; });
+    }
+    static reg max(reg a, reg b) noexcept
+    {
+        return map(a, b, [](std::int32_t x, std::int32_t y) { return x > y ? x : y; });
+    }
+    static reg and_(reg a, reg b) noexcept
+    {
+        return map(a, b, [](std::int32_t x, std::int32_t y) { return x & y; });
+    }
+    static reg or_(reg a, reg b) noexcept
+    {
+        return map(a, b, [](std::int32_t x, std::int32_t y) { return x | y; });
+    }
+    static reg xor_(reg a, reg b) noexcept
+    {
+        return map(a, b, [](std::int32_t x, std::int32_t y) { return x ^ y; });
+    }
+    static reg sra(reg a, int n) noexcept
+    {
+        return map(a, [n](std::int32_t x) { return x >> n; });
+    }
+    static reg sll(reg a, int n) noexcept
+    {
+        return map(a, [n](std::int32_t x) { return std::int32_t(std::uint32_t(x) << n); });
+    }
+    static reg srl(reg a, int n) noexcept
+    {
+        return map(a, [n](std::int32_t x) { return std::int32_t(std::uint32_t(x) >> n); });
+    }
+    static std::uint32_t gt(reg a, reg b) noexcept
+    {
+        return mask(a, b, [](std::int32_t x, std::int32_t y) { return x > y; });
+    }
+    static std::uint32_t eq(reg a, reg b) noexcept
+    {
+        return mask(a, b, [](std::int32_t x, std::int32_t y) { return x == y; });
+    }
+
+    template <unsigned int F, bool R>
+    static reg mul_wide(reg a, reg b) noexcept
+    {
+        return map(a, b, [](std::int32_t x, std::int32_t y) {
+            return fixed<std::int32_t, std::int64_t, F, R>(
+                fixed<std::int32_t, std::int64_t, F, R>::from_raw_value(x) *
+                fixed<std::int32_t, std::int64_t, F, R>::from_raw_value(y)).raw_value();
+        });
+    }
+};
+
+#if defined(__SSE4_1__) || defined(__AVX__)
+template <>
+struct backend<sse41, 4>
+{
+    using reg = __m128i;
+
+    static std::int32_t lane(reg v, unsigned int j) noexcept
+    {
+        alignas(16) std::int32_t t[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(t), v);
+        return t[j];
+    }
+
+    static reg set1(std::int32_t v) noexcept { return _mm_set1_epi32(v); }
+    static reg load(const std::int32_t* p) noexcept { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+    static void store(std::int32_t* p, reg v) noexcept { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+    static reg load16(const std::int16_t* p) noexcept
+    {
+        return _mm_cvtepi16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+    }
+    static void store16(std::int16_t* p, reg v) noexcept
+    {
+        // low halves, truncated like the cast (packs would saturate)
+        const __m128i low = _mm_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_shuffle_epi8(v, low));
+    }
+
+    static reg add(reg a, reg b) noexcept { return _mm_add_epi32(a, b); }
+    static reg sub(reg a, reg b) noexcept { return _mm_sub_epi32(a, b); }
+    static reg mullo(reg a, reg b) noexcept { return _mm_mullo_epi32(a, b); }
+    static reg min(reg a, reg b) noexcept { return _mm_min_epi32(a, b); }
+    static reg max(reg a, reg b) noexcept { return _mm_max_epi32(a, b); }
+    static reg and_(reg a, reg b) noexcept { return _mm_and_si128(a, b); }
+    static reg or_(reg a, reg b) noexcept { return _mm_or_si128(a, b); }
+    static reg xor_(reg a, reg b) noexcept { return _mm_xor_si128(a, b); }
+    static reg sra(reg a, int n) noexcept { return _mm_sra_epi32(a, _mm_cvtsi32_si128(n)); }
+    static reg sll(reg a, int n) noexcept { return _mm_sll_epi32(a, _mm_cvtsi32_si128(n)); }
+    static reg srl(reg a, int n) noexcept { return _mm_srl_epi32(a, _mm_cvtsi32_si128(n)); }
+    static std::uint32_t gt(reg a, reg b) noexcept { return std::uint32_t(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(a, b)))); }
+    static std::uint32_t eq(reg a, reg b) noexcept { return std::uint32_t(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(a, b)))); }
+
+    static reg set1_64(std::int64_t v) noexcept { return _mm_set1_epi64x(v); }
+    static reg add64(reg a, reg b) noexcept { return _mm_add_epi64(a, b); }
+    static reg sub64(reg a, reg b) noexcept { return _mm_sub_epi64(a, b); }
+    static reg srl64(reg a, int n) noexcept { return _mm_srl_epi64(a, _mm_cvtsi32_si128(n)); }
+    static reg mul_even(reg a, reg b) noexcept { return _mm_mul_epi32(a, b); }
+    static reg interleave(reg even, reg odd) noexcept { return _mm_blend_epi16(even, _mm_slli_epi64(odd, 32), 0xCC); }
+
+    template <unsigned int F, bool R>
+    static reg mul_wide(reg a, reg b) noexcept { return detail::mul_wide<backend, F, R>(a, b); }
+};
+#endif
+
+#if defined(__AVX2__)
+template <>
+struct backend<avx2, 8>
+{
+    using reg = __m256i;
+
+    static std::int32_t lane(reg v, unsigned int j) noexcept
+    {
+        alignas(32) std::int32_t t[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(t), v);
+        return t[j];
+    }
+
+    static reg set1(std::int32_t v) noexcept { return _mm256_set1_epi32(v); }
+    static reg load(const std::int32_t* p) noexcept { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+    static void store(std::int32_t* p, reg v) noexcept { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+    static reg load16(const std::int16_t* p) noexcept
+    {
+        return _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    }
+    static void store16(std::int16_t* p, reg v) noexcept
+    {
+        // low halves to the low 8 bytes of each 128 bit lane, then together
+        const __m256i low = _mm256_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1,
+                                             0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1);
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(v, low), 0x08);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm256_castsi256_si128(packed));
+    }
+
+    static reg add(reg a, reg b) noexcept { return _mm256_add_epi32(a, b); }
+    static reg sub(reg a, reg b) noexcept { return _mm256_sub_epi32(a, b); }
+    static reg mullo(reg a, reg b) noexcept { return _mm256_mullo_epi32(a, b); }
+    static reg min(reg a, reg b) noexcept { return _mm256_min_epi32(a, b); }
+    static reg max(reg a, reg b) noexcept { return _mm256_max_epi32(a, b); }
+    static reg and_(reg a, reg b) noexcept { return _mm256_and_si256(a, b); }
+    static reg or_(reg a, reg b) noexcept { return _mm256_or_si256(a, b); }
+    static reg xor_(reg a, reg b) noexcept { return _mm256_xor_si256(a, b); }
+    static reg sra(reg a, int n) noexcept { return _mm256_sra_epi32(a, _mm_cvtsi32_si128(n)); }
+    static reg sll(reg a, int n) noexcept { return _mm256_sll_epi32(a, _mm_cvtsi32_si128(n)); }
+    static reg srl(reg a, int n) noexcept { return _mm256_srl_epi32(a, _mm_cvtsi32_si128(n)); }
+    static std::uint32_t gt(reg a, reg b) noexcept { return std::uint32_t(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(a, b)))); }
+    static std::uint32_t eq(reg a, reg b) noexcept { return std::uint32_t(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b)))); }
+
+    static reg set1_64(std::int64_t v) noexcept { return _mm256_set1_epi64x(v); }
+    static reg add64(reg a, reg b) noexcept { return _mm256_add_epi64(a, b); }
+    static reg sub64(reg a, reg b) noexcept { return _mm256_sub_epi64(a, b); }
+    static reg srl64(reg a, int n) noexcept { return _mm256_srl_epi64(a, _mm_cvtsi32_si128(n)); }
+    static reg mul_even(reg a, reg b) noexcept { return _mm256_mul_epi32(a, b); }
+    static reg interleave(reg even, reg odd) noexcept { return _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA); }
+
+    template <unsigned int F, bool R>
+    static reg mul_wide(reg a, reg b) noexcept { return detail::mul_wide<backend, F, R>(a, b); }
+};
+#endif
+
+#if defined(__AVX512F__)
+template <>
+struct backend<avx512, 16>
+{
+    using reg = __m512i;
+
+    static std::int32_t lane(reg v, unsigned int j) noexcept
+    {
+        alignas(64) std::int32_t t[16];
+        _mm512_store_si512(t, v);
+        return t[j];
+    }
+
+    static reg set1(std::int32_t v) noexcept { return _mm512_set1_epi32(v); }
+    static reg load(const std::int32_t* p) noexcept { return _mm512_loadu_si512(p); }
+    static void store(std::int32_t* p, reg v) noexcept { _mm512_storeu_si512(p, v); }
+    static reg load16(const std::int16_t* p) noexcept
+    {
+        return _mm512_cvtepi16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+    }
+    static void store16(std::int16_t* p, reg v) noexcept
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), _mm512_cvtepi32_epi16(v));
+    }
+
+    static reg add(reg a, reg b) noexcept { return _mm512_add_epi32(a, b); }
+    static reg sub(reg a, reg b) noexcept { return _mm512_sub_epi32(a, b); }
+    static reg mullo(reg a, reg b) noexcept { return _mm512_mullo_epi32(a, b); }
+    static reg min(reg a, reg b) noexcept { return _mm512_min_epi32(a, b); }
+    static reg max(reg a, reg b) noexcept { return _mm512_max_epi32(a, b); }
+    static reg and_(reg a, reg b) noexcept { return _mm512_and_si512(a, b); }
+    static reg or_(reg a, reg b) noexcept { return _mm512_or_si512(a, b); }
+    static reg xor_(reg a, reg b) noexcept { return _mm512_xor_si512(a, b); }
+    static reg sra(reg a, int n) noexcept { return _mm512_sra_epi32(a, _mm_cvtsi32_si128(n)); }
+    static reg sll(reg a, int n) noexcept { return _mm512_sll_epi32(a, _mm_cvtsi32_si128(n)); }
+    static reg srl(reg a, int n) noexcept { return _mm512_srl_epi32(a, _mm_cvtsi32_si128(n)); }
+    static std::uint32_t gt(reg a, reg b) noexcept { return _mm512_cmpgt_epi32_mask(a, b); }
+    static std::uint32_t eq(reg a, reg b) noexcept { return _mm512_cmpeq_epi32_mask(a, b); }
+
+    static reg set1_64(std::int64_t v) noexcept { return _mm512_set1_epi64(v); }
+    static reg add64(reg a, reg b) noexcept { return _mm512_add_epi64(a, b); }
+    static reg sub64(reg a, reg b) noexcept { return _mm512_sub_epi64(a, b); }
+    static reg srl64(reg a, int n) noexcept { return _mm512_srl_epi64(a, _mm_cvtsi32_si128(n)); }
+    static reg mul_even(reg a, reg b) noexcept { return _mm512_mul_epi32(a, b); }
+    static reg interleave(reg even, reg odd) noexcept { return _mm512_mask_blend_epi32(0xAAAA, even, _mm512_slli_epi64(odd, 32)); }
+
+    template <unsigned int F, bool R>
+    static reg mul_wide(reg a, reg b) noexcept { return detail::mul_wide<backend, F, R>(a, b); }
+};
+#endif
+
+#if defined(__wasm_simd128__)
+template <>
+struct backend<wasm128, 4>
+{
+    using reg = v128_t;
+
+    static std::int32_t lane(reg v, unsigned int j) noexcept
+    {
+        std::int32_t t[4];
+        wasm_v128_store(t, v);
+        return t[j];
+    }
+
+    static reg set1(std::int32_t v) noexcept { return wasm_i32x4_splat(v); }
+    static reg load(const std::int32_t* p) noexcept { return wasm_v128_load(p); }
+    static void store(std::int32_t* p, reg v) noexcept { wasm_v128_store(p, v); }
+    static reg load16(const std::int16_t* p) noexcept { return wasm_i32x4_load16x4(p); }
+    static void store16(std::int16_t* p, reg v) noexcept
+    {
+        const std::int64_t low = wasm_i64x2_extract_lane(wasm_i16x8_shuffle(v, v, 0, 2, 4, 6, 0, 2, 4, 6), 0);
+        std::memcpy(p, &low, sizeof(low));
+    }
+
+    static reg add(reg a, reg b) noexcept { return wasm_i32x4_add(a, b); }
+    static reg sub(reg a, reg b) noexcept { return wasm_i32x4_sub(a, b); }
+    static reg mullo(reg a, reg b) noexcept { return wasm_i32x4_mul(a, b); }
+    static reg min(reg a, reg b) noexcept { return wasm_i32x4_min(a, b); }
+    static reg max(reg a, reg b) noexcept { return wasm_i32x4_max(a, b); }
+    static reg and_(reg a, reg b) noexcept { return wasm_v128_and(a, b); }
+    static reg or_(reg a, reg b) noexcept { return wasm_v128_or(a, b); }
+    static reg xor_(reg a, reg b) noexcept { return wasm_v128_xor(a, b); }
+    static reg sra(reg a, int n) noexcept { return wasm_i32x4_shr(a, n); }
+    static reg sll(reg a, int n) noexcept { return wasm_i32x4_shl(a, n); }
+    static reg srl(reg a, int n) noexcept { return wasm_u32x4_shr(a, n); }
+    static std::uint32_t gt(reg a, reg b) noexcept { return wasm_i32x4_bitmask(wasm_i32x4_gt(a, b)); }
+    static std::uint32_t eq(reg a, reg b) noexcept { return wasm_i32x4_bitmask(wasm_i32x4_eq(a, b)); }
+
+    static reg set1_64(std::int64_t v) noexcept { return wasm_i64x2_splat(v); }
+    static reg add64(reg a, reg b) noexcept { return wasm_i64x2_add(a, b); }
+    static reg sub64(reg a, reg b) noexcept { return wasm_i64x2_sub(a, b); }
+    static reg srl64(reg a, int n) noexcept { return wasm_u64x2_shr(a, n); }
+    static reg mul_even(reg a, reg b) noexcept
+    {
+        // sign extend the low halves, i64x2.mul keeps the low 64 bits
+        return wasm_i64x2_mul(wasm_i64x2_shr(wasm_i64x2_shl(a, 32), 32),
+                              wasm_i64x2_shr(wasm_i64x2_shl(b, 32), 32));
+    }
+    static reg interleave(reg even, reg odd) noexcept { return wasm_i32x4_shuffle(even, odd, 0, 4, 2, 6); }
+
+    template <unsigned int F, bool R>
+    static reg mul_wide(reg a, reg b) noexcept { return detail::mul_wide<backend, F, R>(a, b); }
+};
+#endif
+} // namespace simd
+
+//! Width int32 lanes
+//! \tparam Width the number of lanes
+//! \tparam Arch  the instruction set, see simd::native_t
+template <unsigned int Width, typename Arch = simd::native_t<Width>>
+class int_batch
+{
+    using backend = simd::backend<Arch, Width>;
+
+public:
+    using native_type = typename backend::reg;
+    static constexpr unsigned int width = Width;
+    //! Comparison results have one bit per lane, this one for all of them.
+    static constexpr std::uint32_t all_lanes = Width == 32 ? ~0u : (1u << Width) - 1;
+
+    inline int_batch() noexcept = default;
+
+    // Broadcasts v to every lane.
+    inline int_batch(std::int32_t v) noexcept : m_value(backend::set1(v)) {}
+
+    // Wraps a register, with one lane it is the integer above.
+    template <typename N = native_type, typename std::enable_if<!std::is_same<N, std::int32_t>::value>::type* = nullptr>
+    inline int_batch(native_type v) noexcept : m_value(v) {}
+
+    inline native_type native() const noexcept { return m_value; }
+
+    static inline int_batch load(const std::int32_t* p) noexcept { return from_native(backend::load(p)); }
+    inline void store(std::int32_t* p) const noexcept { backend::store(p, m_value); }
+    //! Sign extends Width int16s.
+    static inline int_batch load(const std::int16_t* p) noexcept { return from_native(backend::load16(p)); }
+    //! Truncates every lane to its low 16 bits.
+    inline void store(std::int16_t* p) const noexcept { backend::store16(p, m_value); }
+
+    inline std::int32_t operator[](unsigned int j) const noexcept { return backend::lane(m_value, j); }
+
+    inline int_batch operator-() const noexcept { return from_native(backend::sub(backend::set1(0), m_value)); }
+
+    inline int_batch& operator+=(int_batch y) noexcept { m_value = backend::add(m_value, y.m_value); return *this; }
+    inline int_batch& operator-=(int_batch y) noexcept { m_value = backend::sub(m_value, y.m_value); return *this; }
+    inline int_batch& operator*=(int_batch y) noexcept { m_value = backend::mullo(m_value, y.m_value); return *this; }
+    inline int_batch& operator&=(int_batch y) noexcept { m_value = backend::and_(m_value, y.m_value); return *this; }
+    inline int_batch& operator|=(int_batch y) noexcept { m_value = backend::or_(m_value, y.m_value); return *this; }
+    inline int_batch& operator^=(int_batch y) noexcept { m_value = backend::xor_(m_value, y.m_value); return *this; }
+    // arithmetic, like >> on int32_t
+    inline int_batch& operator>>=(int n) noexcept { m_value = backend::sra(m_value, n); return *this; }
+    inline int_batch& operator<<=(int n) noexcept { m_value = backend::sll(m_value, n); return *this; }
+
+    friend inline int_batch operator+(int_batch x, int_batch y) noexcept { return x += y; }
+    friend inline int_batch operator-(int_batch x, int_batch y) noexcept { return x -= y; }
+    friend inline int_batch operator*(int_batch x, int_batch y) noexcept { return x *= y; }
+    friend inline int_batch operator&(int_batch x, int_batch y) noexcept { return x &= y; }
+    friend inline int_batch operator|(int_batch x, int_batch y) noexcept { return x |= y; }
+    friend inline int_batch operator^(int_batch x, int_batch y) noexcept { return x ^= y; }
+    friend inline int_batch operator>>(int_batch x, int n) noexcept { return x >>= n; }
+    friend inline int_batch operator<<(int_batch x, int n) noexcept { return x <<= n; }
+
+    friend inline int_batch min(int_batch x, int_batch y) noexcept { return from_native(backend::min(x.m_value, y.m_value)); }
+    friend inline int_batch max(int_batch x, int_batch y) noexcept { return from_native(backend::max(x.m_value, y.m_value)); }
+
+    // Comparisons return a bitmask, bit j for lane j.
+    friend inline std::uint32_t operator==(int_batch x, int_batch y) noexcept { return backend::eq(x.m_value, y.m_value); }
+    friend inline std::uint32_t operator!=(int_batch x, int_batch y) noexcept { return ~backend::eq(x.m_value, y.m_value) & all_lanes; }
+    friend inline std::uint32_t operator>(int_batch x, int_batch y) noexcept { return backend::gt(x.m_value, y.m_value); }
+    friend inline std::uint32_t operator<(int_batch x, int_batch y) noexcept { return backend::gt(y.m_value, x.m_value); }
+    friend inline std::uint32_t operator<=(int_batch x, int_batch y) noexcept { return ~backend::gt(x.m_value, y.m_value) & all_lanes; }
+    friend inline std::uint32_t operator>=(int_batch x, int_batch y) noexcept { return ~backend::gt(y.m_value, x.m_value) & all_lanes; }
+
+private:
+    static inline int_batch from_native(native_type v) noexcept
+    {
+        int_batch r;
+        r.m_value = v;
+        return r;
+    }
+
+    native_type m_value;
+};
+
+//! Width fixed-point numbers, lane j computing exactly what
+//! fixed<BaseType, IntermediateType, FractionBits, EnableRounding> computes.
+//! Lanes are 32 bits wide whatever the BaseType: 16 bit numbers are kept sign
+//! extended and wrapped back after every operation, so both sizes share the
+//! register layout and converting between them costs no shuffles.
+//! \tparam BaseType         int32_t (with an int64_t IntermediateType) or int16_t (with int32_t)
+//! \tparam IntermediateType the integer type of the scalar fixed
+//! \tparam FractionBits     the number of fraction bits
+//! \tparam Width            the number of lanes
+//! \tparam EnableRounding   round the LSB in multiplication and conversion, as fixed does
+//! \tparam Arch             the instruction set, see simd::native_t
+template <typename BaseType, typename IntermediateType, unsigned int FractionBits, unsigned int Width,
+          bool EnableRounding = true, typename Arch = simd::native_t<Width>>
+class fixed_batch
+{
+    static_assert((std::is_same<BaseType, std::int32_t>::value && std::is_same<IntermediateType, std::int64_t>::value) ||
+                  (std::is_same<BaseType, std::int16_t>::value && std::is_same<IntermediateType, std::int32_t>::value),
+                  "fixed_batch lanes are int32_t/int64_t or int16_t/int32_t");
+    static_assert(FractionBits > 0 && FractionBits < sizeof(BaseType) * 8, "FractionBits must leave an integral bit");
+
+    using backend = simd::backend<Arch, Width>;
+    using reg = typename backend::reg;
+    static constexpr bool WIDE = sizeof(BaseType) == 4;
+
+    template <typename B, typename I, unsigned int F, unsigned int W, bool R, typename A>
+    friend class fixed_batch;
+
+public:
+    using value_type = fixed<BaseType, IntermediateType, FractionBits, EnableRounding>;
+    using int_type = int_batch<Width, Arch>;
+    static constexpr unsigned int width = Width;
+
+    inline fixed_batch() noexcept = default;
+
+    // Broadcasts x to every lane.
+    inline explicit fixed_batch(value_type x) noexcept : m_value(backend::set1(x.raw_value())) {}
+
+    template <typename T, typename std::enable_if<std::is_integral<T>::value>::type* = nullptr>
+    inline explicit fixed_batch(T x) noexcept : fixed_batch(value_type(x)) {}
+
+    // Converts every lane like fixed's converting constructor: shifted left
+    // when gaining fraction bits, rounded (or truncated) when losing them.
+    template <typename B, typename I, unsigned int F, bool R>
+    inline explicit fixed_batch(const fixed_batch<B, I, F, Width, R, Arch>& x) noexcept
+    {
+        reg v = x.m_value;
+        if constexpr (F > FractionBits)
+        {
+            constexpr int D = int(F - FractionBits);
+            const reg q = trunc_shift(v, D);
+            if (EnableRounding)
+            {
+                // q plus (v / 2**(D-1)) % 2, which is t - 2q
+                const reg t = trunc_shift(v, D - 1);
+                v = backend::sub(t, q);
+            }
+            else
+                v = q;
+        }
+        else if constexpr (F < FractionBits)
+            v = backend::sll(v, int(FractionBits - F));
+        m_value = wrap(v);
+    }
+
+    //! Lanes must hold BaseType values (sign extended for int16_t).
+    static inline fixed_batch from_raw_value(int_type raw) noexcept { return from_reg(raw.native()); }
+    inline int_type raw_value() const noexcept { return int_type(m_value); }
+
+    static inline fixed_batch load(const value_type* p) noexcept
+    {
+        if constexpr (WIDE)
+            return from_reg(backend::load(reinterpret_cast<const std::int32_t*>(p)));
+        else
+            return from_reg(backend::load16(reinterpret_cast<const std::int16_t*>(p)));
+    }
+
+    inline void store(value_type* p) const noexcept
+    {
+        if constexpr (WIDE)
+            backend::store(reinterpret_cast<std::int32_t*>(p), m_value);
+        else
+            backend::store16(reinterpret_cast<std::int16_t*>(p), m_value);
+    }
+
+    inline value_type operator[](unsigned int j) const noexcept
+    {
+        return value_type::from_raw_value(BaseType(backend::lane(m_value, j)));
+    }
+
+    // Every lane to an integer like fixed's operator T: toward zero.
+    inline explicit operator int_type() const noexcept { return int_type(trunc_shift(m_value, FractionBits)); }
+
+    inline fixed_batch operator-() const noexcept { return from_reg(wrap(backend::sub(backend::set1(0), m_value))); }
+
+    inline fixed_batch& operator+=(const fixed_batch& y) noexcept
+    {
+        m_value = wrap(backend::add(m_value, y.m_value));
+        return *this;
+    }
+
+    inline fixed_batch& operator-=(const fixed_batch& y) noexcept
+    {
+        m_value = wrap(backend::sub(m_value, y.m_value));
+        return *this;
+    }
+
+    inline fixed_batch& operator*=(const fixed_batch& y) noexcept
+    {
+        if constexpr (WIDE)
+            m_value = backend::template mul_wide<FractionBits, EnableRounding>(m_value, y.m_value);
+        else
+            m_value = wrap(simd::detail::mul_narrow<backend, FractionBits, EnableRounding>(m_value, y.m_value));
+        return *this;
+    }
+
+    friend inline fixed_batch operator+(fixed_batch x, const fixed_batch& y) noexcept { return x += y; }
+    friend inline fixed_batch operator-(fixed_batch x, const fixed_batch& y) noexcept { return x -= y; }
+    friend inline fixed_batch operator*(fixed_batch x, const fixed_batch& y) noexcept { return x *= y; }
+
+    friend inline fixed_batch min(const fixed_batch& x, const fixed_batch& y) noexcept { return from_reg(backend::min(x.m_value, y.m_value)); }
+    friend inline fixed_batch max(const fixed_batch& x, const fixed_batch& y) noexcept { return from_reg(backend::max(x.m_value, y.m_value)); }
+
+    // The integral part rounded down, the raw value shifted right by
+    // FractionBits (tile coordinates in the asteroid kernels).
+    friend inline int_type ifloor(const fixed_batch& x) noexcept { return int_type(backend::sra(x.m_value, FractionBits)); }
+
+    // Comparisons return a bitmask, bit j for lane j.
+    friend inline std::uint32_t operator==(const fixed_batch& x, const fixed_batch& y) noexcept { return x.raw_value() == y.raw_value(); }
+    friend inline std::uint32_t operator!=(const fixed_batch& x, const fixed_batch& y) noexcept { return x.raw_value() != y.raw_value(); }
+    friend inline std::uint32_t operator<(const fixed_batch& x, const fixed_batch& y) noexcept { return x.raw_value() < y.raw_value(); }
+    friend inline std::uint32_t operator>(const fixed_batch& x, const fixed_batch& y) noexcept { return x.raw_value() > y.raw_value(); }
+    friend inline std::uint32_t operator<=(const fixed_batch& x, const fixed_batch& y) noexcept { return x.raw_value() <= y.raw_value(); }
+    friend inline std::uint32_t operator>=(const fixed_batch& x, const fixed_batch& y) noexcept { return x.raw_value() >= y.raw_value(); }
+
+private:
+    static inline fixed_batch from_reg(reg v) noexcept
+    {
+        fixed_batch r;
+        r.m_value = v;
+        return r;
+    }
+
+    // back to BaseType, the conversion the scalar code does on assignment
+    static inline reg wrap(reg v) noexcept
+    {
+        if constexpr (WIDE)
+            return v;
+        else
+            return backend::sra(backend::sll(v, 16), 16);
+    }
+
+    // v / 2**n, rounded toward zero like integer division
+    static inline reg trunc_shift(reg v, int n) noexcept
+    {
+        if (n == 0) return v;
+        const reg bias = backend::and_(backend::sra(v, 31), backend::set1((std::int32_t(1) << n) - 1));
+        return backend::sra(backend::add(v, bias), n);
+    }
+
+    reg m_value;
+};
+
+} // namespace fpm
+
+#endif
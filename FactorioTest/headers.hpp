@@ -1,10 +1,12 @@
 ﻿#pragma once
 
+#include <bit>
 #include <bitset>
 #include <vector>
 
 #include "allocator.hpp"
 #include "fpm/fixed.hpp"
+#include "profile.hpp"
 
 #if defined(_MSC_VER)
 #define NOINLINE __declspec(noinline)
@@ -72,49 +74,233 @@ using AlignedVector = vector<T, HugePageAllocator<T>>;
 #define REMOVE_BIT_INDEX 15
 #define REMOVE_BIT (1 << REMOVE_BIT_INDEX)
 
+enum class CompactionMode : uint8_t { Batched, Incremental };
+constexpr uint32_t COMPACTION_INTERVAL = 32;
+
+// The removal flags of the stride layouts, a bit per slot, plus a summary
+// bit per non-zero word so looking for holes skips 4096 live slots per
+// summary word. The kernels read and rewrite whole words every update pass,
+// compaction moves the bits with the asteroids and spawning clears them.
+struct DeadSlotMap {
+    std::vector<uint64_t> words;
+    std::vector<uint64_t> summary;
+
+    bool test(size_t i) const { return (words[i >> 6] >> (i & 63)) & 1; }
+
+    void set(size_t i, bool dead) {
+        auto bit = uint64_t(1) << (i & 63);
+        store(i >> 6, dead ? words[i >> 6] | bit : words[i >> 6] & ~bit);
+    }
+
+    void store(size_t w, uint64_t bits) {
+        words[w] = bits;
+        auto bit = uint64_t(1) << (w & 63);
+        summary[w >> 6] = (summary[w >> 6] & ~bit) | (bits ? bit : 0);
+    }
+
+    void assign(size_t begin, size_t end, bool dead) {
+        for (size_t i = begin; i < end;) {
+            size_t w = i >> 6;
+            size_t n = std::min<size_t>(64 - (i & 63), end - i);
+            uint64_t mask = (n == 64 ? ~uint64_t(0) : (uint64_t(1) << n) - 1)
+                            << (i & 63);
+            store(w, dead ? words[w] | mask : words[w] & ~mask);
+            i += n;
+        }
+    }
+
+    void clear() {
+        std::fill(words.begin(), words.end(), 0);
+        std::fill(summary.begin(), summary.end(), 0);
+    }
+
+    // slots past the old size start out dead
+    void resize(size_t old_size, size_t new_size, size_t capacity) {
+        words.resize((capacity + 63) / 64);
+        summary.resize((words.size() + 63) / 64);
+        if (new_size > old_size)
+            assign(old_size, new_size, true);
+        else
+            assign(new_size, std::min(old_size, words.size() * 64), false);
+    }
+
+    // Takes up to n dead slots in [next, end), lowest first, and clears
+    // them. next is moved past the slots looked at, so the next call
+    // continues from there.
+    uint32_t take(uint32_t n, size_t& next, size_t end, uint32_t* out) {
+        uint32_t got = 0;
+        end = std::min(end, words.size() * 64);
+        while (got < n && next < end) {
+            size_t word = next >> 6;
+            uint64_t s = summary[word >> 6] & (~uint64_t(0) << (word & 63));
+            if (!s) {
+                next = ((word | 63) + 1) * 64;
+                continue;
+            }
+            size_t first = (word & ~size_t(63)) + std::countr_zero(s);
+            if (first != word) next = first * 64;
+            word = first;
+            if (next >= end) break;
+
+            uint64_t bits = words[word] & (~uint64_t(0) << (next & 63));
+            if (word == (end - 1) >> 6 && (end & 63))
+                bits &= (uint64_t(1) << (end & 63)) - 1;
+            uint64_t taken = 0;
+            while (bits && got < n) {
+                uint64_t low = bits & (~bits + 1);
+                out[got++] = uint32_t(word * 64 + std::countr_zero(bits));
+                taken |= low;
+                bits ^= low;
+            }
+            store(word, words[word] & ~taken);
+            next = bits ? word * 64 + std::countr_zero(bits) : (word + 1) * 64;
+        }
+        return got;
+    }
+};
+
+class CompactionPolicy;
+struct RecycleConfig;
+
+// Batched sweeps the whole array whenever the policy says so, every
+// COMPACTION_INTERVAL ticks without one. Incremental sweeps
+// 1/COMPACTION_INTERVAL of it every tick: [0, write) is compacted,
+// [write, read) only holds removed asteroids and [read, size) is not swept
+// yet. It resizes on the interval ticks and ignores the policy.
+struct CompactionState {
+    CompactionMode mode = CompactionMode::Batched;
+    // not owned, nullptr for the fixed interval
+    CompactionPolicy* policy = nullptr;
+    uint32_t tick = 0;
+    uint32_t last_sweep = 0;
+    // removed asteroids in [0, size) after the last update pass
+    uint32_t dead = 0;
+    uint32_t read = 0;
+    uint32_t write = 0;
+    uint32_t slice = 0;
+};
+
+// One column of the arena, indexed like the vector it replaced.
+template <typename T>
+struct Column {
+    T* ptr = nullptr;
+
+    T& operator[](size_t i) { return ptr[i]; }
+    const T& operator[](size_t i) const { return ptr[i]; }
+    T* data() { return ptr; }
+    const T* data() const { return ptr; }
+};
+
+// All five columns live back to back in one huge page arena, each starting at
+// capacity * (bytes of the columns before it). Capacity grows geometrically
+// in multiples of 64 so every column stays 128 byte aligned.
 struct AsteroidStrideArray {
     size_t actual_size = 0;
     size_t capacity = 0;
-
-    AlignedVector<uint32_t> state;
-    AlignedVector<fixed_20_11> position_x;
-    AlignedVector<fixed_20_11> position_y;
-    AlignedVector<fixed_4_11> velocity_x;
-    AlignedVector<fixed_4_11> velocity_y;
+    CompactionState compaction;
+    // authoritative removal flags, state never carries REMOVE_BIT
+    DeadSlotMap dead_slots;
+    // not owned, when set the kernels respawn removed asteroids in place and
+    // never compact
+    RecycleConfig* recycle = nullptr;
+
+    // cold, the update pass never touches it
+    Column<uint32_t> state;
+    Column<fixed_20_11> position_x;
+    Column<fixed_20_11> position_y;
+    Column<fixed_4_11> velocity_x;
+    Column<fixed_4_11> velocity_y;
+
+    // Ticks each asteroid is known to miss every tile, for the map serial
+    // and platform velocity they were counted at. Only the -sleep kernels
+    // keep it, it stays empty otherwise. Sized to the capacity, new slots
+    // start at 0.
+    AlignedVector<int16_t> sleep;
+    uint64_t sleep_serial = 0;
+    int32_t sleep_platform_vel = 0;
+
+    static constexpr size_t COLUMNS = 5;
+    static constexpr size_t COLUMN_BYTES[COLUMNS] = {4, 4, 4, 2, 2};
+    static constexpr size_t BYTES_PER_ASTEROID = 16;
+
+    AsteroidStrideArray() = default;
+    AsteroidStrideArray(const AsteroidStrideArray&) = delete;
+    AsteroidStrideArray& operator=(const AsteroidStrideArray&) = delete;
+    ~AsteroidStrideArray() {
+        huge_page_free(arena, capacity * BYTES_PER_ASTEROID);
+    }
 
     inline size_t size() const { return actual_size; }
 
+    // Growing past capacity reallocates, everything else only moves the
+    // size. New slots start out removed, the columns are not touched.
     void resize(size_t new_size) {
-        int64_t old_size = actual_size;
+        size_t old_size = actual_size;
+        if (new_size > capacity)
+            reserve(std::max(new_size, capacity + capacity / 2));
         actual_size = new_size;
-        // printf("Resizing asteroid stride array: %zu -> %zu\n", old_size,
-        // new_size); round up to multiple of 4 or 8 or 16
-        constexpr size_t mask = 0xF;
-        capacity = new_size = (new_size + mask) & ~static_cast<size_t>(mask);
-
-        state.resize(new_size);
-        position_x.resize(new_size);
-        position_y.resize(new_size);
-        velocity_x.resize(new_size);
-        velocity_y.resize(new_size);
-
-        int64_t c = int64_t(new_size) - old_size;
-        if (c > 0) {
-            std::fill_n(&state[old_size], c, REMOVE_BIT);
-            AsteroidChunkFlag zero{};
-            std::fill_n(&position_x[old_size], c, fixed_20_11(0));
-            std::fill_n(&position_y[old_size], c, fixed_20_11(0));
-            std::fill_n(&velocity_x[old_size], c, fixed_4_11(0));
-            std::fill_n(&velocity_y[old_size], c, fixed_4_11(0));
+        dead_slots.resize(old_size, actual_size, capacity);
+        if (!sleep.empty()) {
+            sleep.resize(capacity);
+            if (new_size > old_size)
+                std::fill(sleep.begin() + old_size, sleep.begin() + new_size,
+                          int16_t(0));
         }
     }
 
-    void shrink() {
-        state.shrink_to_fit();
-        position_x.shrink_to_fit();
-        position_y.shrink_to_fit();
-        velocity_x.shrink_to_fit();
-        velocity_y.shrink_to_fit();
+    // capacity down to the size
+    void shrink() { reserve(actual_size); }
+
+   private:
+    void* arena = nullptr;
+
+    size_t column_offset(size_t c, size_t cap) const {
+        size_t offset = 0;
+        for (size_t i = 0; i < c; i++) offset += COLUMN_BYTES[i];
+        return offset * cap;
+    }
+
+    // Moves the live part of every column from the old layout to the new
+    // one, back to front when growing and front to back when shrinking so
+    // nothing is overwritten before it moved.
+    void move_columns(size_t old_cap, size_t new_cap) {
+        auto base = static_cast<char*>(arena);
+        size_t n = std::min(actual_size, std::min(old_cap, new_cap));
+        for (size_t k = 1; k < COLUMNS; k++) {
+            size_t c = new_cap > old_cap ? COLUMNS - k : k;
+            memmove(base + column_offset(c, new_cap),
+                    base + column_offset(c, old_cap), n * COLUMN_BYTES[c]);
+        }
+    }
+
+    void layout() {
+        auto base = static_cast<char*>(arena);
+        state.ptr = reinterpret_cast<uint32_t*>(base);
+        position_x.ptr =
+            reinterpret_cast<fixed_20_11*>(base + column_offset(1, capacity));
+        position_y.ptr =
+            reinterpret_cast<fixed_20_11*>(base + column_offset(2, capacity));
+        velocity_x.ptr =
+            reinterpret_cast<fixed_4_11*>(base + column_offset(3, capacity));
+        velocity_y.ptr =
+            reinterpret_cast<fixed_4_11*>(base + column_offset(4, capacity));
+    }
+
+    void reserve(size_t new_cap) {
+        new_cap = (new_cap + 63) & ~size_t(63);
+        if (new_cap == capacity) return;
+        size_t old_cap = capacity;
+        if (new_cap > old_cap) {
+            arena = huge_page_realloc(arena, old_cap * BYTES_PER_ASTEROID,
+                                      new_cap * BYTES_PER_ASTEROID);
+            move_columns(old_cap, new_cap);
+        } else {
+            move_columns(old_cap, new_cap);
+            arena = huge_page_realloc(arena, old_cap * BYTES_PER_ASTEROID,
+                                      new_cap * BYTES_PER_ASTEROID);
+        }
+        capacity = new_cap;
+        layout();
     }
 };
 
@@ -138,11 +324,11 @@ static inline int32_t clamp(int32_t x, int32_t lo, int32_t hi) {
     return x;
 }
 
-static inline uint32_t mod32(int32_t val) { return ((val & 31) + 32) & 31; };
-
-static inline int32_t div32(int32_t val) { return val >> 5; };
-
-class Map;
+template <uint32_t CHUNK, bool SPARSE = false>
+class BasicMap;
+using Map = BasicMap<32>;
+// the superchunk grid, for the -sparse kernels
+using SparseMap = BasicMap<32, true>;
 
 NOINLINE void update_asteroids_double(vector<AsteroidDouble>& asteroids,
                                       const Map* map, double platform_vel);
@@ -150,13 +336,26 @@ NOINLINE void update_asteroids_double(vector<AsteroidDouble>& asteroids,
 NOINLINE void update_asteroids_fixed(vector<AsteroidFixed>& asteroids,
                                      const Map* map, double platform_vel);
 
+// the scalar and AVX2 stride instantiations of tick_asteroids (tick.hpp)
+// under their old names, for the NUMA kernels and the wasm build
 NOINLINE void update_asteroids_fixed(AsteroidStrideArray& asteroids,
                                      const Map* map, double platform_vel);
 
+class AsteroidQuantizedArray;
+NOINLINE void update_asteroids_quantized(AsteroidQuantizedArray& asteroids,
+                                         const Map* map, double platform_vel);
+
 #ifndef __EMSCRIPTEN__
 NOINLINE void update_asteroids_avx2(AsteroidStrideArray& asteroids,
                                     const Map* map, double platform_vel);
-// no perf improvement, removed for failing validation somehow
-// NOINLINE void update_asteroids_avx512(AsteroidStrideArray& asteroids,
-//                                       const Map* map, double platform_vel);
+NOINLINE void update_asteroids_quantized_avx2(
+    AsteroidQuantizedArray& asteroids, const Map* map, double platform_vel);
+#endif
+
+// fpm/simd.hpp against the scalar fpm::fixed with the instruction sets of
+// each translation unit, the number of lanes that differ (simd_check.hpp)
+uint64_t simd_check_scalar(uint32_t seed, uint32_t rounds);
+#ifndef __EMSCRIPTEN__
+uint64_t simd_check_avx2(uint32_t seed, uint32_t rounds);
+uint64_t simd_check_avx512(uint32_t seed, uint32_t rounds);
 #endif
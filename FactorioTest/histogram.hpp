@@ -0,0 +1,146 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "profile.hpp"
+
+// HdrHistogram-style log-linear histogram: exact below 128, above that
+// every power of two is split into 64 linear buckets, so any recorded
+// value is reported within 1/64 (~1.6%) of itself.
+class LatencyHistogram {
+    static constexpr uint32_t SUB_BITS = 6;
+    static constexpr uint32_t SUB = 1 << SUB_BITS;  // buckets per octave
+    static constexpr uint32_t LINEAR = SUB * 2;     // exact range
+    static constexpr uint32_t BUCKETS = LINEAR + (64 - SUB_BITS - 1) * SUB;
+
+    std::vector<uint64_t> counts = std::vector<uint64_t>(BUCKETS);
+    uint64_t total = 0;
+    uint64_t max_value = 0;
+
+    static uint32_t msb(uint64_t v) {
+        uint32_t n = 0;
+        while (v >>= 1) n++;
+        return n;
+    }
+
+    static uint32_t index_of(uint64_t v) {
+        if (v < LINEAR) return uint32_t(v);
+        uint32_t shift = msb(v) - SUB_BITS;  // >= 1
+        uint32_t top = uint32_t(v >> shift);  // [SUB, 2 * SUB)
+        return LINEAR + (shift - 1) * SUB + (top - SUB);
+    }
+
+    // highest value that maps to the bucket
+    static uint64_t value_of(uint32_t index) {
+        if (index < LINEAR) return index;
+        uint32_t shift = (index - LINEAR) / SUB + 1;
+        uint64_t top = (index - LINEAR) % SUB + SUB;
+        return ((top + 1) << shift) - 1;
+    }
+
+   public:
+    void record(uint64_t value) {
+        counts[index_of(value)]++;
+        total++;
+        max_value = std::max(max_value, value);
+    }
+
+    void reset() {
+        std::fill(counts.begin(), counts.end(), 0);
+        total = 0;
+        max_value = 0;
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t max() const { return max_value; }
+
+    // p in [0, 100]
+    uint64_t percentile(double p) const {
+        if (!total) return 0;
+        uint64_t rank = uint64_t(p / 100.0 * double(total) + 0.5);
+        rank = std::min(std::max<uint64_t>(rank, 1), total);
+        uint64_t seen = 0;
+        for (uint32_t i = 0; i < BUCKETS; i++) {
+            seen += counts[i];
+            if (seen >= rank) return std::min(value_of(i), max_value);
+        }
+        return max_value;
+    }
+};
+
+struct TickSample {
+    uint64_t tick = 0;
+    uint64_t total_ns = 0;
+    uint64_t phase_ns[PHASE_COUNT] = {};
+};
+
+// Times every tick and every phase inside it. Phases that did not run in a
+// tick are not recorded for that tick, so the compaction histogram only
+// holds the ticks that actually compacted.
+class TickProfiler : public PhaseListener {
+    using clock = std::chrono::steady_clock;
+
+    clock::time_point tick_start;
+    clock::time_point phase_start[PHASE_COUNT];
+    TickSample current;
+    bool ran[PHASE_COUNT] = {};
+    uint64_t tick_counter = 0;
+
+    static uint64_t ns_since(clock::time_point t) {
+        return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            clock::now() - t)
+                            .count());
+    }
+
+   public:
+    LatencyHistogram ticks;
+    LatencyHistogram phases[PHASE_COUNT];
+    // slowest ticks, sorted slowest first
+    std::vector<TickSample> worst;
+    uint32_t keep_worst = 8;
+
+    void reset() {
+        ticks.reset();
+        for (auto& h : phases) h.reset();
+        worst.clear();
+        tick_counter = 0;
+    }
+
+    void tick_begin() override {
+        current = TickSample{};
+        current.tick = tick_counter++;
+        for (auto& r : ran) r = false;
+        tick_start = clock::now();
+    }
+
+    void tick_end() override {
+        current.total_ns = ns_since(tick_start);
+        ticks.record(current.total_ns);
+        for (uint32_t p = 0; p < PHASE_COUNT; p++)
+            if (ran[p]) phases[p].record(current.phase_ns[p]);
+
+        if (worst.size() < keep_worst ||
+            current.total_ns > worst.back().total_ns) {
+            auto it = std::upper_bound(
+                worst.begin(), worst.end(), current,
+                [](const TickSample& a, const TickSample& b) {
+                    return a.total_ns > b.total_ns;
+                });
+            worst.insert(it, current);
+            if (worst.size() > keep_worst) worst.pop_back();
+        }
+    }
+
+    void phase_begin(Phase phase) override {
+        phase_start[uint32_t(phase)] = clock::now();
+    }
+
+    void phase_end(Phase phase) override {
+        auto p = uint32_t(phase);
+        current.phase_ns[p] += ns_since(phase_start[p]);
+        ran[p] = true;
+    }
+};
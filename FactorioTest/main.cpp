@@ -1,11 +1,24 @@
 #include <chrono>
 #include <iostream>
+#include <memory>
 #include <random>
 #include <set>
 #include <string>
 
+#include "blocks.hpp"
+#include "compaction.hpp"
 #include "fpm/ios.hpp"
+#include "histogram.hpp"
 #include "map.hpp"
+#include "perf.hpp"
+#include "quantized.hpp"
+#include "report.hpp"
+#include "spawn.hpp"
+#include "tick.hpp"
+
+#ifndef __EMSCRIPTEN__
+#include "numa.hpp"
+#endif
 
 using namespace std;  // so joever
 using namespace chrono;
@@ -18,115 +31,256 @@ constexpr double Y_OFFSET = 20.0;
 
 static inline void print_asteroid(const AsteroidStrideArray& asteroids,
                                   uint32_t index) {
-    printf("pro: %d, ", asteroids.state[index] >> 16);
-    printf("tbd: %s, ",
-           (asteroids.state[index] & REMOVE_BIT ? "true" : "false"));
+    fprintf(stderr, "pro: %d, ", asteroids.state[index] >> 16);
+    fprintf(stderr, "tbd: %s, ",
+            (asteroids.dead_slots.test(index) ? "true" : "false"));
 
-    printf(
-        "pos: (%f, %f)\n",
+    fprintf(
+        stderr, "pos: (%f, %f)\n",
         asteroids.position_x[index].raw_value() / double(1 << FRACTION_BITS),
         asteroids.position_y[index].raw_value() / double(1 << FRACTION_BITS));
 }
 
-static inline uniform_int_distribution<uint16_t> proto_dist(0, 3);
-static inline uniform_real_distribution<double> pos_dist_x(-X_RANGE, X_RANGE);
-static inline uniform_real_distribution<double> pos_dist_y(-Y_RANGE, Y_RANGE);
-static inline uniform_real_distribution<double> vel_dist(-V_RANGE, V_RANGE);
+static const SpawnBox populate_box =
+    SpawnBox::from(-X_RANGE, X_RANGE, Y_OFFSET - Y_RANGE, Y_OFFSET + Y_RANGE,
+                   V_RANGE);
 
 static Map* static_map;
 
+// Every layout starts from the same philox values, so the result does not
+// depend on the layout, the thread count or whether AVX2 was used.
+template <typename Write>
+static inline void populate_batched(size_t n, uint32_t seed, uint32_t threads,
+                                    Write&& write) {
+    parallel_ranges(n, threads, [&](size_t first, size_t count) {
+        SpawnBatch batch;
+        for (size_t i = 0; i < count; i += SpawnBatch::SIZE) {
+            auto k = uint32_t(std::min<size_t>(SpawnBatch::SIZE, count - i));
+            generate_asteroids(populate_box, seed, RNG_POPULATE, first + i, k,
+                               batch.columns());
+            for (uint32_t j = 0; j < k; j++) write(first + i + j, batch, j);
+        }
+    });
+}
+
 static inline void populate_asteroids(vector<AsteroidDouble>& asteroids,
-                                      uint32_t seed) {
-    printf("Populating %zu asteroids with seed %d...", asteroids.size(), seed);
-    mt19937 rng(seed);
-    for (uint32_t i = 0; i < asteroids.size(); i++) {
-        auto&& asteroid = asteroids[i];
+                                      uint32_t seed, uint32_t threads = 0) {
+    fprintf(stderr, "Populating %zu asteroids with seed %d...",
+            asteroids.size(), seed);
+    populate_batched(asteroids.size(), seed, threads,
+                     [&](size_t i, const SpawnBatch& batch, uint32_t j) {
+                         auto&& asteroid = asteroids[i];
 
-        asteroid.prototype_id = proto_dist(rng);
-        asteroid.non_game_state_index = 0;
-        asteroid.flag.data = 0;
-        asteroid.position.x = (pos_dist_x(rng));
-        asteroid.position.y = (pos_dist_y(rng)) + Y_OFFSET;
-        asteroid.velocity.x = (vel_dist(rng));
-        asteroid.velocity.y = (vel_dist(rng));
-    }
-    printf("  done\n");
+                         asteroid.prototype_id = batch.state[j] >> 16;
+                         asteroid.non_game_state_index = 0;
+                         asteroid.flag.data = 0;
+                         asteroid.position.x = double(batch.position_x[j]);
+                         asteroid.position.y = double(batch.position_y[j]);
+                         asteroid.velocity.x = double(batch.velocity_x[j]);
+                         asteroid.velocity.y = double(batch.velocity_y[j]);
+                     });
+    fprintf(stderr, "  done\n");
 }
 
 static inline void populate_asteroids(vector<AsteroidFixed>& asteroids,
-                                      uint32_t seed) {
-    printf("Populating %zu asteroids with seed %d...", asteroids.size(), seed);
-    mt19937 rng(seed);
-    for (uint32_t i = 0; i < asteroids.size(); i++) {
-        auto&& asteroid = asteroids[i];
+                                      uint32_t seed, uint32_t threads = 0) {
+    fprintf(stderr, "Populating %zu asteroids with seed %d...",
+            asteroids.size(), seed);
+    populate_batched(asteroids.size(), seed, threads,
+                     [&](size_t i, const SpawnBatch& batch, uint32_t j) {
+                         auto&& asteroid = asteroids[i];
 
-        asteroid.state =
-            (proto_dist(rng) << 16) | (rng() & (0xFFFF ^ REMOVE_BIT));
-        asteroid.flag.data = 0;
-        asteroid.position.x = fixed_20_11(pos_dist_x(rng));
-        asteroid.position.y =
-            fixed_20_11(pos_dist_y(rng)) + fixed_20_11(Y_OFFSET);
-        asteroid.velocity.x = fixed_4_11(vel_dist(rng));
-        asteroid.velocity.y = fixed_4_11(vel_dist(rng));
-    }
-    printf("  done\n");
+                         asteroid.state = batch.state[j];
+                         asteroid.flag.data = 0;
+                         asteroid.position.x = batch.position_x[j];
+                         asteroid.position.y = batch.position_y[j];
+                         asteroid.velocity.x = batch.velocity_x[j];
+                         asteroid.velocity.y = batch.velocity_y[j];
+                     });
+    fprintf(stderr, "  done\n");
 }
 
+template <uint32_t W>
+static inline void populate_asteroids(AsteroidBlockArray<W>& asteroids,
+                                      uint32_t seed, uint32_t threads = 0) {
+    fprintf(stderr, "Populating %zu asteroids with seed %d...",
+            asteroids.size(), seed);
+    asteroids.dead_slots.clear();
+    populate_batched(asteroids.size(), seed, threads,
+                     [&](size_t i, const SpawnBatch& batch, uint32_t j) {
+                         auto& block = asteroids.block_of(i);
+                         auto k = i % W;
+
+                         block.state[k] = batch.state[j];
+                         block.position_x[k] = batch.position_x[j];
+                         block.position_y[k] = batch.position_y[j];
+                         block.velocity_x[k] = batch.velocity_x[j];
+                         block.velocity_y[k] = batch.velocity_y[j];
+                     });
+    fprintf(stderr, "  done\n");
+}
+
+// buckets are shared, so one thread sorts the asteroids into their cells
+static inline void populate_asteroids(AsteroidQuantizedArray& asteroids,
+                                      uint32_t seed, uint32_t = 0) {
+    fprintf(stderr, "Populating %zu asteroids with seed %d...",
+            asteroids.populate_count, seed);
+    populate_batched(asteroids.populate_count, seed, 1,
+                     [&](size_t i, const SpawnBatch& batch, uint32_t j) {
+                         asteroids.insert(uint32_t(i), batch.state[j],
+                                          batch.position_x[j].raw_value(),
+                                          batch.position_y[j].raw_value(),
+                                          batch.velocity_x[j],
+                                          batch.velocity_y[j]);
+                     });
+    fprintf(stderr, "  done (%zu cells)\n", asteroids.buckets.size());
+}
+
+// straight into the columns, no batch in between
 static inline void populate_asteroids(AsteroidStrideArray& asteroids,
-                                      uint32_t seed) {
-    printf("Populating %zu asteroids with seed %d...", asteroids.size(), seed);
-    mt19937 rng(seed);
-    for (uint32_t i = 0; i < asteroids.size(); i++) {
-        asteroids.state[i] =
-            (proto_dist(rng) << 16) | (rng() & (0xFFFF ^ REMOVE_BIT));
-        asteroids.position_x[i] = fixed_20_11(pos_dist_x(rng));
-        asteroids.position_y[i] =
-            fixed_20_11(pos_dist_y(rng)) + fixed_20_11(Y_OFFSET);
-        asteroids.velocity_x[i] = fixed_4_11(vel_dist(rng));
-        asteroids.velocity_y[i] = fixed_4_11(vel_dist(rng));
-    }
+                                      uint32_t seed, uint32_t threads = 0) {
+    fprintf(stderr, "Populating %zu asteroids with seed %d...",
+            asteroids.size(), seed);
+    auto start = high_resolution_clock::now();
 
-    printf("  done\n");
+    asteroids.dead_slots.clear();
+    auto columns = columns_of(asteroids);
+    parallel_ranges(asteroids.size(), threads, [&](size_t first, size_t n) {
+        generate_asteroids(populate_box, seed, RNG_POPULATE, first,
+                           uint32_t(n), columns.offset(first));
+    });
+
+    fprintf(stderr, "  done (%.1f ms)\n",
+            duration<double, milli>(high_resolution_clock::now() - start)
+                .count());
 }
 
-static inline bool validate(const vector<AsteroidFixed>& a1,
-                            const AsteroidStrideArray& a2) {
-    if (a1.size() != a2.size()) {
-        printf("Validation failed: size mismatch!\n");
+#ifndef __EMSCRIPTEN__
+// every partition is generated by its own worker, from its first index on
+static inline void populate_asteroids(NumaStrideArray& asteroids,
+                                      uint32_t seed, uint32_t = 0) {
+    fprintf(stderr, "Populating %zu asteroids with seed %d in %u partitions...",
+            asteroids.size(), seed, asteroids.partitions());
+    auto start = high_resolution_clock::now();
+
+    asteroids.workers.run([&](uint32_t k) {
+        auto& part = asteroids.part(k);
+        part.dead_slots.clear();
+        generate_asteroids(populate_box, seed, RNG_POPULATE,
+                           asteroids.first[k], uint32_t(part.size()),
+                           columns_of(part));
+    });
+
+    fprintf(stderr, "  done (%.1f ms)\n",
+            duration<double, milli>(high_resolution_clock::now() - start)
+                .count());
+}
+#endif
+
+static inline void print_asteroid(const AsteroidFixed& asteroid) {
+    fprintf(stderr, "pro: %d, ", asteroid.state >> 16);
+    fprintf(stderr, "tbd: %s, ",
+            (asteroid.flag.data & TBD_FLAG ? "true" : "false"));
+    fprintf(stderr, "pos: (%f, %f)\n",
+            asteroid.position.x.raw_value() / double(1 << FRACTION_BITS),
+            asteroid.position.y.raw_value() / double(1 << FRACTION_BITS));
+}
+
+// The reference population after the warmup and timed ticks. The swept
+// kernels are conservative at tile corners, so a swept reference also flags
+// the asteroids that went through the corner of a set tile without hitting
+// one: those may be missing from the kernel's population.
+struct Reference {
+    vector<AsteroidFixed> asteroids;
+    vector<bool> maybe;
+
+    bool may_miss(size_t i) const { return i < maybe.size() && maybe[i]; }
+};
+
+static inline bool same(const AsteroidFixed& a1, const AsteroidFixed& a2) {
+    return a1.state == a2.state && a1.position.x == a2.position.x &&
+           a1.position.y == a2.position.y && a1.velocity.x == a2.velocity.x &&
+           a1.velocity.y == a2.velocity.y;
+}
+static inline bool same(const AsteroidFixed& a1, const AsteroidStrideArray& a2,
+                        uint32_t j) {
+    return a1.state == a2.state[j] && a1.position.x == a2.position_x[j] &&
+           a1.position.y == a2.position_y[j] &&
+           a1.velocity.x == a2.velocity_x[j] &&
+           a1.velocity.y == a2.velocity_y[j];
+}
+
+// a2 may lack the asteroids ref.maybe flags, the others must all be there in
+// the same order
+static inline bool validate(const Reference& ref,
+                            const vector<AsteroidFixed>& a2) {
+    const auto& a1 = ref.asteroids;
+    if (ref.maybe.empty() && a1.size() != a2.size()) {
+        fprintf(stderr, "Validation failed: size mismatch!\n");
         return false;
     } else
-        printf("Validating %zu asteroids... ", a1.size());
+        fprintf(stderr, "Validating %zu asteroids... ", a1.size());
 
+    uint32_t j = 0;
     for (uint32_t i = 0; i < a1.size(); i++) {
-        const auto& asteroid1 = a1[i];
-        const auto& asteroid2_stat = a2.state[i];
-        const auto& asteroid2_posx = a2.position_x[i];
-        const auto& asteroid2_posy = a2.position_y[i];
-        const auto& asteroid2_velx = a2.velocity_x[i];
-        const auto& asteroid2_vely = a2.velocity_y[i];
-
-        if (asteroid1.state != asteroid2_stat ||
-            asteroid1.position.x != asteroid2_posx ||
-            asteroid1.position.y != asteroid2_posy ||
-            asteroid1.velocity.x != asteroid2_velx ||
-            asteroid1.velocity.y != asteroid2_vely) {
-            printf("failed at index %d!\n", i);
-            printf("A1[%d]: ", i);
-            printf("tbd: %s, ",
-                   (asteroid1.flag.data & TBD_FLAG ? "true" : "false"));
-            printf(
-                "pos: (%f, %f), ",
-                asteroid1.position.x.raw_value() / double(1 << FRACTION_BITS),
-                asteroid1.position.y.raw_value() / double(1 << FRACTION_BITS));
-            printf("\n");
-            printf("A2[%d]: ", i);
-            print_asteroid(a2, i);
-            printf("\n");
+        if (j < a2.size() && same(a1[i], a2[j])) {
+            j++;
+            continue;
+        }
+        if (ref.may_miss(i)) continue;
+        if (j >= a2.size()) {
+            fprintf(stderr, "failed: size mismatch!\n");
             return false;
         }
+        fprintf(stderr, "failed at index %d!\n", i);
+        fprintf(stderr, "A1[%d]: ", i);
+        print_asteroid(a1[i]);
+        fprintf(stderr, "A2[%d]: ", j);
+        print_asteroid(a2[j]);
+        return false;
+    }
+    if (j != a2.size()) {
+        fprintf(stderr, "failed: size mismatch!\n");
+        return false;
     }
 
-    printf("succeeded\n");
+    fprintf(stderr, "succeeded\n");
+    return true;
+}
+
+// a2 may still hold removed asteroids that have not been compacted yet, those
+// are skipped
+static inline bool validate(const Reference& ref,
+                            const AsteroidStrideArray& a2) {
+    const auto& a1 = ref.asteroids;
+    fprintf(stderr, "Validating %zu asteroids... ", a1.size());
+
+    uint32_t j = 0;
+    for (uint32_t i = 0; i < a1.size(); i++) {
+        while (j < a2.size() && a2.dead_slots.test(j)) j++;
+        if (j < a2.size() && same(a1[i], a2, j)) {
+            j++;
+            continue;
+        }
+        if (ref.may_miss(i)) continue;
+        if (j >= a2.size()) {
+            fprintf(stderr, "failed: size mismatch!\n");
+            return false;
+        }
+        fprintf(stderr, "failed at index %d!\n", i);
+        fprintf(stderr, "A1[%d]: ", i);
+        print_asteroid(a1[i]);
+        fprintf(stderr, "A2[%d]: ", j);
+        print_asteroid(a2, j);
+        return false;
+    }
+    while (j < a2.size() && a2.dead_slots.test(j)) j++;
+    if (j != a2.size()) {
+        fprintf(stderr, "failed: size mismatch!\n");
+        return false;
+    }
+
+    fprintf(stderr, "succeeded\n");
     return true;
 }
 
@@ -134,7 +288,8 @@ static void print_map_tiles() {
     printf("static_map tiles:\n");
     for (int32_t y = 0; y < static_map->grid_h; y++) {
         for (int32_t x = 0; x < static_map->grid_w; x++) {
-            auto tile_index = static_map->tiles[x + y * static_map->grid_w];
+            auto tile_index = static_map->tile_at(x + static_map->x_offset,
+                                                  y + static_map->y_offset);
             if (tile_index) {
                 printf("Tile (%d, %d): \n", (x + static_map->x_offset),
                        (y + static_map->y_offset));
@@ -153,165 +308,1363 @@ static void print_map_tiles() {
     }
 }
 
-#ifdef __EMSCRIPTEN__
-extern "C" {
-int run_bench();
+static AsteroidStrideArray static_asteroids;
+static const uint32_t static_spawn_seed = 69420u * 69420u;
+static RecycleConfig static_recycle;
+
+static struct {
+    double x_offset = 0.0;
+    double x_range = X_RANGE;
+    double y_offset = Y_OFFSET;
+    double y_range = Y_RANGE;
+    double v_range = V_RANGE;
+} rng_bounds;
+
+// rng_bounds clipped to where asteroids can live
+template <typename MapT>
+static SpawnBox spawn_box(const MapT* map) {
+    double l = std::max(double(map->platform_bound.left - BORDER),
+                        rng_bounds.x_offset - rng_bounds.x_range);
+    double r = std::min(double(map->platform_bound.right + BORDER),
+                        rng_bounds.x_offset + rng_bounds.x_range);
+    double b = std::max(double(map->platform_bound.bottom - BORDER),
+                        rng_bounds.y_offset - rng_bounds.y_range);
+    double t = std::min(double(map->platform_bound.top + BORDER),
+                        rng_bounds.y_offset + rng_bounds.y_range);
+
+    return SpawnBox::from(l, r, b + Y_OFFSET, t + Y_OFFSET,
+                          rng_bounds.v_range);
+}
+
+// respawn every asteroid flagged for removal in [0, upper_bound), except the
+// gap of an incremental sweep in progress
+template <typename MapT>
+static void fill_asteroids(AsteroidStrideArray& asteroids, const MapT* map,
+                           uint32_t upper_bound, uint32_t seed,
+                           uint64_t& spawned) {
+    PROFILE_PHASE(Phase::Spawn);
+
+    if (upper_bound > asteroids.size()) asteroids.resize(upper_bound);
+
+    PhiloxSpawn dist{spawn_box(map), seed, spawned};
+    spawn_batch(asteroids, upper_bound, dist, upper_bound);
+}
+
+// square (method 0) or circle (method 1) brush, collects the touched chunks
+template <typename MapT>
+static void brush_map(MapT* map, double x, double y, double radius,
+                      uint32_t method, bool value,
+                      std::set<uint64_t>* chunks = nullptr) {
+    PROFILE_PHASE(Phase::MapEdit);
+
+    for (int32_t j = round(y - radius); j <= round(y + radius); j++) {
+        for (int32_t i = round(x - radius); i <= round(x + radius); i++) {
+            if (method == 1) {
+                double dx = i - x;
+                double dy = j - y;
+                if (dx * dx + dy * dy > radius * radius) continue;
+            }
+            bool updated = value ? map->set(i, j) : map->unset(i, j);
+
+            if (updated && chunks) {
+                TilePosition p = {MapT::chunk_of(i), MapT::chunk_of(j)};
+                chunks->insert(*reinterpret_cast<uint64_t*>(&p));
+            }
+        }
+    }
+    if (!value) map->shrink_bounds();
+}
+
+// --edits: a square block placed at a random spot before even ticks and
+// removed again before odd ones. The reference replays the same sequence.
+struct MapEdits {
+    mt19937 rng;
+    uniform_real_distribution<double> edit_x{-X_RANGE, X_RANGE};
+    uniform_real_distribution<double> edit_y{Y_OFFSET - Y_RANGE,
+                                             Y_OFFSET + Y_RANGE};
+    double x = 0, y = 0;
+    uint32_t tick = 0;
+
+    explicit MapEdits(uint32_t seed) : rng(seed) {}
+
+    template <typename MapT>
+    void apply(MapT* map, uint32_t brush) {
+        bool place = !(tick++ & 1);
+        if (place) x = edit_x(rng), y = edit_y(rng);
+        brush_map(map, x, y, brush, 0, place);
+    }
+};
+
+struct RunParams {
+    uint32_t n;
+    uint32_t seed;
+    uint32_t warmup;
+    uint32_t ticks;
+    // population threads, 0 for all cores
+    uint32_t threads;
+    double velocity;
+    // refill dead slots after every tick (stride layouts only)
+    bool spawn;
+    // respawn in place inside the kernel instead (stride layouts only)
+    bool recycle;
+    // brush radius for a set/unset map edit before every tick, 0 for none
+    uint32_t edits;
+    // how the stride layouts sweep out removed asteroids
+    CompactionMode compaction;
+    // batched sweep policy spec, nullptr for the fixed interval
+    const char* policy;
+    bool log_compaction;
+    // installed for the timed ticks only
+    PhaseListener* listener;
+};
+
+struct RepResult {
+    double ns = 0;
+    // sum of population sizes over the timed ticks
+    uint64_t asteroid_ticks = 0;
+    uint64_t remaining = 0;
+    int32_t valid = -1;
+    // sweeps the policy triggered during the timed ticks, and the mean dead
+    // fraction they saw
+    int64_t sweeps = -1;
+    double sweep_dead_fraction = 0;
+    // asteroids respawned in place during the timed ticks
+    int64_t recycled = -1;
+    // share of the resident arena backed by huge pages, -1 if not measured
+    double huge_pages = -1;
+    // NUMA kernels: ns per asteroid per tick of the workers, "node<id>" for
+    // each node and "part<k>" for each partition if nodes have several
+    vector<std::pair<string, double>> worker_ns;
+    // --spawn or --recycle asked of a store that does neither, nothing ran
+    bool no_spawn = false;
+    // spawn or recycle runs: hash of the survivors in order, 0 if not taken
+    uint64_t survivors = 0;
+    // memory of the map the kernel ticked against, after the last tick
+    size_t map_bytes = 0;
+    // of it, or of what the collision built from it, the tile masks the
+    // lookup reads; -1 if the kernel does not say
+    int64_t tile_bytes = -1;
+};
+
+// What a kernel's collision removes, so which reference it is checked
+// against: update_asteroids_fixed's point test, the disc of the asteroid's
+// prototype (SIZED) or the tiles on its way (SWEPT).
+enum class Collide : uint8_t { Point, Sized, Swept };
+constexpr uint32_t COLLIDE_COUNT = 3;
+
+template <typename Collision>
+constexpr Collide collide_of() {
+    return Collision::SIZED   ? Collide::Sized
+           : Collision::SWEPT ? Collide::Swept
+                              : Collide::Point;
+}
+
+static inline size_t live_count(const vector<AsteroidDouble>& a) {
+    return a.size();
+}
+static inline size_t live_count(const vector<AsteroidFixed>& a) {
+    return a.size();
+}
+static inline size_t live_count(const AsteroidStrideArray& a) {
+    size_t n = 0;
+    for (size_t i = 0; i < a.size(); i++) n += !a.dead_slots.test(i);
+    return n;
+}
+
+// FNV-1a over the live asteroids in order. Spawn and recycle draw from
+// Philox by slot, so every backend of a layout ends up with the same ones.
+static inline uint64_t survivors_hash(const AsteroidStrideArray& a) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    auto mix = [&](uint32_t v) {
+        for (int b = 0; b < 4; b++, v >>= 8)
+            hash = (hash ^ (v & 0xff)) * 0x100000001b3ull;
+    };
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a.dead_slots.test(i)) continue;
+        mix(a.state[i]);
+        mix(uint32_t(a.position_x[i].raw_value()));
+        mix(uint32_t(a.position_y[i].raw_value()));
+        mix(uint32_t(uint16_t(a.velocity_x[i].raw_value())));
+        mix(uint32_t(uint16_t(a.velocity_y[i].raw_value())));
+    }
+    return hash;
+}
+
+static inline int32_t check(const Reference&, const vector<AsteroidDouble>&) {
+    return -1;  // different rounding, not comparable
+}
+static inline int32_t check(const Reference& ref,
+                            const vector<AsteroidFixed>& a) {
+    return validate(ref, a);
+}
+static inline int32_t check(const Reference& ref,
+                            const AsteroidStrideArray& a) {
+    return validate(ref, a);
+}
+
+template <uint32_t W>
+static inline size_t live_count(const AsteroidBlockArray<W>& a) {
+    size_t n = 0;
+    for (size_t i = 0; i < a.size(); i++) n += !a.dead_slots.test(i);
+    return n;
+}
+template <uint32_t W>
+static inline int32_t check(const Reference& ref,
+                            const AsteroidBlockArray<W>& a) {
+    vector<AsteroidFixed> live;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a.dead_slots.test(i)) continue;
+        auto& block = a.block_of(i);
+        auto k = i % W;
+        AsteroidFixed asteroid{};
+        asteroid.state = block.state[k];
+        asteroid.position = {block.position_x[k], block.position_y[k]};
+        asteroid.velocity = {block.velocity_x[k], block.velocity_y[k]};
+        live.push_back(asteroid);
+    }
+    return validate(ref, live);
+}
+
+static inline size_t live_count(const AsteroidQuantizedArray& a) {
+    size_t n = 0;
+    for (auto& b : a.buckets)
+        for (size_t i = 0; i < b.size(); i++) n += !b.removed.test(i);
+    return n;
+}
+// buckets shuffle the order, put it back by population index
+static inline int32_t check(const Reference& ref,
+                            const AsteroidQuantizedArray& a) {
+    vector<std::pair<uint32_t, AsteroidFixed>> live;
+    for (auto& b : a.buckets)
+        for (uint32_t i = 0; i < b.size(); i++) {
+            if (b.removed.test(i)) continue;
+            AsteroidFixed asteroid{};
+            asteroid.state = b.state[i];
+            asteroid.position.x =
+                fixed_20_11::from_raw_value(b.base_x() + b.offset_x[i]);
+            asteroid.position.y =
+                fixed_20_11::from_raw_value(b.base_y() + b.offset_y[i]);
+            asteroid.velocity.x = b.velocity_x[i];
+            asteroid.velocity.y = b.velocity_y[i];
+            live.emplace_back(b.id[i], asteroid);
+        }
+    std::sort(live.begin(), live.end(),
+              [](auto& l, auto& r) { return l.first < r.first; });
+    vector<AsteroidFixed> sorted;
+    for (auto& [id, asteroid] : live) sorted.push_back(asteroid);
+    return validate(ref, sorted);
+}
+
+#ifndef __EMSCRIPTEN__
+static inline size_t live_count(const NumaStrideArray& a) {
+    size_t n = 0;
+    for (uint32_t k = 0; k < a.partitions(); k++) n += live_count(a.part(k));
+    return n;
+}
+// partitions keep their order, so each one matches the next slice of the
+// reference
+static inline int32_t check(const Reference& ref, const NumaStrideArray& a) {
+    size_t offset = 0;
+    for (uint32_t k = 0; k < a.partitions(); k++) {
+        size_t live = live_count(a.part(k));
+        if (offset + live > ref.asteroids.size()) {
+            fprintf(stderr, "Validation failed: size mismatch!\n");
+            return false;
+        }
+        // point collision only, nothing is maybe
+        Reference slice{{ref.asteroids.begin() + offset,
+                         ref.asteroids.begin() + offset + live},
+                        {}};
+        if (!validate(slice, a.part(k))) return false;
+        offset += live;
+    }
+    if (offset != ref.asteroids.size()) {
+        fprintf(stderr, "Validation failed: size mismatch!\n");
+        return false;
+    }
+    return true;
 }
 #endif
 
+// Kernels on another chunk size (MapT) tick against a copy of the map
+// rebuilt in their chunks, made before the timed ticks. TileBytes is the
+// collision's tile_bytes. The reference is the one of the kernel's Collide.
+template <typename Store, typename MapT,
+          void (*Tick)(Store&, const MapT*, double),
+          size_t (*TileBytes)(const MapT&) = nullptr>
+static RepResult run_kernel_on(const RunParams& p, const Map* base_map,
+                               const Reference* reference) {
+    constexpr bool can_spawn = std::is_same_v<Store, AsteroidStrideArray>;
+    if (!can_spawn && (p.spawn || p.recycle)) {
+        RepResult result;
+        result.no_spawn = true;
+        return result;
+    }
+
+    // edits go to a private copy so every kernel sees the same map
+    std::unique_ptr<MapT> edit_map;
+    const MapT* map;
+    if constexpr (std::is_same_v<MapT, Map>) {
+        if (p.edits) edit_map = std::make_unique<Map>(*base_map);
+        map = p.edits ? edit_map.get() : base_map;
+    } else {
+        edit_map = std::make_unique<MapT>(*base_map);
+        map = edit_map.get();
+    }
+    MapEdits edits(p.seed);
+    uint64_t spawned = 0;
+
+    Store asteroids;
+    asteroids.resize(p.n);
+    populate_asteroids(asteroids, p.seed, p.threads);
+    std::unique_ptr<CompactionPolicy> policy;
+    RecycleConfig recycle;
+    recycle.seed = p.seed;
+    if constexpr (can_spawn) {
+        if (p.recycle) asteroids.recycle = &recycle;
+        asteroids.compaction.mode = p.compaction;
+        if (p.policy) policy = make_compaction_policy(p.policy);
+        if (policy) policy->verbose = p.log_compaction;
+        asteroids.compaction.policy = policy.get();
+    }
+#ifndef __EMSCRIPTEN__
+    // policies keep state, so the partitions only get the mode
+    constexpr bool numa = std::is_same_v<Store, NumaStrideArray>;
+    if constexpr (numa)
+        for (uint32_t k = 0; k < asteroids.partitions(); k++)
+            asteroids.part(k).compaction.mode = p.compaction;
+#endif
+
+    auto tick = [&]() {
+        if (p.edits) edits.apply(edit_map.get(), p.edits);
+        if (p.recycle) recycle.box = spawn_box(map);
+        Tick(asteroids, map, p.velocity);
+        if constexpr (can_spawn)
+            if (p.spawn)
+                fill_asteroids(asteroids, map, p.n, p.seed, spawned);
+    };
+
+    for (uint32_t i = 0; i < p.warmup; i++) tick();
+
+    RepResult result;
+    size_t first_sweep = policy ? policy->decisions.size() : 0;
+    uint64_t first_recycled = recycle.recycled;
+#ifndef __EMSCRIPTEN__
+    if constexpr (numa) {
+        asteroids.reset_stats();
+        // the update runs on the workers, count their events too
+        if (p.listener)
+            p.listener->attach_threads(asteroids.workers.thread_ids());
+    }
+#endif
+    phase_listener = p.listener;
+    auto start = high_resolution_clock::now();
+    for (uint32_t i = 0; i < p.ticks; i++) {
+        result.asteroid_ticks += asteroids.size();
+        PROFILE_TICK_BEGIN();
+        tick();
+        PROFILE_TICK_END();
+    }
+    auto end = high_resolution_clock::now();
+    phase_listener = nullptr;
+#ifndef __EMSCRIPTEN__
+    if constexpr (numa)
+        if (p.listener) p.listener->detach_threads();
+#endif
+
+    result.ns = duration<double, nano>(end - start).count();
+    result.remaining = live_count(asteroids);
+    result.map_bytes = map->memory_usage_bytes();
+    if constexpr (TileBytes != nullptr)
+        result.tile_bytes = int64_t(TileBytes(*map));
+    if (can_spawn && p.recycle)
+        result.recycled = int64_t(recycle.recycled - first_recycled);
+    if constexpr (can_spawn) {
+        auto cov = huge_page_coverage(
+            asteroids.state.data(),
+            asteroids.capacity * AsteroidStrideArray::BYTES_PER_ASTEROID);
+        if (cov.bytes) result.huge_pages = cov.fraction();
+    }
+#ifndef __EMSCRIPTEN__
+    if constexpr (numa) {
+        // partitions without asteroids have nothing to say
+        const auto& nodes = asteroids.workers.nodes;
+        vector<std::pair<int, NumaStrideArray::NodeStats>> by_node;
+        for (uint32_t k = 0; k < asteroids.partitions(); k++) {
+            const auto& s = asteroids.stats[k];
+            if (!s.asteroid_ticks) continue;
+            auto it = std::find_if(
+                by_node.begin(), by_node.end(),
+                [&](auto& n) { return n.first == nodes[k].id; });
+            if (it == by_node.end())
+                it = by_node.insert(by_node.end(), {nodes[k].id, {}});
+            it->second.ns += s.ns;
+            it->second.asteroid_ticks += s.asteroid_ticks;
+        }
+        for (auto& [id, s] : by_node)
+            result.worker_ns.emplace_back("node" + to_string(id),
+                                          s.ns / double(s.asteroid_ticks));
+        if (asteroids.partitions() > by_node.size())
+            for (uint32_t k = 0; k < asteroids.partitions(); k++) {
+                const auto& s = asteroids.stats[k];
+                if (s.asteroid_ticks)
+                    result.worker_ns.emplace_back(
+                        "part" + to_string(k), s.ns / double(s.asteroid_ticks));
+            }
+    }
+#endif
+    if (policy) {
+        auto& d = policy->decisions;
+        result.sweeps = int64_t(d.size() - first_sweep);
+        for (size_t i = first_sweep; i < d.size(); i++)
+            result.sweep_dead_fraction +=
+                double(d[i].dead) / std::max(d[i].size, 1u);
+        if (result.sweeps) result.sweep_dead_fraction /= result.sweeps;
+    }
+    // the reference never respawns, those runs compare the survivors of
+    // the backends instead
+    if (reference && !(can_spawn && (p.spawn || p.recycle)))
+        result.valid = check(*reference, asteroids);
+    if constexpr (can_spawn)
+        if (reference && (p.spawn || p.recycle))
+            result.survivors = survivors_hash(asteroids);
+    return result;
+}
+
+template <typename Store, void (*Tick)(Store&, const Map*, double)>
+static RepResult run_kernel(const RunParams& p, const Map* map,
+                            const Reference* reference) {
+    return run_kernel_on<Store, Map, Tick>(p, map, reference);
+}
+
+static bool always(const MachineInfo&) { return true; }
+#ifndef __EMSCRIPTEN__
+// the "avx2" kernel also uses _mm256_mullo_epi64/_mm256_cvtepi64_epi32
+static bool has_avx2_vl(const MachineInfo& m) { return m.avx512 && m.avx2; }
+static bool has_avx512(const MachineInfo& m) { return m.avx512; }
+#endif
+
+struct Kernel {
+    const char* name;
+    const char* description;
+    // bytes streamed per asteroid by one update pass (reads + writes)
+    uint32_t bytes_per_asteroid;
+    bool (*supported)(const MachineInfo&);
+    RepResult (*run)(const RunParams&, const Map*, const Reference*);
+    Collide collide = Collide::Point;
+};
+
+// one tick_asteroids instantiation; tile_bytes, SIZED and SWEPT are the
+// same for every backend and only the scalar one is complete here. A sized
+// collision also reads the state column, a swept one may also remove an
+// asteroid whose segment only touches a set tile at a corner.
+#define TICK_KERNEL_DESCRIPTION(LAYOUT, COMPACTION, COLLISION, MAP) \
+    #LAYOUT ", " #COMPACTION ", " #COLLISION ", " #MAP
+#define TICK_KERNEL(NAME, SIMD, LAYOUT, COMPACTION, COLLISION, MAP,     \
+                    SUPPORTED)                                          \
+    {NAME,                                                              \
+     COLLISION<ScalarSimd, MAP>::SWEPT                                  \
+         ? TICK_KERNEL_DESCRIPTION(LAYOUT, COMPACTION, COLLISION, MAP)  \
+           ", conservative at tile corners"                             \
+         : TICK_KERNEL_DESCRIPTION(LAYOUT, COMPACTION, COLLISION, MAP), \
+     LAYOUT::BYTES + (COLLISION<ScalarSimd, MAP>::SIZED ? 4 : 0),       \
+     SUPPORTED,                                                         \
+     run_kernel_on<LAYOUT::Store, MAP,                                  \
+                   tick_asteroids<SIMD, LAYOUT, COMPACTION, COLLISION,  \
+                                  MAP>,                                 \
+                   COLLISION<ScalarSimd, MAP>::tile_bytes>,             \
+     collide_of<COLLISION<ScalarSimd, MAP>>()},
+#define TICK_KERNEL_SCALAR(...) TICK_KERNEL(__VA_ARGS__, always)
+#define TICK_KERNEL_AVX2(...) TICK_KERNEL(__VA_ARGS__, has_avx2_vl)
+#define TICK_KERNEL_AVX512(...) TICK_KERNEL(__VA_ARGS__, has_avx512)
+
+// The named kernels come first, the stride, AoSoA and SIMD AoS ones are
+// tick_asteroids instantiations under a short name. Every instantiation
+// follows under its full name.
+static const Kernel kernels[] = {
+    {"double", "AoS double precision", 64 + 64, always,
+     run_kernel<vector<AsteroidDouble>, update_asteroids_double>},
+    {"fixed", "AoS fixed point", 32 + 32, always,
+     run_kernel<vector<AsteroidFixed>, update_asteroids_fixed>},
+    {"stride", "SoA fixed point, scalar", 12 + 8, always,
+     run_kernel<AsteroidStrideArray, update_asteroids_fixed>},
+    {"quantized", "SoA int16 offsets per 32x32 cell, scalar", 8 + 4, always,
+     run_kernel<AsteroidQuantizedArray, update_asteroids_quantized>},
+    // state shares the cache lines, so whole blocks are streamed
+    {"aosoa8", "AoSoA 8 lane blocks, scalar", 16 + 16, always,
+     run_kernel<AsteroidBlockArray<8>,
+                tick_asteroids<ScalarSimd, AosoaLayout<8>, DeferredCompaction,
+                               ChunkCollision>>},
+    {"aosoa16", "AoSoA 16 lane blocks, scalar", 16 + 16, always,
+     run_kernel<AsteroidBlockArray<16>,
+                tick_asteroids<ScalarSimd, AosoaLayout<16>,
+                               DeferredCompaction, ChunkCollision>>},
+#ifndef __EMSCRIPTEN__
+    {"avx2", "SoA fixed point, AVX2", 12 + 8, has_avx2_vl,
+     run_kernel<AsteroidStrideArray, update_asteroids_avx2>},
+    {"fixed-avx2", "AoS fixed point, AVX2 transposed in registers", 32 + 32,
+     has_avx2_vl,
+     run_kernel<vector<AsteroidFixed>,
+                tick_asteroids<Avx2Simd, AosLayout, InPlaceCompaction,
+                               ChunkCollision>>},
+    {"fixed-avx512", "AoS fixed point, AVX-512 transposed in registers",
+     32 + 32, has_avx512,
+     run_kernel<vector<AsteroidFixed>,
+                tick_asteroids<Avx512Simd, AosLayout, InPlaceCompaction,
+                               ChunkCollision>>},
+    {"quantized-avx2", "SoA int16 offsets per 32x32 cell, AVX2", 8 + 4,
+     has_avx2_vl,
+     run_kernel<AsteroidQuantizedArray, update_asteroids_quantized_avx2>},
+    {"aosoa8-avx2", "AoSoA 8 lane blocks, AVX2", 16 + 16, has_avx2_vl,
+     run_kernel<AsteroidBlockArray<8>,
+                tick_asteroids<Avx2Simd, AosoaLayout<8>, DeferredCompaction,
+                               ChunkCollision>>},
+    {"aosoa16-avx2", "AoSoA 16 lane blocks, AVX2", 16 + 16, has_avx2_vl,
+     run_kernel<AsteroidBlockArray<16>,
+                tick_asteroids<Avx2Simd, AosoaLayout<16>, DeferredCompaction,
+                               ChunkCollision>>},
+    {"aosoa16-avx512", "AoSoA 16 lane blocks, AVX-512", 16 + 16, has_avx512,
+     run_kernel<AsteroidBlockArray<16>,
+                tick_asteroids<Avx512Simd, AosoaLayout<16>,
+                               DeferredCompaction, ChunkCollision>>},
+    {"stride-numa", "SoA scalar, one partition per NUMA node", 12 + 8,
+     always,
+     run_kernel<NumaStrideArray,
+                update_asteroids_numa<update_asteroids_fixed>>},
+    {"avx2-numa", "SoA AVX2, one partition per NUMA node", 12 + 8,
+     has_avx2_vl,
+     run_kernel<NumaStrideArray,
+                update_asteroids_numa<update_asteroids_avx2>>},
+#endif
+    TICK_KERNELS_SCALAR(TICK_KERNEL_SCALAR)
+#ifndef __EMSCRIPTEN__
+    TICK_KERNELS_AVX2(TICK_KERNEL_AVX2)
+    TICK_KERNELS_AVX512(TICK_KERNEL_AVX512)
+#endif
+};
+
+static const Kernel* find_kernel(const string& name) {
+    for (auto& k : kernels)
+        if (name == k.name) return &k;
+    return nullptr;
+}
+
+struct SuiteConfig {
+    vector<const Kernel*> kernels;
+    vector<uint32_t> counts = {1048576 * 16};
+    vector<int32_t> platforms = {1000};
+    vector<string> shapes = {"corners"};
+    vector<double> velocities = {-1.0 / 15.0};
+    uint32_t seed = 69420;  // unfunny
+    uint32_t warmup = 32;
+    uint32_t ticks = 64;
+    uint32_t reps = 3;
+    uint32_t threads = 0;
+    bool validate = true;
+    bool spawn = false;
+    bool recycle = false;
+    uint32_t edits = 0;
+    // radius in tiles of every prototype, for the -radius kernels
+    vector<uint32_t> radii = {0, 1, 2, 3};
+    CompactionMode compaction = CompactionMode::Batched;
+    const char* policy = nullptr;
+    bool log_compaction = false;
+    bool counters = false;
+    bool latency = false;
+    ReportFormat format = ReportFormat::Text;
+    const char* output = nullptr;
+};
+
+static void print_usage(const char* exe) {
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -k, --kernels LIST    kernels to run, comma separated, "
+            "\"all\", or a prefix\n"
+            "                        ending in * (avx2-soa-*)\n"
+            "  -n, --count LIST      asteroid counts, e.g. 65536,1M or a "
+            "sweep 1K..64M[:factor]\n"
+            "  -p, --platform LIST   platform half-size in tiles (default "
+            "1000)\n"
+            "      --shape LIST      corners (the bounds only), rect, "
+            "irregular or islands\n"
+            "                        (default corners)\n"
+            "  -v, --velocity LIST   platform velocity in tiles/tick "
+            "(default -1/15)\n"
+            "  -s, --seed N          population seed (default 69420)\n"
+            "  -w, --warmup N        untimed ticks per rep (default 32)\n"
+            "  -t, --ticks N         timed ticks per rep (default 64)\n"
+            "  -r, --reps N          repetitions (default 3)\n"
+            "  -j, --threads N       threads populating the asteroids "
+            "(default all)\n"
+            "  -f, --format FMT      text, json or csv (default text)\n"
+            "  -o, --output FILE     write the report to FILE\n"
+            "      --no-validate     skip the check against the AoS "
+            "reference\n"
+            "      --spawn           refill dead slots after every tick "
+            "(stride layouts)\n"
+            "      --recycle         respawn dead asteroids in place inside "
+            "the kernel,\n"
+            "                        no compaction (stride layouts)\n"
+            "      --edits R         brush an RxR block in and out of the "
+            "map every tick\n"
+            "      --radii LIST      radius in tiles of prototype 0, 1, ... "
+            "for the -radius\n"
+            "                        kernels, up to 4 distinct (default "
+            "0,1,2,3)\n"
+            "      --compaction M    batched (every 32 ticks), "
+            "incremental, or a batched\n"
+            "                        policy: interval[:N], "
+            "cost[:SCAN/SWEEP]\n"
+            "      --log-compaction  print every sweep a policy "
+            "triggers\n"
+            "      --hugetlb         back the stride arenas with hugetlb "
+            "pages (linux)\n"
+            "      --no-prefault     do not touch new arena pages up "
+            "front\n"
+            "      --numa N          partitions for the *-numa kernels "
+            "(default one per\n"
+            "                        node, extra ones share nodes round "
+            "robin)\n"
+            "      --counters        collect hardware counters per phase "
+            "(linux perf)\n"
+            "      --latency         per-tick and per-phase latency "
+            "percentiles\n"
+            "      --list            list kernels with their bytes per "
+            "asteroid and exit\n"
+            "      --self-test       check fpm/simd.hpp against the scalar "
+            "fixed point on\n"
+            "                        random lanes and exit\n",
+            exe);
+}
+
+// every fixed_batch and int_batch operation of each backend the CPU runs,
+// lane by lane against fpm::fixed; the tick kernels only add and convert
+static int self_test() {
+    const uint32_t seed = 69420, rounds = 1 << 16;
+    uint64_t failed = 0;
+    auto check = [&](const char* name, uint64_t lanes) {
+        fprintf(stderr, "fpm/simd.hpp %-8s %s\n", name,
+                lanes ? "differs from scalar" : "matches scalar");
+        failed += lanes;
+    };
+    check("scalar", simd_check_scalar(seed, rounds));
+#ifndef __EMSCRIPTEN__
+    auto info = query_machine_info();
+    if (has_avx2_vl(info))
+        check("avx2", simd_check_avx2(seed, rounds));
+    else
+        fprintf(stderr, "fpm/simd.hpp avx2     skipped, not supported\n");
+    if (has_avx512(info))
+        check("avx512", simd_check_avx512(seed, rounds));
+    else
+        fprintf(stderr, "fpm/simd.hpp avx512   skipped, not supported\n");
+#endif
+    return failed ? 1 : 0;
+}
+
+static vector<string> split(const string& s, char sep) {
+    vector<string> out;
+    size_t begin = 0;
+    while (begin <= s.size()) {
+        auto end = s.find(sep, begin);
+        if (end == string::npos) end = s.size();
+        if (end > begin) out.push_back(s.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    return out;
+}
+
+// 64K, 1M, 2G (binary multiples)
+static bool parse_count(const string& s, uint64_t& out) {
+    char* end = nullptr;
+    out = strtoull(s.c_str(), &end, 10);
+    if (end == s.c_str()) return false;
+    switch (*end) {
+        case 'k': case 'K': out <<= 10; end++; break;
+        case 'm': case 'M': out <<= 20; end++; break;
+        case 'g': case 'G': out <<= 30; end++; break;
+    }
+    return *end == 0;
+}
+
+static bool parse_counts(const string& arg, vector<uint32_t>& out) {
+    out.clear();
+    for (auto& item : split(arg, ',')) {
+        auto dots = item.find("..");
+        uint64_t lo, hi, factor = 2;
+        if (dots == string::npos) {
+            if (!parse_count(item, lo) || !lo || lo > UINT32_MAX)
+                return false;
+            out.push_back(uint32_t(lo));
+            continue;
+        }
+        auto rest = item.substr(dots + 2);
+        auto colon = rest.find(':');
+        if (colon != string::npos) {
+            if (!parse_count(rest.substr(colon + 1), factor) || factor < 2)
+                return false;
+            rest = rest.substr(0, colon);
+        }
+        if (!parse_count(item.substr(0, dots), lo) ||
+            !parse_count(rest, hi) || !lo || hi > UINT32_MAX)
+            return false;
+        for (uint64_t n = lo; n <= hi; n *= factor) out.push_back(uint32_t(n));
+    }
+    return !out.empty();
+}
+
+// returns -1 to run the suite, otherwise the exit code
+static int parse_args(int argc, char** argv, SuiteConfig& cfg) {
+    string kernel_list;
 #ifdef __EMSCRIPTEN__
-int run_bench() {
+    kernel_list = "fixed,stride";
 #else
-int main() {
+    kernel_list = "fixed,stride,avx2";
 #endif
 
-    // printf("Populating static_map...\n");
-    static_map = new Map();
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        auto value = [&]() -> const char* {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "missing value for %s\n", arg.c_str());
+                return nullptr;
+            }
+            return argv[++i];
+        };
+        auto is = [&](const char* s, const char* l) {
+            return arg == s || arg == l;
+        };
 
-    int32_t r = 1000;
+        const char* v = nullptr;
+        if (is("-h", "--help")) {
+            print_usage(argv[0]);
+            return 0;
+        } else if (arg == "--list") {
+            // bytes streamed per asteroid by one update pass, for GB/s
+            for (auto& k : kernels)
+                printf("%-30s %3u B  %s\n", k.name, k.bytes_per_asteroid,
+                       k.description);
+            return 0;
+        } else if (arg == "--self-test") {
+            return self_test();
+        } else if (arg == "--no-validate") {
+            cfg.validate = false;
+        } else if (arg == "--spawn") {
+            cfg.spawn = true;
+        } else if (arg == "--recycle") {
+            cfg.recycle = true;
+        } else if (arg == "--hugetlb") {
+            huge_page_config.hugetlb = true;
+        } else if (arg == "--no-prefault") {
+            huge_page_config.prefault = false;
+        } else if (arg == "--counters") {
+            cfg.counters = true;
+        } else if (arg == "--latency") {
+            cfg.latency = true;
+        } else if (arg == "--log-compaction") {
+            cfg.log_compaction = true;
+        } else if (!(v = value())) {
+            return 1;
+        } else if (is("-k", "--kernels")) {
+            kernel_list = v;
+        } else if (is("-n", "--count")) {
+            if (!parse_counts(v, cfg.counts)) {
+                fprintf(stderr, "bad count list: %s\n", v);
+                return 1;
+            }
+        } else if (is("-p", "--platform")) {
+            cfg.platforms.clear();
+            for (auto& s : split(v, ',')) cfg.platforms.push_back(stoi(s));
+        } else if (is("-v", "--velocity")) {
+            cfg.velocities.clear();
+            for (auto& s : split(v, ',')) {
+                auto slash = s.find('/');
+                cfg.velocities.push_back(
+                    slash == string::npos
+                        ? stod(s)
+                        : stod(s.substr(0, slash)) / stod(s.substr(slash + 1)));
+            }
+        } else if (arg == "--shape") {
+            cfg.shapes = split(v, ',');
+            for (auto& shape : cfg.shapes)
+                if (shape != "corners" && shape != "rect" &&
+                    shape != "irregular" && shape != "islands") {
+                    fprintf(stderr, "unknown shape: %s\n", shape.c_str());
+                    return 1;
+                }
+        } else if (arg == "--edits") {
+            cfg.edits = uint32_t(stoul(v));
+        } else if (arg == "--radii") {
+            cfg.radii.clear();
+            vector<uint32_t> distinct = {0};
+            for (auto& r : split(v, ',')) {
+                cfg.radii.push_back(uint32_t(stoul(r)));
+                if (std::find(distinct.begin(), distinct.end(),
+                              cfg.radii.back()) == distinct.end())
+                    distinct.push_back(cfg.radii.back());
+            }
+            if (cfg.radii.size() > Map::MAX_PROTOTYPES ||
+                distinct.size() > Map::RADIUS_LAYERS ||
+                *std::max_element(distinct.begin(), distinct.end()) >
+                    uint32_t(Map::MAX_RADIUS)) {
+                fprintf(stderr,
+                        "--radii: at most %u prototypes, %u distinct radii "
+                        "counting 0, each at most %d\n",
+                        Map::MAX_PROTOTYPES, Map::RADIUS_LAYERS,
+                        Map::MAX_RADIUS);
+                return 1;
+            }
+        } else if (arg == "--compaction") {
+            string m = v;
+            cfg.compaction = CompactionMode::Batched;
+            cfg.policy = nullptr;
+            if (m == "incremental")
+                cfg.compaction = CompactionMode::Incremental;
+            else if (m == "batched")
+                ;  // fixed interval
+            else if (make_compaction_policy(m))
+                cfg.policy = v;
+            else {
+                fprintf(stderr, "unknown compaction mode: %s\n", v);
+                return 1;
+            }
+        } else if (is("-s", "--seed")) {
+            cfg.seed = uint32_t(stoul(v));
+        } else if (is("-w", "--warmup")) {
+            cfg.warmup = uint32_t(stoul(v));
+        } else if (is("-t", "--ticks")) {
+            cfg.ticks = uint32_t(stoul(v));
+        } else if (is("-r", "--reps")) {
+            cfg.reps = std::max(1u, uint32_t(stoul(v)));
+        } else if (is("-j", "--threads")) {
+            cfg.threads = uint32_t(stoul(v));
+            huge_page_config.threads = cfg.threads;
+#ifndef __EMSCRIPTEN__
+        } else if (arg == "--numa") {
+            numa_partitions = uint32_t(stoul(v));
+#endif
+        } else if (is("-f", "--format")) {
+            string f = v;
+            if (f == "text")
+                cfg.format = ReportFormat::Text;
+            else if (f == "json")
+                cfg.format = ReportFormat::Json;
+            else if (f == "csv")
+                cfg.format = ReportFormat::Csv;
+            else {
+                fprintf(stderr, "unknown format: %s\n", v);
+                return 1;
+            }
+        } else if (is("-o", "--output")) {
+            cfg.output = v;
+        } else {
+            fprintf(stderr, "unknown option: %s\n", arg.c_str());
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
 
-    static_map->set(-r, r);
-    static_map->set(r, r);
-    static_map->set(-r, -r);
-    static_map->set(r, -r);
+    if (kernel_list == "all") {
+        for (auto& k : kernels) cfg.kernels.push_back(&k);
+    } else {
+        for (auto& name : split(kernel_list, ',')) {
+            // "avx2-soa-*" picks every kernel starting with avx2-soa-
+            if (!name.empty() && name.back() == '*') {
+                auto prefix = name.substr(0, name.size() - 1);
+                size_t before = cfg.kernels.size();
+                for (auto& k : kernels)
+                    if (string(k.name).starts_with(prefix))
+                        cfg.kernels.push_back(&k);
+                if (cfg.kernels.size() != before) continue;
+            } else if (auto k = find_kernel(name)) {
+                cfg.kernels.push_back(k);
+                continue;
+            }
+            fprintf(stderr, "unknown kernel: %s (see --list)\n", name.c_str());
+            return 1;
+        }
+    }
+    return -1;
+}
 
-    /*for (int32_t x = -1069; x <= 1069; x++) {
-        for (int32_t y = -1069; y <= 5; y++) {
-            static_map->set(x, y);
+// The asteroids start in a band above the hub and drift down, so the solid
+// shapes hang below y = 0 with their front towards them.
+//   corners    the hub and four tiles at +-r: bounds with nothing in them
+//   rect       a solid 2r x r hull
+//   irregular  a spine with wings of varying width and gaps between them,
+//              and pods off the sides so some rows have three runs
+//   islands    the hub and four r x r/4 platforms 8r to the sides and 4r
+//              above and below it: a large grid with little in it
+static Map* create_map(int32_t r, const string& shape) {
+    auto map = new Map();
+    if (shape == "rect") {
+        map->set_rect(-r, -r, r, 0);
+    } else if (shape == "irregular") {
+        map->set_rect(-r / 8, -r, r / 8, 0);
+        for (int32_t k = 0; k < 8; k++) {
+            int32_t top = -k * r / 8, bottom = top - r / 10;
+            int32_t w = r * (2 + k * 3 % 7) / 8;
+            map->set_rect(-w, bottom, w, top);
+            if (k & 1 && w + r / 16 < r) {
+                map->set_rect(-r, bottom, -w - r / 16, bottom + r / 20);
+                map->set_rect(w + r / 16, bottom, r, bottom + r / 20);
+            }
         }
-    }*/
+    } else if (shape == "islands") {
+        for (int32_t sx = -1; sx <= 1; sx += 2)
+            for (int32_t sy = -1; sy <= 1; sy += 2)
+                map->set_rect(sx * 8 * r - r / 2, sy * 4 * r - r / 8,
+                              sx * 8 * r + r / 2, sy * 4 * r + r / 8);
+    } else {
+        map->set(-r, r);
+        map->set(r, r);
+        map->set(-r, -r);
+        map->set(r, -r);
+    }
+    return map;
+}
 
-    // printf("Initialized static_map (%f MB memory)\n",
-    //        static_map->memory_usage_bytes() / 1024.f / 1024.f);
+// tile (x, y) of the map set, looked up without any of the kernels' tables
+static bool tile_set(const Map* map, int32_t x, int32_t y) {
+    const int32_t cx = Map::chunk_of(x), cy = Map::chunk_of(y);
+    if (cx < map->x_offset || cx >= map->x_offset + int32_t(map->grid_w) ||
+        cy < map->y_offset || cy >= map->y_offset + int32_t(map->grid_h))
+        return false;
+    return map->tile_data[map->tile_at(cx, cy)].get_bit(Map::tile_of(x),
+                                                        Map::tile_of(y));
+}
 
-    uint32_t seed = 69420;  // unfunny
-    uint32_t warmup_ticks = 32;
-    uint32_t benchmark_ticks = 64;
-
-    // double platform_vel = -1.0 / 15.0;
-    double platform_vel = -1.0 / 15.0;
-
-    uint32_t N = 1048576 * 16;
-    // uint32_t N = 245000;
-
-    vector<AsteroidDouble> a0;
-    if (false) {
-        a0.resize(N);
-        populate_asteroids(a0, seed);
-        for (uint32_t i = 0; i < warmup_ticks; i++)
-            update_asteroids_double(a0, static_map, platform_vel);
-        auto start = high_resolution_clock::now();
-        for (uint32_t i = 0; i < benchmark_ticks; i++)
-            update_asteroids_double(a0, static_map, platform_vel);
-        auto end = high_resolution_clock::now();
-        auto duration = duration_cast<milliseconds>(end - start).count();
-        printf(
-            "Time elapsed: %lld ms for %d ticks, %zu asteroids remain (double "
-            "precision + /Ox+SSE2).\n",
-            duration, benchmark_ticks, a0.size());
-    }
-
-    vector<AsteroidFixed> a1;
-
-    if (true) {
-        a1.resize(N);
-        populate_asteroids(a1, seed);
-        for (uint32_t i = 0; i < warmup_ticks; i++)
-            update_asteroids_fixed(a1, static_map, platform_vel);
-        auto start = high_resolution_clock::now();
-        for (uint32_t i = 0; i < benchmark_ticks; i++)
-            update_asteroids_fixed(a1, static_map, platform_vel);
-        auto end = high_resolution_clock::now();
-        auto duration = duration_cast<milliseconds>(end - start).count();
-        printf(
-            "Time elapsed: %lld ms for %d ticks, %zu asteroids remain (fixed "
-            "point "
-            " + /Ox+SSE2).\n",
-            duration, benchmark_ticks, a1.size());
-    }
-
-    AsteroidStrideArray a2;
-
-    if (true) {
-        a2.resize(N);
-        populate_asteroids(a2, seed);
-        for (uint32_t i = 0; i < warmup_ticks; i++)
-            update_asteroids_fixed(a2, static_map, platform_vel);
-        auto start = high_resolution_clock::now();
-        for (uint32_t i = 0; i < benchmark_ticks; i++)
-            update_asteroids_fixed(a2, static_map, platform_vel);
-        auto end = high_resolution_clock::now();
-        auto duration = duration_cast<milliseconds>(end - start).count();
-        printf(
-            "Time elapsed: %lld ms for %d ticks, %zu asteroids remain (fixed "
-            "point + stride layout"
-            " + /Ox+SSE2).\n",
-            duration, benchmark_ticks, a2.size());
-    }
-
-    validate(a1, a2);
+// How the segment from (x0, y0) to (x1, y1), raw, meets tile (tx, ty): 2 if
+// it passes through the tile, 1 if it only touches it in a point, e.g. a
+// corner, 0 otherwise. Exact: t along the segment is bounded by fractions
+// over |dx| and |dy|, compared by cross multiplying.
+static int segment_meets_tile(int32_t x0, int32_t y0, int32_t x1, int32_t y1,
+                              int32_t tx, int32_t ty) {
+    struct Bound {
+        int64_t n, d;
+        bool closed;
+    };
+    constexpr int64_t SIZE = 1 << FRACTION_BITS;
+    // the tile half open as the kernels floor positions, or closed
+    auto meets = [&](bool closed_tile, bool& point) {
+        Bound lo{0, 1, true}, hi{1, 1, true};
+        auto cmp = [](const Bound& a, const Bound& b) {
+            const int64_t l = a.n * b.d, r = b.n * a.d;
+            return (l > r) - (l < r);
+        };
+        auto raise = [&](Bound b) {
+            int c = cmp(b, lo);
+            if (c > 0) lo = b;
+            if (!c) lo.closed &= b.closed;
+        };
+        auto lower = [&](Bound b) {
+            int c = cmp(b, hi);
+            if (c < 0) hi = b;
+            if (!c) hi.closed &= b.closed;
+        };
+        auto axis = [&](int64_t a, int64_t delta, int64_t edge) {
+            // a + t * delta in [edge, edge + SIZE), or ] for a closed tile
+            if (!delta)
+                return a >= edge && (closed_tile ? a <= edge + SIZE
+                                                 : a < edge + SIZE);
+            if (delta > 0) {
+                raise({edge - a, delta, true});
+                lower({edge + SIZE - a, delta, closed_tile});
+            } else {
+                raise({a - edge - SIZE, -delta, closed_tile});
+                lower({a - edge, -delta, true});
+            }
+            return true;
+        };
+        if (!axis(x0, int64_t(x1) - x0, int64_t(tx) * SIZE) ||
+            !axis(y0, int64_t(y1) - y0, int64_t(ty) * SIZE))
+            return false;
+        int c = cmp(lo, hi);
+        point = !c;
+        return c < 0 || (!c && lo.closed && hi.closed);
+    };
+    bool point = false;
+    if (meets(false, point)) return 2;
+    return meets(true, point) && point ? 1 : 0;
+}
+
+// update_asteroids_fixed with the tile test left to hit(asteroid, x0, y0,
+// x1, y1, maybe), the segment from the old position to the new one, raw and
+// clamped to the bounds. hit sets maybe if the kernel may remove the
+// asteroid where the reference does not, flags kept only if ref has any.
+template <typename Hit>
+static void update_reference(Reference& ref, const Map* map,
+                             double platform_vel_double, Hit hit) {
+    auto& asteroids = ref.asteroids;
+    const bool flags = !ref.maybe.empty();
+    const int32_t platform_vel = fixed_20_11(platform_vel_double).raw_value();
+    const int32_t min_x = (map->platform_bound.left - BORDER) << FRACTION_BITS;
+    const int32_t max_x = (map->platform_bound.right + BORDER)
+                          << FRACTION_BITS;
+    const int32_t min_y = (map->platform_bound.bottom - BORDER)
+                          << FRACTION_BITS;
+    const int32_t max_y = (map->platform_bound.top + BORDER) << FRACTION_BITS;
+    const int32_t center_x = (min_x + max_x) / 2;
+    const int32_t center_y = (min_y + max_y) / 2;
+
+    uint32_t write_index = 0;
+    for (uint32_t i = 0; i < asteroids.size(); i++) {
+        AsteroidFixed asteroid = asteroids[i];
+        const int32_t px = asteroid.position.x.raw_value();
+        const int32_t py = asteroid.position.y.raw_value();
+        const int32_t vx = asteroid.velocity.x.raw_value();
+        const int32_t vy = asteroid.velocity.y.raw_value() + platform_vel;
+        const int32_t new_px = px + vx;
+        const int32_t new_py = py + vy;
+
+        const bool clamped = new_px < min_x || new_px > max_x ||
+                             new_py < min_y || new_py > max_y;
+        const int64_t dx = (center_x - new_px) >> FRACTION_BITS;
+        const int64_t dy = (center_y - new_py) >> FRACTION_BITS;
+        const bool bye = clamped && dx * vx + dy * vy <= 0;
+        bool maybe = flags && ref.maybe[i];
+        const bool remove =
+            hit(asteroid, clamp(px, min_x, max_x), clamp(py, min_y, max_y),
+                clamp(new_px, min_x, max_x), clamp(new_py, min_y, max_y),
+                maybe) ||
+            bye;
+
+        asteroid.position.x = fixed_20_11::from_raw_value(new_px);
+        asteroid.position.y = fixed_20_11::from_raw_value(new_py);
+        asteroids[write_index] = asteroid;
+        if (flags) ref.maybe[write_index] = maybe;
+        write_index += !remove;
+    }
+    asteroids.resize(write_index);
+    if (flags) ref.maybe.resize(write_index);
+}
+
+// Runs the population of the kernels through the same map edits, with the
+// collision of the kernels being checked. Sized asteroids try every tile of
+// their prototype's disc, so the radius kernels' dilated masks have to
+// agree with the map after every edit. Swept ones try every tile in the
+// box of their segment, the old one only if it is also the new one; a set
+// tile the segment merely touches at a corner makes the asteroid maybe, as
+// the swept kernels are conservative there.
+static Reference run_reference(const RunParams& p, const Map* base_map,
+                               Collide collide) {
+    std::unique_ptr<Map> edit_map;
+    if (p.edits) edit_map = std::make_unique<Map>(*base_map);
+    const Map* map = p.edits ? edit_map.get() : base_map;
+    MapEdits edits(p.seed);
+
+    auto sized = [&](const AsteroidFixed& asteroid, int32_t, int32_t,
+                     int32_t x1, int32_t y1, bool&) {
+        const int32_t r = int32_t(map->prototype_radius(asteroid.state >> 16));
+        const int32_t x = x1 >> FRACTION_BITS, y = y1 >> FRACTION_BITS;
+        for (int32_t dy = -r; dy <= r; dy++)
+            for (int32_t dx = -r; dx <= r; dx++)
+                if (dx * dx + dy * dy <= r * r && tile_set(map, x + dx, y + dy))
+                    return true;
+        return false;
+    };
+    auto swept = [&](const AsteroidFixed&, int32_t x0, int32_t y0,
+                     int32_t x1, int32_t y1, bool& maybe) {
+        const int32_t tx0 = x0 >> FRACTION_BITS, ty0 = y0 >> FRACTION_BITS;
+        const int32_t tx1 = x1 >> FRACTION_BITS, ty1 = y1 >> FRACTION_BITS;
+        bool hit = false;
+        for (int32_t ty = std::min(ty0, ty1); ty <= std::max(ty0, ty1); ty++)
+            for (int32_t tx = std::min(tx0, tx1); tx <= std::max(tx0, tx1);
+                 tx++) {
+                if (tx == tx0 && ty == ty0 && (tx != tx1 || ty != ty1))
+                    continue;
+                if (!tile_set(map, tx, ty)) continue;
+                const int meets = segment_meets_tile(x0, y0, x1, y1, tx, ty);
+                hit |= meets == 2;
+                maybe |= meets == 1;
+            }
+        return hit;
+    };
 
+    Reference ref;
+    ref.asteroids.resize(p.n);
+    populate_asteroids(ref.asteroids, p.seed, p.threads);
+    if (collide == Collide::Swept) ref.maybe.assign(p.n, false);
+    for (uint32_t i = 0; i < p.warmup + p.ticks; i++) {
+        if (p.edits) edits.apply(edit_map.get(), p.edits);
+        if (collide == Collide::Sized)
+            update_reference(ref, map, p.velocity, sized);
+        else if (collide == Collide::Swept)
+            update_reference(ref, map, p.velocity, swept);
+        else
+            update_asteroids_fixed(ref.asteroids, map, p.velocity);
+    }
+    return ref;
+}
+
+// per-asteroid counts for every phase the kernel went through
+static void add_counter_metrics(BenchRecord& record, const PerfCounters& perf,
+                                uint64_t asteroid_ticks) {
+    double at = double(std::max<uint64_t>(asteroid_ticks, 1));
+    for (uint32_t ph = 0; ph < PHASE_COUNT; ph++) {
+        if (!perf.calls[ph]) continue;
+        string prefix = string(phase_name(Phase(ph))) + ".";
+        for (uint32_t e = 0; e < PerfCounters::EVENT_COUNT; e++) {
+            if (!perf.available(e)) continue;
+            record.metrics.emplace_back(
+                prefix + PerfCounters::event_name(e) + "_per_asteroid",
+                perf.counts[ph][e] / at);
+        }
+        if (perf.available(PerfCounters::Cycles) &&
+            perf.available(PerfCounters::Instructions) &&
+            perf.counts[ph][PerfCounters::Cycles] > 0)
+            record.metrics.emplace_back(
+                prefix + "ipc", perf.counts[ph][PerfCounters::Instructions] /
+                                    perf.counts[ph][PerfCounters::Cycles]);
+    }
+}
+
+static void add_latency_metrics(BenchRecord& record,
+                                const TickProfiler& profiler) {
+    auto add = [&](const string& prefix, const LatencyHistogram& h) {
+        record.metrics.emplace_back(prefix + ".p50_us",
+                                    h.percentile(50) * 1e-3);
+        record.metrics.emplace_back(prefix + ".p99_us",
+                                    h.percentile(99) * 1e-3);
+        record.metrics.emplace_back(prefix + ".p99.9_us",
+                                    h.percentile(99.9) * 1e-3);
+        record.metrics.emplace_back(prefix + ".max_us", h.max() * 1e-3);
+    };
+    add("tick", profiler.ticks);
+    for (uint32_t ph = 0; ph < PHASE_COUNT; ph++)
+        if (profiler.phases[ph].count())
+            add(phase_name(Phase(ph)), profiler.phases[ph]);
+    record.worst_ticks = profiler.worst;
+}
+
+static int run_suite(const SuiteConfig& cfg) {
+    auto info = query_machine_info();
+    vector<BenchRecord> records;
 #ifndef __EMSCRIPTEN__
-    AsteroidStrideArray a3;
-
-    if (true) {
-        a3.resize(N);
-        populate_asteroids(a3, seed);
-        for (uint32_t i = 0; i < warmup_ticks; i++)
-            update_asteroids_avx2(a3, static_map, platform_vel);
-        auto start = high_resolution_clock::now();
-        for (uint32_t i = 0; i < benchmark_ticks; i++)
-            update_asteroids_avx2(a3, static_map, platform_vel);
-        auto end = high_resolution_clock::now();
-        auto duration = duration_cast<milliseconds>(end - start).count();
-        printf(
-            "Time elapsed: %lld ms for %d ticks, %zu asteroids remain (stride "
-            "layout + stride layout + /Ox+AVX2).\n",
-            duration, benchmark_ticks, a3.size());
-    }
-
-    validate(a1, a3);
-
-    /*AsteroidStrideArray a4;
-    if (true) {
-        a4.resize(N);
-        populate_asteroids(a4, seed);
-        for (uint32_t i = 0; i < warmup_ticks; i++)
-            update_asteroids_avx512(a4, static_map, platform_vel);
-        auto start = high_resolution_clock::now();
-        for (uint32_t i = 0; i < benchmark_ticks; i++)
-            update_asteroids_avx512(a4, static_map, platform_vel);
-        auto end = high_resolution_clock::now();
-        auto duration = duration_cast<milliseconds>(end - start).count();
-        printf(
-            "Time elapsed: %lld ms for %d ticks, %zu asteroids remain (stride "
-            "layout + stride layout + /Ox+AVX512).\n",
-            duration, benchmark_ticks, a4.size());
-    }
-
-    validate(a1, a4);*/
+    if (info.avx2) generate_asteroids = generate_asteroids_avx2;
 #endif
 
+    std::unique_ptr<PerfCounters> perf;
+    if (cfg.counters) {
+        perf = std::make_unique<PerfCounters>();
+        if (!perf->any_available()) {
+            fprintf(stderr, "perf: no counters available, disabled\n");
+            perf.reset();
+        }
+    }
+
+    std::unique_ptr<TickProfiler> profiler;
+    if (cfg.latency) profiler = std::make_unique<TickProfiler>();
+
+    PhaseListenerChain chain;
+    if (perf) chain.listeners.push_back(perf.get());
+    if (profiler) chain.listeners.push_back(profiler.get());
+    PhaseListener* listener = nullptr;
+    if (chain.listeners.size() == 1) listener = chain.listeners[0];
+    if (chain.listeners.size() > 1) listener = &chain;
+
+    // every shape at every size
+    for (size_t m = 0; m < cfg.shapes.size() * cfg.platforms.size(); m++) {
+        const string& shape = cfg.shapes[m / cfg.platforms.size()];
+        const int32_t platform = cfg.platforms[m % cfg.platforms.size()];
+        delete static_map;
+        static_map = create_map(platform, shape);
+        static_map->set_prototype_radii(cfg.radii);
+        fprintf(stderr, "Initialized map (%f MB memory)\n",
+                static_map->memory_usage_bytes() / 1024.f / 1024.f);
+
+        for (auto velocity : cfg.velocities) {
+            for (auto n : cfg.counts) {
+                RunParams params{n,           cfg.seed,
+                                 cfg.warmup,  cfg.ticks,
+                                 cfg.threads, velocity,
+                                 cfg.spawn,   cfg.recycle,
+                                 cfg.edits,   cfg.compaction,
+                                 cfg.policy,  cfg.log_compaction,
+                                 listener};
+
+                // one per Collide, made for the first kernel that needs it
+                Reference references[COLLIDE_COUNT];
+                bool referenced[COLLIDE_COUNT] = {};
+                // spawn/recycle runs: the first survivors of every
+                // instantiation's description, the other backends must match
+                const bool spawns = cfg.spawn || cfg.recycle;
+                vector<std::pair<string, uint64_t>> survivors;
+
+                for (auto kernel : cfg.kernels) {
+                    if (!kernel->supported(info)) {
+                        fprintf(stderr, "Skipping %s: unsupported on this "
+                                "machine\n", kernel->name);
+                        continue;
+                    }
+
+                    BenchRecord record;
+                    record.kernel = kernel->name;
+                    record.asteroids = n;
+                    record.platform = platform;
+                    record.shape = shape;
+                    record.velocity = velocity;
+                    record.ticks = cfg.ticks;
+                    record.reps = cfg.reps;
+                    record.bytes_per_asteroid = kernel->bytes_per_asteroid;
+
+                    vector<double> ns, gbps, ms;
+                    vector<double> sweeps, dead_fraction, recycled;
+                    vector<double> huge_pages;
+                    vector<std::pair<string, vector<double>>> worker_gbps;
+                    size_t map_bytes = 0;
+                    int64_t tile_bytes = -1;
+                    uint64_t asteroid_ticks = 0;
+                    if (perf) perf->reset();
+                    if (profiler) profiler->reset();
+                    const uint32_t c = uint32_t(kernel->collide);
+                    if (cfg.validate && !spawns && !referenced[c]) {
+                        references[c] =
+                            run_reference(params, static_map, kernel->collide);
+                        referenced[c] = true;
+                    }
+                    bool no_spawn = false;
+                    for (uint32_t rep = 0; rep < cfg.reps; rep++) {
+                        // only check the first rep, the rest are identical
+                        auto r = kernel->run(
+                            params, static_map,
+                            cfg.validate && !rep ? &references[c] : nullptr);
+                        if (r.no_spawn) {
+                            no_spawn = true;
+                            break;
+                        }
+                        if (!rep) record.valid = r.valid;
+                        if (!rep && r.survivors) {
+                            auto it = std::find_if(
+                                survivors.begin(), survivors.end(),
+                                [&](auto& s) {
+                                    return s.first == kernel->description;
+                                });
+                            if (it == survivors.end()) {
+                                survivors.emplace_back(kernel->description,
+                                                       r.survivors);
+                            } else {
+                                record.valid = r.survivors == it->second;
+                                fprintf(stderr, "Survivors %s the first %s\n",
+                                        record.valid ? "match" : "differ from",
+                                        kernel->description);
+                            }
+                        }
+                        record.remaining = r.remaining;
+                        map_bytes = r.map_bytes;
+                        tile_bytes = r.tile_bytes;
+                        asteroid_ticks += r.asteroid_ticks;
+
+                        double at = double(std::max<uint64_t>(
+                            r.asteroid_ticks, 1));
+                        ns.push_back(r.ns / at);
+                        gbps.push_back(at * kernel->bytes_per_asteroid /
+                                       std::max(r.ns, 1.0));
+                        ms.push_back(r.ns * 1e-6);
+                        if (r.recycled >= 0)
+                            recycled.push_back(double(r.recycled) /
+                                               std::max(cfg.ticks, 1u));
+                        if (r.huge_pages >= 0)
+                            huge_pages.push_back(r.huge_pages);
+                        for (auto& [name, worker_ns] : r.worker_ns) {
+                            auto it = std::find_if(
+                                worker_gbps.begin(), worker_gbps.end(),
+                                [&](auto& w) { return w.first == name; });
+                            if (it == worker_gbps.end())
+                                it = worker_gbps.insert(worker_gbps.end(),
+                                                        {name, {}});
+                            it->second.push_back(kernel->bytes_per_asteroid /
+                                                 std::max(worker_ns, 1e-9));
+                        }
+                        if (r.sweeps >= 0) {
+                            sweeps.push_back(double(r.sweeps));
+                            dead_fraction.push_back(r.sweep_dead_fraction);
+                        }
+                    }
+                    if (no_spawn) {
+                        fprintf(stderr, "Skipping %s: no spawn/recycle "
+                                "support\n", kernel->name);
+                        continue;
+                    }
+                    record.ns_per_asteroid_tick = Stats::of(ns);
+                    record.gb_per_sec = Stats::of(gbps);
+                    record.ms_total = Stats::of(ms);
+                    if (!recycled.empty())
+                        record.metrics.emplace_back(
+                            "recycled_per_tick", Stats::of(recycled).median);
+                    for (auto& [name, worker] : worker_gbps)
+                        record.metrics.emplace_back(
+                            name + ".gb_per_sec", Stats::of(worker).median);
+                    if (!huge_pages.empty())
+                        record.metrics.emplace_back(
+                            "huge_page_coverage",
+                            Stats::of(huge_pages).median);
+                    record.metrics.emplace_back("map_bytes",
+                                                double(map_bytes));
+                    if (tile_bytes >= 0)
+                        record.metrics.emplace_back("tile_bytes",
+                                                    double(tile_bytes));
+                    if (!sweeps.empty()) {
+                        record.metrics.emplace_back(
+                            "compaction.sweeps", Stats::of(sweeps).median);
+                        record.metrics.emplace_back(
+                            "compaction.dead_fraction",
+                            Stats::of(dead_fraction).median);
+                    }
+                    if (perf) add_counter_metrics(record, *perf, asteroid_ticks);
+                    if (profiler) add_latency_metrics(record, *profiler);
+
+                    fprintf(stderr,
+                            "%s: %.3f ns/asteroid/tick, %.2f GB/s (N=%u)\n",
+                            kernel->name, record.ns_per_asteroid_tick.median,
+                            record.gb_per_sec.median, n);
+                    records.push_back(std::move(record));
+                }
+            }
+        }
+    }
+
+    FILE* out = stdout;
+    if (cfg.output && !(out = fopen(cfg.output, "w"))) {
+        fprintf(stderr, "failed to open %s\n", cfg.output);
+        return 1;
+    }
+    print_report(out, cfg.format, info, records);
+    if (out != stdout) fclose(out);
+
+    for (auto& r : records)
+        if (r.valid == 0) return 1;
     return 0;
 }
 
-static AsteroidStrideArray static_asteroids;
-static mt19937 static_rng(69420u * 69420u);
+#ifdef __EMSCRIPTEN__
+extern "C" {
+int run_bench();
+}
 
-static struct {
-    double x_offset = 0.0;
-    double x_range = X_RANGE;
-    double y_offset = Y_OFFSET;
-    double y_range = Y_RANGE;
-    double v_range = V_RANGE;
-} rng_bounds;
+int run_bench() {
+    SuiteConfig cfg;
+    char exe[] = "run_bench";
+    char* argv[] = {exe};
+    if (int code = parse_args(1, argv, cfg); code >= 0) return code;
+    return run_suite(cfg);
+}
+#else
+int main(int argc, char** argv) {
+    SuiteConfig cfg;
+    if (int code = parse_args(argc, argv, cfg); code >= 0) return code;
+    return run_suite(cfg);
+}
+#endif
 
 #ifdef __EMSCRIPTEN__
 extern "C" {
 
-static int32_t pos_x[32 * 32];
-static int32_t pos_y[32 * 32];
-static uint32_t state[32 * 32];
+constexpr int32_t CHUNK = int32_t(Map::CHUNK_SIZE);
+static int32_t pos_x[CHUNK * CHUNK];
+static int32_t pos_y[CHUNK * CHUNK];
+static uint32_t state[CHUNK * CHUNK];
+static uint64_t static_spawned = 0;
 
 extern void notify_chunk_update(int32_t x, int32_t y, uint32_t size,
                                 int32_t* pos_x, int32_t* pos_y,
@@ -325,13 +1678,13 @@ void check_chunk_update(int32_t chunk_x, int32_t chunk_y) {
     }
 
     uint32_t index = 0;
-    for (int32_t i = 0; i < 32; i++) {
-        for (int32_t j = 0; j < 32; j++) {
+    for (int32_t i = 0; i < CHUNK; i++) {
+        for (int32_t j = 0; j < CHUNK; j++) {
             if (!tile->get_bit(i, j)) continue;
-            pos_x[index] =
-                (fixed_20_11(chunk_x * 32 + i) + fixed_20_11(0.5)).raw_value();
-            pos_y[index] =
-                (fixed_20_11(chunk_y * 32 + j) + fixed_20_11(0.5)).raw_value();
+            pos_x[index] = (fixed_20_11(chunk_x * CHUNK + i) + fixed_20_11(0.5))
+                               .raw_value();
+            pos_y[index] = (fixed_20_11(chunk_y * CHUNK + j) + fixed_20_11(0.5))
+                               .raw_value();
             // printf("Setting tile %d, %d, x: %d, y: %d\n", i, j, pos_x[index],
             //        pos_y[index]);
             state[index] = 4 << 16;  // simulated space platform tile
@@ -363,9 +1716,15 @@ void set_asteroid_size(uint32_t size) {
 }
 EMSCRIPTEN_KEEPALIVE
 void tick(double vel) {
+    if (static_asteroids.recycle) static_recycle.box = spawn_box(static_map);
     update_asteroids_fixed(static_asteroids, static_map, vel);
 }
 EMSCRIPTEN_KEEPALIVE
+void set_recycle(bool enabled) {
+    static_recycle.seed = static_spawn_seed;
+    static_asteroids.recycle = enabled ? &static_recycle : nullptr;
+}
+EMSCRIPTEN_KEEPALIVE
 size_t get_asteroid_size() { return static_asteroids.size(); }
 EMSCRIPTEN_KEEPALIVE
 void* get_asteroid_state() { return static_asteroids.state.data(); }
@@ -373,42 +1732,16 @@ EMSCRIPTEN_KEEPALIVE
 void* get_asteroid_pos_x() { return static_asteroids.position_x.data(); }
 EMSCRIPTEN_KEEPALIVE
 void* get_asteroid_pos_y() { return static_asteroids.position_y.data(); }
+// removal flags, bit i & 63 of 64 bit word i >> 6, state has no REMOVE_BIT
+EMSCRIPTEN_KEEPALIVE
+void* get_asteroid_removed() {
+    return static_asteroids.dead_slots.words.data();
+}
 
 EMSCRIPTEN_KEEPALIVE
 void brush(double x, double y, double radius, uint32_t method, bool value) {
     std::set<uint64_t> chunks;
-
-    if (method == 0) {
-        // square brush
-        for (int32_t j = round(y - radius); j <= round(y + radius); j++) {
-            for (int32_t i = round(x - radius); i <= round(x + radius); i++) {
-                bool updated =
-                    value ? static_map->set(i, j) : static_map->unset(i, j);
-
-                if (updated) {
-                    TilePosition p = {div32(i), div32(j)};
-                    chunks.insert(*reinterpret_cast<uint64_t*>(&p));
-                }
-            }
-        }
-    } else if (method == 1) {
-        // circle brush
-        for (int32_t j = round(y - radius); j <= round(y + radius); j++) {
-            for (int32_t i = round(x - radius); i <= round(x + radius); i++) {
-                double dx = i - x;
-                double dy = j - y;
-                if (dx * dx + dy * dy > radius * radius) continue;
-                bool updated =
-                    value ? static_map->set(i, j) : static_map->unset(i, j);
-
-                if (updated) {
-                    TilePosition p = {div32(i), div32(j)};
-                    chunks.insert(*reinterpret_cast<uint64_t*>(&p));
-                }
-            }
-        }
-    }
-    if (!value) static_map->shrink_bounds();
+    brush_map(static_map, x, y, radius, method, value, &chunks);
     for (auto p : chunks) {
         TilePosition chunk = *reinterpret_cast<TilePosition*>(&p);
         check_chunk_update(chunk.x, chunk.y);
@@ -417,36 +1750,8 @@ void brush(double x, double y, double radius, uint32_t method, bool value) {
 
 EMSCRIPTEN_KEEPALIVE
 void fill_asteroids(uint32_t upper_bound) {
-    auto& rng = static_rng;
-    AsteroidStrideArray& asteroids = static_asteroids;
-
-    if (upper_bound > asteroids.size()) asteroids.resize(upper_bound);
-
-    double l = std::max(double(static_map->platform_bound.left - BORDER),
-                        rng_bounds.x_offset - rng_bounds.x_range);
-    double r = std::min(double(static_map->platform_bound.right + BORDER),
-                        rng_bounds.x_offset + rng_bounds.x_range);
-    double b = std::max(double(static_map->platform_bound.bottom - BORDER),
-                        rng_bounds.y_offset - rng_bounds.y_range);
-    double t = std::min(double(static_map->platform_bound.top + BORDER),
-                        rng_bounds.y_offset + rng_bounds.y_range);
-
-    uniform_real_distribution<double> pos_dist_x(l, r);
-    uniform_real_distribution<double> pos_dist_y(b, t);
-    uniform_real_distribution<double> vel_dist(-rng_bounds.v_range,
-                                               rng_bounds.v_range);
-
-    for (uint32_t i = 0; i < upper_bound; i++) {
-        if (!(asteroids.state[i] & REMOVE_BIT)) continue;
-
-        asteroids.state[i] =
-            (proto_dist(rng) << 16) | (rng() & (0xFFFF ^ REMOVE_BIT));
-        asteroids.position_x[i] = fixed_20_11(pos_dist_x(rng));
-        asteroids.position_y[i] =
-            fixed_20_11(pos_dist_y(rng)) + fixed_20_11(Y_OFFSET);
-        asteroids.velocity_x[i] = fixed_4_11(vel_dist(rng));
-        asteroids.velocity_y[i] = fixed_4_11(vel_dist(rng));
-    }
+    fill_asteroids(static_asteroids, static_map, upper_bound,
+                   static_spawn_seed, static_spawned);
 }
 
 EMSCRIPTEN_KEEPALIVE
@@ -1,11 +1,43 @@
 #pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+
 #include "headers.hpp"
 
 constexpr int32_t PAD_DEFAULT = 5;
 constexpr int32_t BORDER = 48;
 
-class Map {
+// source of Map::serial, unique across all maps
+inline std::atomic<uint64_t> map_serials{0};
+
+// The tile grid in square chunks of CHUNK x CHUNK tiles (16, 32 or 64), each
+// chunk an index into tile_data. Smaller chunks pack a dense platform into
+// fewer bytes, larger ones need fewer indices for a sparse one. Map is the
+// 32 tile version everything uses unless it asks for another. SPARSE keeps
+// the chunk indices and distance cells in superchunk blocks instead of one
+// dense grid (SparseMap), see supers.
+template <uint32_t CHUNK, bool SPARSE>
+class BasicMap {
+    static_assert(CHUNK == 16 || CHUNK == 32 || CHUNK == 64,
+                  "a chunk row is a 16, 32 or 64 bit word");
+
    public:
+    static constexpr uint32_t CHUNK_SIZE = CHUNK;
+    static constexpr uint32_t CHUNK_SHIFT = std::countr_zero(CHUNK);
+    static constexpr uint32_t CHUNK_MASK = CHUNK - 1;
+    static constexpr bool SPARSE_GRID = SPARSE;
+
+    // chunk of tile coordinate v, rounding down
+    static constexpr int32_t chunk_of(int32_t v) { return v >> CHUNK_SHIFT; }
+    // v inside its chunk
+    static constexpr uint32_t tile_of(int32_t v) {
+        return uint32_t(v) & CHUNK_MASK;
+    }
+
     size_t current_tick = 0;
     uint32_t grid_w = 0;
     uint32_t grid_h = 0;
@@ -20,28 +52,144 @@ class Map {
         int32_t right;
     } platform_bound = {0, 0, 0, 0};
 
-    struct TileMask : std::bitset<32 * 32> {
+    // One word per row of the chunk, bit x of rows[y] is tile (x, y). The
+    // kernels read the rows as consecutive 32 bit words.
+    struct TileMask {
+        using Row = std::conditional_t<
+            CHUNK == 16, uint16_t,
+            std::conditional_t<CHUNK == 32, uint32_t, uint64_t>>;
+        Row rows[CHUNK];
+
         inline void set_bit(uint32_t x, uint32_t y, bool value) noexcept {
-            this->operator[](x + y * 32) = value;
+            const Row bit = Row(Row(1) << x);
+            rows[y] = value ? Row(rows[y] | bit) : Row(rows[y] & ~bit);
         }
         inline bool get_bit(uint32_t x, uint32_t y) const noexcept {
-            return this->operator[](x + y * 32);
+            return (rows[y] >> x) & 1;
+        }
+        void reset() noexcept { std::fill_n(rows, CHUNK, Row(0)); }
+        void set() noexcept { std::fill_n(rows, CHUNK, Row(~Row(0))); }
+        bool all() const noexcept {
+            return std::all_of(rows, rows + CHUNK,
+                               [](Row r) { return r == Row(~Row(0)); });
+        }
+        bool none() const noexcept {
+            return std::all_of(rows, rows + CHUNK, [](Row r) { return !r; });
         }
     };
+    static_assert(sizeof(TileMask) == CHUNK * CHUNK / 8);
 
     vector<uint32_t> free_indices;
-    AlignedVector<TileMask> tile_data;
+    // grows a slab at a time and never moves, so a TileMask* from get_tile
+    // stays valid across new tiles
+    SlabArray<TileMask> tile_data;
+
+    // Dense, tiles is the tile index of every chunk of the grid, row major,
+    // one dependent load before the mask.
+    // SPARSE, the grid is two level so its memory follows the platform, not
+    // its bounding box, for one more dependent load. supers covers the grid
+    // in superchunks of SUPER_TILES x SUPER_TILES tiles, row major from
+    // superchunk (super_x, super_y), each the number of a block. Block b is
+    // the tile indices of the superchunk's chunks, row major at
+    // tiles[b * BLOCK_CHUNKS], and its distance cells. A superchunk gets a
+    // block when it or one of its 8 neighbours gets a tile, the others share
+    // block 0, empty. Moving the grid lays supers out again, the blocks stay
+    // where they are.
+    static constexpr uint32_t SUPER_SHIFT = 8;
+    static constexpr uint32_t SUPER_TILES = 1u << SUPER_SHIFT;
+    static constexpr uint32_t SUPER_CHUNK_SHIFT = SUPER_SHIFT - CHUNK_SHIFT;
+    static constexpr uint32_t SUPER_CHUNKS = 1u << SUPER_CHUNK_SHIFT;
+    static constexpr uint32_t BLOCK_CHUNKS = SUPER_CHUNKS * SUPER_CHUNKS;
+    uint32_t super_w = 0;
+    uint32_t super_h = 0;
+    int32_t super_x = 0;
+    int32_t super_y = 0;
+    AlignedVector<uint32_t> supers;
     AlignedVector<uint32_t> tiles;
+    vector<uint32_t> free_blocks;
 
-    Map() {
-        tile_data.reserve(128);
-        free_indices.reserve(128);
-        // tile0 is specialized for empty mask
-        // tile1 is specialized for full mask
-        tile_data.resize(2);
-        tile_data[0].reset();
-        tile_data[1].set();
+    // Chebyshev distance in tiles from anywhere in a block of CELL x CELL
+    // tiles to the nearest set tile, a lower bound: 0 for a cell with tiles,
+    // (k - 1) * CELL + 1 for one k cells from the nearest, at most
+    // MAX_DISTANCE. Dense, row major over the grid, distance_w cells to a
+    // row. SPARSE, BLOCK_CELLS per block, row major, next to the block's
+    // tile indices. Block 0's cells are FAR_DISTANCE: a superchunk without
+    // a block has no tiles next to it, so it is a superchunk from any. set
+    // lowers it around a cell that gets its first tile, unset and set_bounds
+    // recompute it when a cell empties or the grid moves.
+    static constexpr uint32_t CELL = 8;
+    static constexpr uint32_t CELL_SHIFT = 3;
+    static constexpr uint32_t CELLS = CHUNK / CELL;
+    static constexpr uint32_t SUPER_CELL_SHIFT = SUPER_SHIFT - CELL_SHIFT;
+    static constexpr uint32_t SUPER_CELLS = 1u << SUPER_CELL_SHIFT;
+    static constexpr uint32_t BLOCK_CELLS = SUPER_CELLS * SUPER_CELLS;
+    static constexpr int32_t MAX_DISTANCE = 8192;
+    static constexpr int32_t FAR_DISTANCE = int32_t(SUPER_TILES) + 1;
+    uint32_t distance_w = 0;
+    AlignedVector<int32_t> distance;
+
+    // The set tiles of every tile row as up to two runs, x0 | x1 << 16 with
+    // x from the grid's left edge, so a mostly solid platform is looked up
+    // without going through tiles and tile_data. Two words per row, bottom
+    // row first. EMPTY_SPAN never matches, COMPLEX_SPAN in the second word
+    // says the row has more runs than that.
+    static constexpr int32_t EMPTY_SPAN = 1;
+    static constexpr int32_t COMPLEX_SPAN = 0x7FFF7FFF;
+    AlignedVector<int32_t> row_spans;
+
+    // Sized collision: an asteroid of prototype p (state >> 16) hits the set
+    // tiles whose centre is within its radius of its own tile's. Every
+    // distinct radius is a layer, the tiles dilated by it as masks of their
+    // own, layer 0 radius 0. The layer of prototype p is bits 2p..2p+1 of
+    // prototype_layers, prototypes from MAX_PROTOTYPES on take the last's.
+    // Prototypes 0-3 are radius 0-3 until set_prototype_radii says otherwise.
+    static constexpr uint32_t RADIUS_LAYERS = 4;
+    static constexpr uint32_t MAX_PROTOTYPES = 16;
+    static constexpr int32_t MAX_RADIUS = 8;
+    uint8_t layer_radius[RADIUS_LAYERS] = {0, 1, 2, 3};
+    uint32_t layer_count = 4;
+    uint32_t prototype_layers = 0b11100100;
+
+    // The layers are built by the first radius_tiles(), after that set and
+    // unset queue the chunks within MAX_RADIUS of the tiles they change
+    // and the next radius_tiles() redoes those, or everything when the grid
+    // moved. tiles is the tile index of chunk slot i's layer l at
+    // i * RADIUS_LAYERS + l, into data, whose 0 and 1 are empty and full
+    // like tile_data's. The kernels only see the map const, so it is all
+    // mutable behind the lock.
+    struct Dilation {
+        std::mutex lock;
+        bool built = false;
+        bool all = true;
+        vector<std::pair<int32_t, int32_t>> queue;
+        vector<uint8_t> queued;
+        AlignedVector<uint32_t> tiles;
+        SlabArray<TileMask> data;
+        vector<uint32_t> free_indices;
 
+        Dilation() = default;
+        // a copy gets a lock of its own
+        Dilation(const Dilation& other) { *this = other; }
+        Dilation& operator=(const Dilation& other) {
+            built = other.built;
+            all = other.all;
+            queue = other.queue;
+            queued = other.queued;
+            tiles = other.tiles;
+            data = other.data;
+            free_indices = other.free_indices;
+            return *this;
+        }
+    };
+    mutable Dilation dilation;
+
+    // New value after every change to the tiles or the grid, so anything
+    // derived from the map knows when to rebuild. A copy keeps it, it has
+    // the same tiles.
+    uint64_t serial = ++map_serials;
+
+    BasicMap() {
+        init_tiles();
         for (int32_t i = -PAD_DEFAULT; i < PAD_DEFAULT; i++) {
             for (int32_t j = -PAD_DEFAULT; j < PAD_DEFAULT; j++) {
                 set(i, j);
@@ -49,67 +197,88 @@ class Map {
         }
     }
 
+    // the same tiles and bounds in chunks of another size or grid, the
+    // distance field and row spans computed once at the end
+    template <uint32_t OTHER, bool OTHER_SPARSE>
+    explicit BasicMap(const BasicMap<OTHER, OTHER_SPARSE>& other) {
+        init_tiles();
+        const auto& b = other.platform_bound;
+        set_bounds(b.left, b.right, b.top, b.bottom);
+        for (int32_t cy = other.y_offset;
+             cy < other.y_offset + int32_t(other.grid_h); cy++) {
+            for (int32_t cx = other.x_offset;
+                 cx < other.x_offset + int32_t(other.grid_w); cx++) {
+                auto tile_index = other.tile_at(cx, cy);
+                if (tile_index == 0) continue;
+                auto& tile = other.tile_data[tile_index];
+                int32_t x0 = cx * int32_t(OTHER);
+                int32_t y0 = cy * int32_t(OTHER);
+                for (uint32_t y = 0; y < OTHER; y++)
+                    for (uint32_t x = 0; x < OTHER; x++)
+                        if (tile_index == 1 || tile.get_bit(x, y))
+                            put(x0 + int32_t(x), y0 + int32_t(y));
+            }
+        }
+        serial = ++map_serials;
+        update_distance();
+        update_spans();
+    }
+
     void set_bounds(int32_t left, int32_t right, int32_t top, int32_t bottom) {
-        int32_t new_left = div32(left - BORDER);
-        int32_t new_right = div32(right + BORDER);
-        int32_t new_top = div32(top + BORDER);
-        int32_t new_bottom = div32(bottom - BORDER);
+        int32_t new_left = chunk_of(left - BORDER);
+        int32_t new_right = chunk_of(right + BORDER);
+        int32_t new_top = chunk_of(top + BORDER);
+        int32_t new_bottom = chunk_of(bottom - BORDER);
 
         uint16_t new_w = uint16_t(new_right - new_left + 1);
         uint16_t new_h = uint16_t(new_top - new_bottom + 1);
 
         // Update tile_bound without BORDER
+        const AABB old_bound = platform_bound;
         platform_bound.top = top;
         platform_bound.bottom = bottom;
         platform_bound.left = left;
         platform_bound.right = right;
 
         if (new_left == x_offset && new_bottom == y_offset && new_w == grid_w &&
-            new_h == grid_h)
+            new_h == grid_h) {
+            // the kernels clamp to the bounds
+            if (std::memcmp(&old_bound, &platform_bound, sizeof(AABB)))
+                serial = ++map_serials;
             return;
+        }
 
         // printf("Old bounds: L:%d R:%d T:%d B:%d\n", platform_bound.left,
         //        platform_bound.right, platform_bound.top,
         //        platform_bound.bottom);
         // printf("New bounds: L:%d R:%d T:%d B:%d\n", new_left, new_right,
         //        new_top, new_bottom);
-        printf("Resizing map tiles: %dx%d -> %dx%d\n", grid_w, grid_h, new_w,
-               new_h);
-
-        // Only expand the tiles array if necessary
-        if (new_w * new_h > tiles.size()) tiles.resize(new_w * new_h);
+        fprintf(stderr, "Resizing map tiles: %dx%d -> %dx%d\n", grid_w, grid_h,
+                new_w, new_h);
 
-        // Temporary mapping to hold old tiles positions
-        vector<uint32_t> temp_tiles(new_w * new_h);
-
-        // Copy existing tiles that overlap into temp array
-        for (int y = 0; y < grid_h; y++) {
-            for (int x = 0; x < grid_w; x++) {
-                int old_x = x + x_offset;
-                int old_y = y + y_offset;
-
-                if (old_x >= new_left && old_x <= new_right &&
-                    old_y >= new_bottom && old_y <= new_top) {
-                    int nx = old_x - new_left;
-                    int ny = old_y - new_bottom;
-                    temp_tiles[nx + ny * new_w] = tiles[x + y * grid_w];
-                } else {
-                    // Free tiles that no longer fit
-                    free_tile(tiles[x + y * grid_w]);
-                }
-            }
-        }
-
-        // Copy temp back into tiles in-place
-        for (size_t i = 0; i < temp_tiles.size(); i++) tiles[i] = temp_tiles[i];
+        if constexpr (SPARSE)
+            move_supers(new_left, new_right, new_top, new_bottom);
+        else
+            move_grid(new_left, new_right, new_top, new_bottom, new_w, new_h);
 
         // Update offsets and size
         x_offset = new_left;
         y_offset = new_bottom;
         grid_w = new_w;
         grid_h = new_h;
+        serial = ++map_serials;
+        if constexpr (SPARSE)
+            // superchunks that came in next to ones with tiles
+            for (uint32_t y = 0; y < super_h; y++)
+                for (uint32_t x = 0; x < super_w; x++)
+                    if (block_has_tiles(supers[x + y * super_w]))
+                        occupy(x, y);
+        update_distance();
+        update_spans();
+        dilation.all = true;
 
-        printf("New bounds: L:%d R:%d T:%d B:%d\n", left, right, top, bottom);
+        fprintf(stderr, "New bounds: L:%d R:%d T:%d B:%d\n", left, right, top,
+                bottom);
     }
 
     // potentially expensive operation to shrink the map bounds
@@ -126,14 +295,14 @@ class Map {
                 // if (i > 1 && i < grid_w - 2 && j > 1 && j < grid_h - 2)
                 //     continue;
 
-                auto tile_index = tiles[i + j * grid_w];
+                auto tile_index = tile_at(i + x_offset, j + y_offset);
 
                 if (tile_index == 0) continue;  // empty tile
                 if (tile_index == 1) {          // full tile
-                    int32_t x0 = (i + x_offset) * 32;
-                    int32_t x1 = x0 + 32;
-                    int32_t y0 = (j + y_offset) * 32;
-                    int32_t y1 = y0 + 32;
+                    int32_t x0 = (i + x_offset) * int32_t(CHUNK);
+                    int32_t x1 = x0 + int32_t(CHUNK);
+                    int32_t y0 = (j + y_offset) * int32_t(CHUNK);
+                    int32_t y1 = y0 + int32_t(CHUNK);
                     new_left = std::min(new_left, x0);
                     new_right = std::max(new_right, x1);
                     new_bottom = std::min(new_bottom, y0);
@@ -142,11 +311,11 @@ class Map {
                 }
                 auto& tile = tile_data[tile_index];
                 // tile is partial
-                for (int32_t y = 0; y < 32; y++) {
-                    for (int32_t x = 0; x < 32; x++) {
+                for (int32_t y = 0; y < int32_t(CHUNK); y++) {
+                    for (int32_t x = 0; x < int32_t(CHUNK); x++) {
                         if (!tile.get_bit(x, y)) continue;
-                        int32_t x0 = (i + x_offset) * 32 + x;
-                        int32_t y0 = (j + y_offset) * 32 + y;
+                        int32_t x0 = (i + x_offset) * int32_t(CHUNK) + x;
+                        int32_t y0 = (j + y_offset) * int32_t(CHUNK) + y;
                         new_left = std::min(new_left, x0);
                         new_right = std::max(new_right, x0);
                         new_bottom = std::min(new_bottom, y0);
@@ -163,7 +332,6 @@ class Map {
         uint32_t ret;
         if (free_indices.empty()) {
             auto old = tile_data.size();
-            tile_data.reserve(old + 1);
             tile_data.resize(old + 1);
             ret = static_cast<uint32_t>(old);
         } else {
@@ -190,18 +358,17 @@ class Map {
                        std::min(platform_bound.bottom, y));
         }
 
-        auto cx = div32(x);
-        auto cy = div32(y);
-        auto index = (cx - x_offset) + (cy - y_offset) * grid_w;
-        assert(index >= 0 && index < tiles.size() - 1);
+        auto cx = chunk_of(x);
+        auto cy = chunk_of(y);
+        auto index = occupied_slot(cx, cy);
         if (!tiles[index]) {
             tiles[index] = new_tile(true);
             assert(tiles[index] > 1);  // not tile0 or tile1
         }
         if (tiles[index] == 1) return false;  // tile is full
 
-        auto tx = mod32(x);
-        auto ty = mod32(y);
+        auto tx = tile_of(x);
+        auto ty = tile_of(y);
         // printf(" - local tile coords (%u, %u)\n", tx, ty);
 
         // printf("Setting bit at (%d, %d) -> chunk (%d, %d) index %d ", x,
@@ -210,28 +377,79 @@ class Map {
         auto ti = tiles[index];
         if (tile_data[ti].get_bit(tx, ty)) return false;  // already set
         tile_data[ti].set_bit(tx, ty, true);
+        serial = ++map_serials;
+        const int32_t dx = (x >> CELL_SHIFT) - first_cell(x_offset, super_x);
+        const int32_t dy = (y >> CELL_SHIFT) - first_cell(y_offset, super_y);
+        if (distance[cell_slot(uint32_t(dx), uint32_t(dy))])
+            fill_distance(dx, dy);
         // collapse full tiles into tile1
         if (tile_data[ti].all()) {
             free_tile(ti);
             tiles[index] = 1;
         }
+        update_row(y);
+        queue_dilation(x, y, x, y);
         return true;
     }
 
+    // Sets every tile of the rectangle, edges included. For building
+    // platforms: the distance field and the row spans are rebuilt once at the
+    // end instead of kept up tile by tile like set does.
+    void set_rect(int32_t left, int32_t bottom, int32_t right, int32_t top) {
+        if (left > right || bottom > top) return;
+        set_bounds(std::min(platform_bound.left, left),
+                   std::max(platform_bound.right, right),
+                   std::max(platform_bound.top, top),
+                   std::min(platform_bound.bottom, bottom));
+        for (int32_t cy = chunk_of(bottom); cy <= chunk_of(top); cy++) {
+            for (int32_t cx = chunk_of(left); cx <= chunk_of(right); cx++) {
+                const int32_t x0 = std::max(left, cx * int32_t(CHUNK));
+                const int32_t x1 = std::min(right, cx * int32_t(CHUNK) +
+                                                       int32_t(CHUNK_MASK));
+                const int32_t y0 = std::max(bottom, cy * int32_t(CHUNK));
+                const int32_t y1 = std::min(top, cy * int32_t(CHUNK) +
+                                                     int32_t(CHUNK_MASK));
+                auto& ti = tiles[occupied_slot(cx, cy)];
+                if (ti == 1) continue;
+                if (x1 - x0 == int32_t(CHUNK_MASK) &&
+                    y1 - y0 == int32_t(CHUNK_MASK)) {
+                    free_tile(ti);
+                    ti = 1;
+                    continue;
+                }
+                if (!ti) ti = new_tile(true);
+                auto& tile = tile_data[ti];
+                const uint64_t bits = (~uint64_t(0) >> (63 - (x1 - x0)))
+                                      << tile_of(x0);
+                for (int32_t y = y0; y <= y1; y++)
+                    tile.rows[tile_of(y)] |= typename TileMask::Row(bits);
+                if (tile.all()) {
+                    free_tile(ti);
+                    ti = 1;
+                }
+            }
+        }
+        serial = ++map_serials;
+        update_distance();
+        for (int32_t y = bottom; y <= top; y++) update_row(y);
+        queue_dilation(left, bottom, right, top);
+    }
+
     inline bool unset(int32_t x, int32_t y) {
         // hub tiles are protected
         if (x >= -PAD_DEFAULT && x < PAD_DEFAULT && y >= -PAD_DEFAULT &&
             y < PAD_DEFAULT)
             return false;
 
-        auto cx = div32(x);
-        auto cy = div32(y);
+        auto cx = chunk_of(x);
+        auto cy = chunk_of(y);
         if (cx < x_offset || cx >= x_offset + int32_t(grid_w) ||
             cy < y_offset || cy >= y_offset + int32_t(grid_h))
             return false;
 
-        auto index = (cx - x_offset) + (cy - y_offset) * grid_w;
-        assert(index >= 0 && index < tiles.size() - 1);
+        // SPARSE, a superchunk without a block is empty, its slots are block
+        // 0's
+        auto index = chunk_slot(cx, cy);
 
         if (tiles[index] == 1) {
             // expand full tile into new tile
@@ -241,17 +459,21 @@ class Map {
         }
         if (!tiles[index]) return false;  // tile is empty
 
-        auto tx = mod32(x);
-        auto ty = mod32(y);
+        auto tx = tile_of(x);
+        auto ty = tile_of(y);
         auto ti = tiles[index];
         if (!tile_data[ti].get_bit(tx, ty)) return false;  // already unset
         tile_data[ti].set_bit(tx, ty, false);
+        serial = ++map_serials;
 
         // collapse empty tiles into tile0
         if (tile_data[ti].none()) {
             free_tile(tiles[index]);
             tiles[index] = 0;
         }
+        if (cell_empty(tiles[index], tx / CELL, ty / CELL)) update_distance();
+        update_row(y);
+        queue_dilation(x, y, x, y);
 
         // if (x == platform_bound.left || x == platform_bound.right ||
         //     y == platform_bound.top || y == platform_bound.bottom) {
@@ -264,15 +486,598 @@ class Map {
         if (chunk_x < x_offset || chunk_x >= x_offset + int32_t(grid_w) ||
             chunk_y < y_offset || chunk_y >= y_offset + int32_t(grid_h))
             return nullptr;
-        return &tile_data[tiles[(chunk_x - x_offset) +
-                                (chunk_y - y_offset) * grid_w]];
+        return &tile_data[tile_at(chunk_x, chunk_y)];
+    }
+
+    // tile index of chunk (cx, cy), which must be in the grid
+    uint32_t tile_at(int32_t cx, int32_t cy) const {
+        return tiles[chunk_slot(cx, cy)];
+    }
+
+    // radii[p] for prototype p, at most MAX_PROTOTYPES of them and
+    // RADIUS_LAYERS distinct ones counting 0, each at most MAX_RADIUS. The
+    // prototypes past the list are radius 0.
+    void set_prototype_radii(const vector<uint32_t>& radii) {
+        assert(radii.size() <= MAX_PROTOTYPES);
+        std::lock_guard<std::mutex> guard(dilation.lock);
+        layer_count = 1;
+        layer_radius[0] = 0;
+        prototype_layers = 0;
+        for (uint32_t p = 0; p < radii.size(); p++) {
+            const uint32_t r = std::min<uint32_t>(radii[p], MAX_RADIUS);
+            uint32_t l = 0;
+            while (l < layer_count && layer_radius[l] != r) l++;
+            if (l == layer_count) {
+                assert(layer_count < RADIUS_LAYERS);
+                layer_radius[layer_count++] = uint8_t(r);
+            }
+            prototype_layers |= l << (2 * p);
+        }
+        dilation.all = true;
+    }
+
+    // radius of prototype p, as set_prototype_radii left it
+    uint32_t prototype_radius(uint32_t p) const {
+        p = std::min<uint32_t>(p, MAX_PROTOTYPES - 1);
+        return layer_radius[(prototype_layers >> (2 * p)) &
+                            (RADIUS_LAYERS - 1)];
+    }
+
+    // Map::Dilation::tiles after bringing the layers up to date, the masks
+    // are dilation.data. Safe to call from several threads at once, not
+    // while the map is being edited.
+    const uint32_t* radius_tiles() const {
+        std::lock_guard<std::mutex> guard(dilation.lock);
+        auto& d = dilation;
+        if (d.all) {
+            d.data.resize(2);
+            d.data[0].reset();
+            d.data[1].set();
+            d.free_indices.clear();
+            d.tiles.assign(tiles.size() * RADIUS_LAYERS, 0);
+            d.queued.assign(tiles.size(), 0);
+            d.queue.clear();
+            for (uint32_t cy = 0; cy < grid_h; cy++)
+                for (uint32_t cx = 0; cx < grid_w; cx++)
+                    dilate(x_offset + int32_t(cx), y_offset + int32_t(cy));
+            d.built = true;
+            d.all = false;
+        } else {
+            // set may have added blocks
+            d.tiles.resize(tiles.size() * RADIUS_LAYERS, 0);
+            d.queued.resize(tiles.size(), 0);
+            for (auto [cx, cy] : d.queue) {
+                d.queued[chunk_slot(cx, cy)] = 0;
+                dilate(cx, cy);
+            }
+            d.queue.clear();
+        }
+        return d.tiles.data();
     }
 
     size_t memory_usage_bytes() const noexcept {
         size_t size = sizeof(Map);
-        size += tile_data.size() * sizeof(TileMask);
-        size += tiles.size() * sizeof(TileMask*);
+        size += tile_data.committed_bytes();
+        size += supers.size() * sizeof(uint32_t);
+        size += tiles.size() * sizeof(uint32_t);
         size += free_indices.size() * sizeof(uint32_t);
+        size += free_blocks.size() * sizeof(uint32_t);
+        size += distance.size() * sizeof(int32_t);
+        size += row_spans.size() * sizeof(int32_t);
         return size;
     }
+
+    // the radius layers, once built, apart from memory_usage_bytes so
+    // kernels sharing the map report the same size whichever ran first
+    size_t dilation_bytes() const noexcept {
+        return dilation.tiles.size() * sizeof(uint32_t) +
+               dilation.data.committed_bytes() + dilation.queued.size();
+    }
+
+   private:
+    // distance of a cell k cells from the nearest one with tiles
+    static int32_t ring_distance(uint32_t k) {
+        if (!k) return 0;
+        return int32_t(std::min<uint32_t>(k - 1, MAX_DISTANCE / CELL) * CELL +
+                       1);
+    }
+
+    // cell (x, y) of the chunk with tile index ti
+    bool cell_empty(uint32_t ti, uint32_t x, uint32_t y) const {
+        if (ti <= 1) return ti == 0;
+        const auto& tile = tile_data[ti];
+        for (uint32_t r = y * CELL; r < (y + 1) * CELL; r++)
+            if ((tile.rows[r] >> (x * CELL)) & 0xFF) return false;
+        return true;
+    }
+
+    // set_bounds: the grid's chunks to their place in the new one, freeing
+    // those that no longer fit
+    void move_grid(int32_t new_left, int32_t new_right, int32_t new_top,
+                   int32_t new_bottom, uint32_t new_w, uint32_t new_h) {
+        // Only expand the tiles array if necessary
+        if (new_w * new_h > tiles.size()) tiles.resize(new_w * new_h);
+
+        // Temporary mapping to hold old tiles positions
+        vector<uint32_t> temp_tiles(new_w * new_h);
+
+        // Copy existing tiles that overlap into temp array
+        for (int y = 0; y < grid_h; y++) {
+            for (int x = 0; x < grid_w; x++) {
+                int old_x = x + x_offset;
+                int old_y = y + y_offset;
+
+                if (old_x >= new_left && old_x <= new_right &&
+                    old_y >= new_bottom && old_y <= new_top) {
+                    int nx = old_x - new_left;
+                    int ny = old_y - new_bottom;
+                    temp_tiles[nx + ny * new_w] = tiles[x + y * grid_w];
+                } else {
+                    // Free tiles that no longer fit
+                    free_tile(tiles[x + y * grid_w]);
+                }
+            }
+        }
+
+        // Copy temp back into tiles in-place
+        for (size_t i = 0; i < temp_tiles.size(); i++) tiles[i] = temp_tiles[i];
+    }
+
+    // set_bounds, SPARSE: only the superchunks move, the blocks stay where
+    // they are
+    void move_supers(int32_t new_left, int32_t new_right, int32_t new_top,
+                     int32_t new_bottom) {
+        const int32_t new_sx = new_left >> SUPER_CHUNK_SHIFT;
+        const int32_t new_sy = new_bottom >> SUPER_CHUNK_SHIFT;
+        const uint32_t new_sw =
+            uint32_t((new_right >> SUPER_CHUNK_SHIFT) - new_sx + 1);
+        const uint32_t new_sh =
+            uint32_t((new_top >> SUPER_CHUNK_SHIFT) - new_sy + 1);
+        vector<uint32_t> new_supers(size_t(new_sw) * new_sh);
+        for (uint32_t y = 0; y < super_h; y++) {
+            for (uint32_t x = 0; x < super_w; x++) {
+                const uint32_t block = supers[x + y * super_w];
+                if (!block) continue;
+                const uint32_t nx = uint32_t(super_x + int32_t(x) - new_sx);
+                const uint32_t ny = uint32_t(super_y + int32_t(y) - new_sy);
+                if (nx < new_sw && ny < new_sh)
+                    new_supers[nx + ny * new_sw] = block;
+                else
+                    // Free blocks that no longer fit
+                    free_block(block);
+            }
+        }
+        supers.assign(new_supers.begin(), new_supers.end());
+        super_x = new_sx;
+        super_y = new_sy;
+        super_w = new_sw;
+        super_h = new_sh;
+    }
+
+    // set inside the bounds, without the distance field, the row spans and
+    // the radius layers
+    void put(int32_t x, int32_t y) {
+        auto& ti = tiles[occupied_slot(chunk_of(x), chunk_of(y))];
+        if (ti == 1) return;
+        if (!ti) ti = new_tile(true);
+        tile_data[ti].set_bit(tile_of(x), tile_of(y), true);
+        // collapse full tiles into tile1
+        if (tile_data[ti].all()) {
+            free_tile(ti);
+            ti = 1;
+        }
+    }
+
+    // supers index of the superchunk holding chunk (cx, cy)
+    uint32_t super_of(int32_t cx, int32_t cy) const {
+        return uint32_t((cx >> SUPER_CHUNK_SHIFT) - super_x) +
+               uint32_t((cy >> SUPER_CHUNK_SHIFT) - super_y) * super_w;
+    }
+
+    // slot of chunk (cx, cy) in tiles, the chunk must be in the grid
+    size_t chunk_slot(int32_t cx, int32_t cy) const {
+        if constexpr (!SPARSE)
+            return size_t(cx - x_offset) + size_t(cy - y_offset) * grid_w;
+        constexpr uint32_t MASK = SUPER_CHUNKS - 1;
+        return size_t(supers[super_of(cx, cy)]) * BLOCK_CHUNKS +
+               (uint32_t(cy) & MASK) * SUPER_CHUNKS + (uint32_t(cx) & MASK);
+    }
+
+    // chunk_slot for a chunk about to get tiles
+    size_t occupied_slot(int32_t cx, int32_t cy) {
+        if constexpr (SPARSE) {
+            const uint32_t s = super_of(cx, cy);
+            occupy(s % super_w, s / super_w);
+        }
+        return chunk_slot(cx, cy);
+    }
+
+    // cell coordinate of the grid's first cell along an axis whose first
+    // chunk is chunk and first superchunk super; SPARSE counts from the
+    // superchunk
+    static int32_t first_cell(int32_t chunk, int32_t super) {
+        return SPARSE ? super * int32_t(SUPER_CELLS) : chunk * int32_t(CELLS);
+    }
+
+    // slot in distance of cell (x, y), counted from first_cell
+    size_t cell_slot(uint32_t x, uint32_t y) const {
+        if constexpr (!SPARSE) return x + size_t(y) * distance_w;
+        constexpr uint32_t MASK = SUPER_CELLS - 1;
+        const uint32_t s =
+            (x >> SUPER_CELL_SHIFT) + (y >> SUPER_CELL_SHIFT) * super_w;
+        return size_t(supers[s]) * BLOCK_CELLS + (y & MASK) * SUPER_CELLS +
+               (x & MASK);
+    }
+
+    // Superchunk (x, y) has or gets tiles: it and its neighbours need
+    // blocks so their distances can be lower than FAR_DISTANCE.
+    void occupy(uint32_t x, uint32_t y) {
+        for (uint32_t ny = y ? y - 1 : 0; ny <= std::min(y + 1, super_h - 1);
+             ny++)
+            for (uint32_t nx = x ? x - 1 : 0;
+                 nx <= std::min(x + 1, super_w - 1); nx++)
+                if (!supers[nx + ny * super_w])
+                    supers[nx + ny * super_w] = new_block();
+    }
+
+    bool block_has_tiles(uint32_t block) const {
+        if (!block) return false;
+        const auto* first = &tiles[size_t(block) * BLOCK_CHUNKS];
+        return std::any_of(first, first + BLOCK_CHUNKS,
+                           [](uint32_t ti) { return ti != 0; });
+    }
+
+    // empty, and FAR_DISTANCE: nothing was next to its superchunk
+    uint32_t new_block() {
+        uint32_t block;
+        if (free_blocks.empty()) {
+            block = uint32_t(tiles.size() / BLOCK_CHUNKS);
+            tiles.resize(tiles.size() + BLOCK_CHUNKS);
+            distance.resize(distance.size() + BLOCK_CELLS);
+        } else {
+            block = free_blocks.back();
+            free_blocks.pop_back();
+        }
+        std::fill_n(&tiles[size_t(block) * BLOCK_CHUNKS], BLOCK_CHUNKS, 0u);
+        std::fill_n(&distance[size_t(block) * BLOCK_CELLS], BLOCK_CELLS,
+                    FAR_DISTANCE);
+        return block;
+    }
+
+    void free_block(uint32_t block) {
+        for (uint32_t i = 0; i < BLOCK_CHUNKS; i++)
+            free_tile(tiles[size_t(block) * BLOCK_CHUNKS + i]);
+        free_blocks.push_back(block);
+    }
+
+    // Whole grid, two passes over the 8 neighbours. Only needed when a cell
+    // empties or the grid moves, distances never grow otherwise.
+    void update_distance() {
+        if constexpr (SPARSE) {
+            update_block_distance();
+            return;
+        }
+        const uint32_t w = grid_w * CELLS, h = grid_h * CELLS;
+        vector<uint32_t> k(size_t(w) * h);
+        for (uint32_t y = 0; y < h; y++)
+            for (uint32_t x = 0; x < w; x++) {
+                auto ti = tiles[x / CELLS + y / CELLS * grid_w];
+                k[x + size_t(y) * w] =
+                    cell_empty(ti, x % CELLS, y % CELLS) ? w + h : 0;
+            }
+        auto relax = [&](uint32_t x, uint32_t y, int32_t dx, int32_t dy) {
+            uint32_t nx = x + dx, ny = y + dy;
+            if (nx >= w || ny >= h) return;
+            auto& d = k[x + size_t(y) * w];
+            d = std::min(d, k[nx + size_t(ny) * w] + 1);
+        };
+        for (uint32_t y = 0; y < h; y++)
+            for (uint32_t x = 0; x < w; x++) {
+                relax(x, y, -1, 0);
+                relax(x, y, -1, -1);
+                relax(x, y, 0, -1);
+                relax(x, y, 1, -1);
+            }
+        for (uint32_t y = h; y-- > 0;)
+            for (uint32_t x = w; x-- > 0;) {
+                relax(x, y, 1, 0);
+                relax(x, y, 1, 1);
+                relax(x, y, 0, 1);
+                relax(x, y, -1, 1);
+            }
+        distance_w = w;
+        distance.resize(k.size());
+        for (size_t i = 0; i < k.size(); i++)
+            distance[i] = ring_distance(k[i]);
+    }
+
+    // update_distance, SPARSE: through the grid's cells in the blocks; a
+    // superchunk without one is block 0, FAR_DISTANCE. The cells of a block
+    // outside the grid are not looked up and keep what they had.
+    void update_block_distance() {
+        constexpr uint32_t CHUNK_CELLS = CHUNK / CELL;
+        constexpr uint32_t FAR_CELLS = SUPER_CELLS + 1;
+        constexpr uint32_t NONE = MAX_DISTANCE / CELL + 1;
+        // the grid in cells from the first superchunk
+        const uint32_t x0 =
+            uint32_t(x_offset - (super_x << SUPER_CHUNK_SHIFT)) * CHUNK_CELLS;
+        const uint32_t y0 =
+            uint32_t(y_offset - (super_y << SUPER_CHUNK_SHIFT)) * CHUNK_CELLS;
+        const uint32_t x1 = x0 + grid_w * CHUNK_CELLS;
+        const uint32_t y1 = y0 + grid_h * CHUNK_CELLS;
+        // the cells of row y in blocks and the grid, left to right or back
+        auto row = [&](uint32_t y, bool back, auto&& f) {
+            const uint32_t* first = &supers[(y >> SUPER_CELL_SHIFT) * super_w];
+            for (uint32_t i = 0; i < super_w; i++) {
+                const uint32_t sx = back ? super_w - 1 - i : i;
+                if (!first[sx]) continue;
+                const uint32_t a = std::max(x0, sx << SUPER_CELL_SHIFT);
+                const uint32_t b = std::min(x1, (sx + 1) << SUPER_CELL_SHIFT);
+                // cell (x, y) is at slot0 + x % SUPER_CELLS
+                const size_t slot0 = cell_slot(a, y) - (a & (SUPER_CELLS - 1));
+                if (back)
+                    for (uint32_t x = b; x-- > a;)
+                        f(x, slot0 + (x & (SUPER_CELLS - 1)));
+                else
+                    for (uint32_t x = a; x < b; x++)
+                        f(x, slot0 + (x & (SUPER_CELLS - 1)));
+            }
+        };
+        // every cell read is block 0's or set below
+        thread_local vector<uint32_t> k;
+        k.resize(distance.size());
+        std::fill_n(k.begin(), BLOCK_CELLS, FAR_CELLS);
+        for (uint32_t y = y0; y < y1; y++)
+            row(y, false, [&](uint32_t x, size_t slot) {
+                const size_t chunk = slot / BLOCK_CELLS * BLOCK_CHUNKS +
+                                     (y % SUPER_CELLS / CHUNK_CELLS) *
+                                         SUPER_CHUNKS +
+                                     x % SUPER_CELLS / CHUNK_CELLS;
+                k[slot] = cell_empty(tiles[chunk], x % CHUNK_CELLS,
+                                     y % CHUNK_CELLS)
+                              ? NONE
+                              : 0;
+            });
+        // Cell (x, y) from its neighbours (x + dx[i], y + dy[i]). Inside a
+        // block and the grid they are next to it in k.
+        auto relax = [&](uint32_t x, uint32_t y, size_t slot,
+                         const int32_t(&dx)[4], const int32_t(&dy)[4]) {
+            constexpr uint32_t MASK = SUPER_CELLS - 1;
+            constexpr ptrdiff_t ROW = SUPER_CELLS;
+            uint32_t d = k[slot];
+            if ((x & MASK) - 1 < MASK - 1 && (y & MASK) - 1 < MASK - 1 &&
+                x > x0 && x + 1 < x1 && y > y0 && y + 1 < y1) {
+                for (int i = 0; i < 4; i++)
+                    d = std::min(d, k[slot + dx[i] + dy[i] * ROW] + 1);
+                k[slot] = d;
+                return;
+            }
+            for (int i = 0; i < 4; i++) {
+                const uint32_t nx = x + dx[i], ny = y + dy[i];
+                if (nx < x0 || nx >= x1 || ny < y0 || ny >= y1) continue;
+                d = std::min(d, k[cell_slot(nx, ny)] + 1);
+            }
+            k[slot] = d;
+        };
+        const int32_t fx[4] = {-1, -1, 0, 1}, fy[4] = {0, -1, -1, -1};
+        const int32_t bx[4] = {1, 1, 0, -1}, by[4] = {0, 1, 1, 1};
+        for (uint32_t y = y0; y < y1; y++)
+            row(y, false, [&](uint32_t x, size_t slot) {
+                relax(x, y, slot, fx, fy);
+            });
+        for (uint32_t y = y1; y-- > y0;)
+            row(y, true, [&](uint32_t x, size_t slot) {
+                relax(x, y, slot, bx, by);
+            });
+        for (uint32_t y = y0; y < y1; y++)
+            row(y, false, [&](uint32_t /*x*/, size_t slot) {
+                distance[slot] = ring_distance(k[slot]);
+            });
+    }
+
+    // Cell (x, y), counted from first_cell, just got its first tile: lower
+    // the rings around it until one has nothing left to lower, no ring
+    // further out can then. SPARSE, the rings that could lower block 0's
+    // FAR_DISTANCE do not leave the blocks occupy gave the neighbours.
+    void fill_distance(int32_t x, int32_t y) {
+        const int32_t w = int32_t(SPARSE ? super_w * SUPER_CELLS : distance_w);
+        const int32_t h = int32_t(SPARSE ? super_h * SUPER_CELLS
+                                         : distance.size() / distance_w);
+        distance[cell_slot(uint32_t(x), uint32_t(y))] = 0;
+        for (int32_t r = 1;; r++) {
+            const int32_t d = ring_distance(uint32_t(r));
+            bool lowered = false;
+            for (int32_t ry = std::max(y - r, 0); ry <= std::min(y + r, h - 1);
+                 ry++) {
+                // the full row at the top and bottom, the two ends otherwise
+                const bool edge = ry == y - r || ry == y + r;
+                const int32_t step = edge ? 1 : 2 * r;
+                for (int32_t rx = x - r; rx <= x + r; rx += step) {
+                    if (rx < 0 || rx >= w) continue;
+                    const size_t slot = cell_slot(uint32_t(rx), uint32_t(ry));
+                    if (SPARSE && slot < BLOCK_CELLS) continue;
+                    auto& cell = distance[slot];
+                    if (cell > d) {
+                        cell = d;
+                        lowered = true;
+                    }
+                }
+            }
+            if (!lowered) return;
+        }
+    }
+
+    // Chunks whose layers tiles (x0..x1, y0..y1) can reach, for the next
+    // radius_tiles(). Nothing to keep up before the first.
+    void queue_dilation(int32_t x0, int32_t y0, int32_t x1, int32_t y1) {
+        auto& d = dilation;
+        if (!d.built || d.all) return;
+        d.queued.resize(tiles.size(), 0);
+        for (int32_t cy = chunk_of(y0 - MAX_RADIUS);
+             cy <= chunk_of(y1 + MAX_RADIUS); cy++)
+            for (int32_t cx = chunk_of(x0 - MAX_RADIUS);
+                 cx <= chunk_of(x1 + MAX_RADIUS); cx++) {
+                // the bounds have BORDER > MAX_RADIUS tiles around them, and
+                // SPARSE, the neighbours of a superchunk with tiles have
+                // blocks
+                auto& q = d.queued[chunk_slot(cx, cy)];
+                if (q) continue;
+                q = 1;
+                d.queue.push_back({cx, cy});
+            }
+    }
+
+    // Every layer of chunk (cx, cy), in the grid. A tile is in radius r's
+    // mask if a set tile is dx, dy away with dx * dx + dy * dy <= r * r: row
+    // by row, the OR of the rows dy away spread dx to either side, with the
+    // bits the neighbouring chunks spread in.
+    void dilate(int32_t cx, int32_t cy) const {
+        auto& d = dilation;
+        if constexpr (SPARSE) {
+            if (!supers[super_of(cx, cy)]) return;
+        }
+        const size_t slot = chunk_slot(cx, cy) * RADIUS_LAYERS;
+        const uint64_t full = ~uint64_t(0) >> (64 - CHUNK);
+        auto source = [&](int32_t x, int32_t y) -> uint32_t {
+            if (x < x_offset || x >= x_offset + int32_t(grid_w) ||
+                y < y_offset || y >= y_offset + int32_t(grid_h))
+                return 0;
+            return tile_at(x, y);
+        };
+        bool empty = true;
+        for (int32_t y = cy - 1; y <= cy + 1; y++)
+            for (int32_t x = cx - 1; x <= cx + 1; x++)
+                empty &= !source(x, y);
+        const uint32_t centre = source(cx, cy);
+        // MAX_RADIUS rows above and below, and the chunks left and right
+        constexpr int32_t ROWS = int32_t(CHUNK) + 2 * MAX_RADIUS;
+        uint64_t rows[3][ROWS];
+        if (!empty && centre != 1)
+            for (int32_t j = 0; j < ROWS; j++) {
+                const int32_t y = cy * int32_t(CHUNK) - MAX_RADIUS + j;
+                for (int32_t k = 0; k < 3; k++) {
+                    const uint32_t ti = source(cx + k - 1, chunk_of(y));
+                    rows[k][j] = ti <= 1 ? (ti ? full : 0)
+                                         : tile_data[ti].rows[tile_of(y)];
+                }
+            }
+        for (uint32_t l = 0; l < RADIUS_LAYERS; l++) {
+            auto& ti = d.tiles[slot + l];
+            uint32_t result = empty ? 0 : 1;
+            TileMask mask;
+            if (l < layer_count && !empty && centre != 1) {
+                const int32_t r = layer_radius[l];
+                for (int32_t ty = 0; ty < int32_t(CHUNK); ty++) {
+                    uint64_t out = 0;
+                    for (int32_t dy = -r; dy <= r; dy++) {
+                        const int32_t j = ty + MAX_RADIUS + dy;
+                        const uint64_t left = rows[0][j], mid = rows[1][j],
+                                       right = rows[2][j];
+                        out |= mid;
+                        for (int32_t dx = 1; dx * dx + dy * dy <= r * r;
+                             dx++)
+                            out |= mid >> dx | right << (CHUNK - dx) |
+                                   mid << dx | left >> (CHUNK - dx);
+                    }
+                    mask.rows[ty] = typename TileMask::Row(out & full);
+                }
+                result = mask.none() ? 0 : mask.all() ? 1 : 2;
+            } else if (l >= layer_count) {
+                result = 0;
+            }
+            if (result == 2) {
+                if (ti <= 1) ti = new_dilated();
+                d.data[ti] = mask;
+            } else {
+                if (ti > 1) d.free_indices.push_back(ti);
+                ti = result;
+            }
+        }
+    }
+
+    uint32_t new_dilated() const {
+        auto& d = dilation;
+        if (d.free_indices.empty()) {
+            d.data.resize(d.data.size() + 1);
+            return uint32_t(d.data.size() - 1);
+        }
+        const uint32_t ti = d.free_indices.back();
+        d.free_indices.pop_back();
+        return ti;
+    }
+
+    // bits of tile row ty of chunk (cx, cy)
+    uint64_t row_bits(int32_t cx, int32_t cy, uint32_t ty) const {
+        auto ti = tile_at(cx, cy);
+        if (ti <= 1) return ti ? ~uint64_t(0) >> (64 - CHUNK) : 0;
+        return tile_data[ti].rows[ty];
+    }
+
+    // Runs of tile row y, walking the chunks of the row left to right and,
+    // SPARSE, skipping superchunks without a block. A grid too wide for 16
+    // bit x leaves every row to the chunk lookup.
+    void update_row(int32_t y) {
+        const uint32_t ry = uint32_t(y - y_offset * int32_t(CHUNK));
+        if (grid_w * CHUNK >= 0x7FFF) {
+            row_spans[2 * ry] = EMPTY_SPAN;
+            row_spans[2 * ry + 1] = COMPLEX_SPAN;
+            return;
+        }
+        const int32_t cy = chunk_of(y);
+        const uint32_t ty = tile_of(y);
+        const uint64_t full = ~uint64_t(0) >> (64 - CHUNK);
+        int32_t span[2] = {EMPTY_SPAN, EMPTY_SPAN};
+        uint32_t runs = 0;
+        int32_t open = -1;
+        auto close = [&](int32_t end) {
+            if (runs < 2) span[runs] = open | end << 16;
+            runs++;
+            open = -1;
+        };
+        for (uint32_t cx = 0; cx < grid_w; cx++) {
+            const int32_t base = int32_t(cx * CHUNK);
+            const int32_t chunk = x_offset + int32_t(cx);
+            if (SPARSE && !supers[super_of(chunk, cy)]) {
+                if (open >= 0) close(base - 1);
+                // to the last chunk of the superchunk
+                cx += SUPER_CHUNKS - 1 - (uint32_t(chunk) & (SUPER_CHUNKS - 1));
+                continue;
+            }
+            const uint64_t bits = row_bits(chunk, cy, ty);
+            uint32_t b = 0;
+            while (b < CHUNK) {
+                // the next set tile if no run is open, else the next clear one
+                const uint64_t rest = (open < 0 ? bits : ~bits & full) >> b;
+                if (!rest) break;
+                b += std::countr_zero(rest);
+                if (open < 0)
+                    open = base + int32_t(b);
+                else
+                    close(base + int32_t(b) - 1);
+            }
+        }
+        if (open >= 0) close(int32_t(grid_w * CHUNK) - 1);
+        row_spans[2 * ry] = span[0];
+        row_spans[2 * ry + 1] = runs > 2 ? COMPLEX_SPAN : span[1];
+    }
+
+    void update_spans() {
+        row_spans.resize(size_t(grid_h) * CHUNK * 2);
+        for (uint32_t ry = 0; ry < grid_h * CHUNK; ry++)
+            update_row(y_offset * int32_t(CHUNK) + int32_t(ry));
+    }
+
+    void init_tiles() {
+        free_indices.reserve(128);
+        // tile0 is specialized for empty mask
+        // tile1 is specialized for full mask
+        tile_data.resize(2);
+        tile_data[0].reset();
+        tile_data[1].set();
+        if constexpr (SPARSE) {
+            // block 0
+            tiles.assign(BLOCK_CHUNKS, 0);
+            distance.assign(BLOCK_CELLS, FAR_DISTANCE);
+        }
+    }
 };
\ No newline at end of file
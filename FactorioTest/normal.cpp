@@ -1,7 +1,13 @@
 #include <iostream>
 
 #include "fpm/ios.hpp"
+#include "blocks.hpp"
+#include "compaction.hpp"
 #include "map.hpp"
+#include "quantized.hpp"
+#include "simd_check.hpp"
+#include "spawn.hpp"
+#include "tick.hpp"
 
 using namespace std;
 
@@ -9,6 +15,7 @@ constexpr double TO_DOUBLE = 1.0 / (1 << FRACTION_BITS);
 
 void update_asteroids_double(vector<AsteroidDouble>& asteroids,
                              const Map* __restrict map, double platform_vel) {
+    PROFILE_PHASE(Phase::Update);
     const Map::TileMask EMPTY_MASK{};
     // Precompute map bounds in fixed-point
     const auto min_x = (map->platform_bound.left - BORDER);
@@ -17,14 +24,9 @@ void update_asteroids_double(vector<AsteroidDouble>& asteroids,
     const auto min_y = (map->platform_bound.bottom - BORDER);
     const auto max_y = (map->platform_bound.top + BORDER);
 
-    const auto OX = map->x_offset;
-    const auto OY = map->y_offset;
-    const auto GW = map->grid_w;
-
     const auto CENTER_X = (min_x + max_x) / 2;
     const auto CENTER_Y = (min_y + max_y) / 2;
 
-    auto tile_indices = map->tiles.data();
     auto tile_data = map->tile_data.data();
 
     uint32_t write_index = 0;
@@ -39,14 +41,13 @@ void update_asteroids_double(vector<AsteroidDouble>& asteroids,
 
         auto clamped_px = clamp(new_px, min_x, max_x);
         auto clamped_py = clamp(new_py, min_y, max_y);
-        auto cx = div32(clamped_px);
-        auto cy = div32(clamped_py);
-        auto tx = mod32(clamped_px);
-        auto ty = mod32(clamped_py);
-        auto tile_index = (cx - OX) + (cy - OY) * GW;
+        auto cx = Map::chunk_of(clamped_px);
+        auto cy = Map::chunk_of(clamped_py);
+        auto tx = Map::tile_of(clamped_px);
+        auto ty = Map::tile_of(clamped_py);
         // "unsafe" indexing - rely on set_bounds to function correctly to clamp
         // x and y
-        const Map::TileMask* tile = &tile_data[tile_indices[tile_index]];
+        const Map::TileMask* tile = &tile_data[map->tile_at(cx, cy)];
 
         auto dx = CENTER_X - new_px;
         auto dy = CENTER_Y - new_py;
@@ -75,6 +76,7 @@ void update_asteroids_double(vector<AsteroidDouble>& asteroids,
 void update_asteroids_fixed(vector<AsteroidFixed>& asteroids,
                             const Map* __restrict map,
                             double platform_vel_double) {
+    PROFILE_PHASE(Phase::Update);
     const auto platform_vel = fixed_20_11(platform_vel_double).raw_value();
 
     const Map::TileMask EMPTY_MASK{};
@@ -85,14 +87,9 @@ void update_asteroids_fixed(vector<AsteroidFixed>& asteroids,
     const auto min_y = (map->platform_bound.bottom - BORDER) << FRACTION_BITS;
     const auto max_y = (map->platform_bound.top + BORDER) << FRACTION_BITS;
 
-    const auto OX = map->x_offset;
-    const auto OY = map->y_offset;
-    const auto GW = map->grid_w;
-
     const auto CENTER_X = (min_x + max_x) / 2;
     const auto CENTER_Y = (min_y + max_y) / 2;
 
-    auto tile_indices = map->tiles.data();
     auto tile_data = map->tile_data.data();
 
     uint32_t write_index = 0;
@@ -112,14 +109,13 @@ void update_asteroids_fixed(vector<AsteroidFixed>& asteroids,
 
         auto clamped_px = clamp(new_px, min_x, max_x) >> FRACTION_BITS;
         auto clamped_py = clamp(new_py, min_y, max_y) >> FRACTION_BITS;
-        auto cx = div32(clamped_px);
-        auto cy = div32(clamped_py);
-        auto tx = mod32(clamped_px);
-        auto ty = mod32(clamped_py);
-        auto tile_index = (cx - OX) + (cy - OY) * GW;
+        auto cx = Map::chunk_of(clamped_px);
+        auto cy = Map::chunk_of(clamped_py);
+        auto tx = Map::tile_of(clamped_px);
+        auto ty = Map::tile_of(clamped_py);
         // "unsafe" indexing - rely on set_bounds to function correctly to clamp
         // x and y
-        const Map::TileMask* tile = &tile_data[tile_indices[tile_index]];
+        const Map::TileMask* tile = &tile_data[map->tile_at(cx, cy)];
 
         int64_t dx = (CENTER_X - new_px) >> FRACTION_BITS;
         int64_t dy = (CENTER_Y - new_py) >> FRACTION_BITS;
@@ -147,104 +143,70 @@ void update_asteroids_fixed(vector<AsteroidFixed>& asteroids,
     // removed << " this tick) %8 = " << (write_index % 8) << endl;
 }
 
-static uint32_t tick = 0;
-
-void update_asteroids_fixed(AsteroidStrideArray& asteroids,
-                            const Map* __restrict map,
-                            double platform_vel_double) {
-    const auto platform_vel = fixed_20_11(platform_vel_double).raw_value();
-
-    const Map::TileMask EMPTY_MASK{};
-    // Precompute map bounds in fixed-point
-    const auto min_x = (map->platform_bound.left - BORDER) << FRACTION_BITS;
-    const auto max_x = (map->platform_bound.right + BORDER) << FRACTION_BITS;
-
-    const auto min_y = (map->platform_bound.bottom - BORDER) << FRACTION_BITS;
-    const auto max_y = (map->platform_bound.top + BORDER) << FRACTION_BITS;
-
-    const auto OX = map->x_offset;
-    const auto OY = map->y_offset;
-    const auto GW = map->grid_w;
-
-    const int64_t CENTER_X = (min_x + max_x) / 2;
-    const int64_t CENTER_Y = (min_y + max_y) / 2;
-
-    auto tile_indices = map->tiles.data();
-    auto tile_data = map->tile_data.data();
-
-    uint32_t write_index = 0;
-    uint32_t end = asteroids.size();
-
-    for (uint32_t i = 0; i < end; i++) {
-        // if (asteroids.state[i] & REMOVE_BIT) continue;
+TICK_KERNELS_SCALAR(TICK_INSTANTIATE)
 
-        // raw values
-        auto vx = static_cast<int32_t>(asteroids.velocity_x[i].raw_value());
-        auto vy = static_cast<int32_t>(asteroids.velocity_y[i].raw_value());
-
-        auto new_px = asteroids.position_x[i].raw_value() + vx;
-        auto new_py = asteroids.position_y[i].raw_value() + vy + platform_vel;
-
-        bool clamped = bool((new_px < min_x) | (new_px > max_x) |
-                            (new_py < min_y) | (new_py > max_y));
-
-        auto clamped_px = clamp(new_px, min_x, max_x) >> FRACTION_BITS;
-        auto clamped_py = clamp(new_py, min_y, max_y) >> FRACTION_BITS;
-        auto cx = div32(clamped_px);
-        auto cy = div32(clamped_py);
-        auto tx = mod32(clamped_px);
-        auto ty = mod32(clamped_py);
-        auto tile_index = (cx - OX) + (cy - OY) * GW;
-        // "unsafe" indexing - rely on set_bounds to function correctly to clamp
-        // x and y
-        const Map::TileMask* tile = &tile_data[tile_indices[tile_index]];
-
-        int64_t dx = (CENTER_X - new_px) >> FRACTION_BITS;
-        int64_t dy = (CENTER_Y - new_py) >> FRACTION_BITS;
-        int64_t dot = int64_t(dx) * int64_t(vx) +
-                      int64_t(dy) * int64_t(vy + platform_vel);
-        auto bye = clamped & (dot <= 0);
-
-        tile = tile ? tile : &EMPTY_MASK;
-        bool colli = tile->get_bit(tx, ty);
-        bool remove = bool(colli | bye);
-
-        // TriggerEffect::apply(dyingTriggerEffect)
-
-        asteroids.state[i] |= uint16_t(remove) << REMOVE_BIT_INDEX;
-        ;
-        asteroids.position_x[i] = fixed_20_11::from_raw_value(new_px);
-        asteroids.position_y[i] = fixed_20_11::from_raw_value(new_py);
-
-        /*
-        asteroids.state[write_index] = asteroids.state[i];
-        asteroids.flags[write_index].data = asteroids.flags[i].data;
-        asteroids.position_x[write_index] = fixed_20_11::from_raw_value(new_px);
-        asteroids.position_y[write_index] = fixed_20_11::from_raw_value(new_py);
-        asteroids.velocity_x[write_index] = asteroids.velocity_x[i];
-        asteroids.velocity_y[write_index] = asteroids.velocity_y[i];
-
-        write_index += !remove;
-        */
-    }
-
-    // asteroids.resize(write_index);
+void update_asteroids_fixed(AsteroidStrideArray& asteroids, const Map* map,
+                            double platform_vel) {
+    tick_asteroids<ScalarSimd, SoaLayout, DeferredCompaction, ChunkCollision>(
+        asteroids, map, platform_vel);
+}
 
-    tick++;
+void update_asteroids_quantized(AsteroidQuantizedArray& asteroids,
+                                const Map* __restrict map,
+                                double platform_vel_double) {
+    const auto platform_vel = fixed_20_11(platform_vel_double).raw_value();
+    const TickBounds<ScalarSimd> bounds(map, platform_vel);
+    const ChunkCollision<ScalarSimd> collision(map);
 
-    if (tick % 32) return;
+    PROFILE_BEGIN(Phase::Update);
+    for (auto& b : asteroids.buckets) {
+        const int32_t base_x = b.base_x();
+        const int32_t base_y = b.base_y();
+        const uint32_t end = b.count;
+        uint64_t removed = 0;
+        uint64_t dead_bits = 0;
 
-    {
-        uint32_t write_index = 0;
         for (uint32_t i = 0; i < end; i++) {
-            const auto flags = asteroids.state[write_index] =
-                asteroids.state[i];
-            asteroids.position_x[write_index] = asteroids.position_x[i];
-            asteroids.position_y[write_index] = asteroids.position_y[i];
-            asteroids.velocity_x[write_index] = asteroids.velocity_x[i];
-            asteroids.velocity_y[write_index] = asteroids.velocity_y[i];
-            write_index += 1 - ((flags >> REMOVE_BIT_INDEX) & 1);
+            if (!(i & 63)) removed = b.removed.words[i >> 6];
+
+            // raw values
+            auto vx = static_cast<int32_t>(b.velocity_x[i].raw_value());
+            auto vy = static_cast<int32_t>(b.velocity_y[i].raw_value());
+
+            auto new_px = base_x + b.offset_x[i] + vx;
+            auto new_py = base_y + b.offset_y[i] + vy + platform_vel;
+
+            bool remove =
+                removed_lanes(bounds, collision, new_px, new_py, vx, vy);
+
+            auto is_dead = ((removed >> (i & 63)) & 1) | uint64_t(remove);
+            int32_t ox = new_px - base_x;
+            int32_t oy = new_py - base_y;
+            b.offset_x[i] = int16_t(ox);
+            b.offset_y[i] = int16_t(oy);
+            // left the cell, moves to its new bucket after the pass
+            if (!is_dead && (ox != int16_t(ox) || oy != int16_t(oy))) {
+                asteroids.migrants.push_back({b.id[i], b.state[i], new_px,
+                                              new_py, b.velocity_x[i],
+                                              b.velocity_y[i]});
+                is_dead = 1;
+            }
+            dead_bits |= is_dead << (i & 63);
+            if ((i & 63) == 63 || i + 1 == end) {
+                b.removed.store(i >> 6, dead_bits);
+                dead_bits = 0;
+            }
         }
-        asteroids.resize(write_index);
     }
-}
\ No newline at end of file
+    PROFILE_END(Phase::Update);
+
+    settle_asteroids(asteroids);
+}
+
+// plain loops, and SSE4.1 or wasm SIMD for 4 lanes where enabled
+uint64_t simd_check_scalar(uint32_t seed, uint32_t rounds) {
+    return simd_check<1>("normal.cpp", seed, rounds) +
+           simd_check<4>("normal.cpp", seed, rounds) +
+           simd_check<8>("normal.cpp", seed, rounds) +
+           simd_check<16>("normal.cpp", seed, rounds);
+}
@@ -0,0 +1,231 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "headers.hpp"
+
+// One entry per NUMA node that has CPUs, from /sys/devices/system/node on
+// Linux. Everywhere else (or without sysfs) it is a single node with no CPU
+// list, i.e. no pinning.
+struct NumaNode {
+    int id;
+    std::vector<int> cpus;
+};
+
+// "0-3,8-11" -> 0 1 2 3 8 9 10 11
+static inline std::vector<int> parse_cpu_list(const std::string& list) {
+    std::vector<int> cpus;
+    size_t begin = 0;
+    while (begin < list.size()) {
+        auto end = list.find(',', begin);
+        if (end == std::string::npos) end = list.size();
+        int lo, hi;
+        auto n = sscanf(list.c_str() + begin, "%d-%d", &lo, &hi);
+        if (n == 1) hi = lo;
+        if (n >= 1)
+            for (int c = lo; c <= hi; c++) cpus.push_back(c);
+        begin = end + 1;
+    }
+    return cpus;
+}
+
+static inline std::vector<NumaNode> numa_nodes() {
+    std::vector<NumaNode> nodes;
+#ifdef __linux__
+    auto read_line = [](const std::string& path) {
+        std::string line;
+        if (FILE* f = fopen(path.c_str(), "r")) {
+            char buf[4096];
+            if (fgets(buf, sizeof(buf), f)) line = buf;
+            fclose(f);
+        }
+        return line;
+    };
+    const std::string root = "/sys/devices/system/node/";
+    for (int id : parse_cpu_list(read_line(root + "online"))) {
+        auto cpus = parse_cpu_list(
+            read_line(root + "node" + std::to_string(id) + "/cpulist"));
+        // memory only nodes get no worker
+        if (!cpus.empty()) nodes.push_back({id, std::move(cpus)});
+    }
+#endif
+    if (nodes.empty()) nodes.push_back({0, {}});
+    return nodes;
+}
+
+static inline void pin_thread(const std::vector<int>& cpus) {
+#ifdef __linux__
+    if (cpus.empty()) return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int c : cpus)
+        if (c < CPU_SETSIZE) CPU_SET(c, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+#endif
+}
+
+// How many partitions the NUMA kernels split the asteroids into, 0 for one
+// per node. More partitions than nodes share the nodes round robin, which is
+// also how the code path gets exercised on a single node machine.
+inline uint32_t numa_partitions = 0;
+
+// One long lived thread per partition, pinned to its node's CPUs, with
+// huge_page_node set so every arena it maps is placed on that node.
+// run(fn) calls fn(partition) on all of them and waits.
+class NumaWorkers {
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    std::function<void(uint32_t)> job;
+    uint64_t generation = 0;
+    uint32_t pending = 0;
+    bool quit = false;
+
+    void loop(uint32_t k, NumaNode node) {
+        pin_thread(node.cpus);
+        huge_page_node = node.cpus.empty() ? -1 : node.id;
+        uint64_t seen = 0;
+        for (;;) {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return quit || generation != seen; });
+            if (quit) return;
+            seen = generation;
+            lock.unlock();
+            job(k);
+            lock.lock();
+            if (!--pending) done.notify_one();
+        }
+    }
+
+   public:
+    // node each partition belongs to
+    std::vector<NumaNode> nodes;
+
+    NumaWorkers() {
+        auto available = numa_nodes();
+        uint32_t n = numa_partitions ? numa_partitions
+                                     : uint32_t(available.size());
+        for (uint32_t k = 0; k < n; k++)
+            nodes.push_back(available[k % available.size()]);
+        for (uint32_t k = 0; k < n; k++)
+            threads.emplace_back(&NumaWorkers::loop, this, k, nodes[k]);
+    }
+
+    ~NumaWorkers() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        wake.notify_all();
+        for (auto& t : threads) t.join();
+    }
+
+    NumaWorkers(const NumaWorkers&) = delete;
+    NumaWorkers& operator=(const NumaWorkers&) = delete;
+
+    uint32_t size() const { return uint32_t(threads.size()); }
+
+    void run(std::function<void(uint32_t)> fn) {
+        std::unique_lock<std::mutex> lock(mutex);
+        job = std::move(fn);
+        pending = size();
+        generation++;
+        wake.notify_all();
+        done.wait(lock, [&] { return !pending; });
+    }
+
+    // kernel thread ids of the workers, for the perf counters (linux only)
+    std::vector<int> thread_ids() {
+        std::vector<int> tids(size(), -1);
+#ifdef __linux__
+        run([&](uint32_t k) { tids[k] = int(syscall(SYS_gettid)); });
+#endif
+        return tids;
+    }
+};
+
+// The asteroids split into contiguous ranges, one AsteroidStrideArray per
+// partition. Each array is created, populated, updated and compacted by its
+// own worker, so its columns stay on the worker's node and compaction never
+// crosses nodes. Concatenating the partitions gives the same order as the
+// single array would.
+class NumaStrideArray {
+    std::vector<std::unique_ptr<AsteroidStrideArray>> parts;
+
+   public:
+    NumaWorkers workers;
+    // index of the first asteroid of each partition at populate time
+    std::vector<size_t> first;
+
+    // per partition, time spent in the update and the asteroids it updated
+    struct NodeStats {
+        double ns = 0;
+        uint64_t asteroid_ticks = 0;
+    };
+    std::vector<NodeStats> stats;
+
+    NumaStrideArray() {
+        for (uint32_t k = 0; k < workers.size(); k++)
+            parts.push_back(std::make_unique<AsteroidStrideArray>());
+        first.resize(workers.size());
+        stats.resize(workers.size());
+    }
+
+    uint32_t partitions() const { return uint32_t(parts.size()); }
+    AsteroidStrideArray& part(uint32_t k) { return *parts[k]; }
+    const AsteroidStrideArray& part(uint32_t k) const { return *parts[k]; }
+
+    size_t size() const {
+        size_t n = 0;
+        for (auto& p : parts) n += p->size();
+        return n;
+    }
+
+    // splits n into 64 aligned ranges, the workers allocate their own
+    void resize(size_t n) {
+        const size_t per = ((n + partitions() - 1) / partitions() + 63) &
+                           ~size_t(63);
+        workers.run([&](uint32_t k) {
+            first[k] = std::min(n, k * per);
+            parts[k]->resize(std::min(n, first[k] + per) - first[k]);
+        });
+    }
+
+    void reset_stats() { stats.assign(partitions(), NodeStats()); }
+};
+
+// Runs Update on every partition in parallel, on its own node. Phase markers
+// are left to the calling thread, which sees the whole parallel pass as one
+// update phase; the benchmark attaches the workers to the listener so their
+// counters are summed into it.
+template <void (*Update)(AsteroidStrideArray&, const Map*, double)>
+static inline void update_asteroids_numa(NumaStrideArray& asteroids,
+                                         const Map* map, double vel) {
+    PROFILE_PHASE(Phase::Update);
+    auto listener = std::exchange(phase_listener, nullptr);
+    asteroids.workers.run([&](uint32_t k) {
+        auto& part = asteroids.part(k);
+        auto& stats = asteroids.stats[k];
+        stats.asteroid_ticks += part.size();
+        auto start = std::chrono::steady_clock::now();
+        Update(part, map, vel);
+        stats.ns += std::chrono::duration<double, std::nano>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+    });
+    phase_listener = listener;
+}
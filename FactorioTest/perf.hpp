@@ -0,0 +1,207 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "profile.hpp"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#endif
+
+// Hardware counters per kernel phase via perf_event_open. Every event is
+// opened on its own (not as a group) so the ones the PMU or the container
+// does not provide are simply missing, and multiplexed ones get scaled by
+// time_enabled / time_running. On other platforms nothing is available.
+class PerfCounters : public PhaseListener {
+   public:
+    enum Event {
+        Cycles,
+        Instructions,
+        L1DMisses,
+        LLCMisses,
+        BranchMisses,
+        DTLBMisses,
+        PageFaults,
+        EVENT_COUNT
+    };
+
+    static const char* event_name(uint32_t e) {
+        constexpr const char* names[EVENT_COUNT] = {
+            "cycles",           "instructions", "l1d_misses",
+            "llc_misses",       "branch_misses", "dtlb_misses",
+            "page_faults"};
+        return names[e];
+    }
+
+    // accumulated (scaled) counts per phase
+    double counts[PHASE_COUNT][EVENT_COUNT] = {};
+    uint64_t calls[PHASE_COUNT] = {};
+
+    PerfCounters() : sets(1) {
+#ifdef __linux__
+        for (uint32_t e = 0; e < EVENT_COUNT; e++) {
+            sets[0].fds[e] = open_event(e, 0);
+            if (sets[0].fds[e] < 0)
+                fprintf(stderr, "perf: %s unavailable (%s)\n", event_name(e),
+                        strerror(errno));
+        }
+#else
+        fprintf(stderr, "perf: counters are only supported on linux\n");
+#endif
+    }
+
+    ~PerfCounters() {
+        detach_threads();
+        close_set(sets[0]);
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool available(uint32_t e) const { return sets[0].fds[e] >= 0; }
+
+    bool any_available() const {
+        for (uint32_t e = 0; e < EVENT_COUNT; e++)
+            if (available(e)) return true;
+        return false;
+    }
+
+    void reset() {
+        memset(counts, 0, sizeof(counts));
+        memset(calls, 0, sizeof(calls));
+    }
+
+    // The events only count the thread that opened them, so kernels that
+    // hand their work to other threads attach those for the duration; their
+    // counts are added to the calling thread's.
+    void attach_threads(const std::vector<int>& tids) override {
+        detach_threads();
+#ifdef __linux__
+        for (int tid : tids) {
+            Set& set = sets.emplace_back();
+            for (uint32_t e = 0; e < EVENT_COUNT; e++)
+                if (available(e)) set.fds[e] = open_event(e, tid);
+        }
+#else
+        (void)tids;
+#endif
+    }
+
+    void detach_threads() override {
+        for (size_t i = 1; i < sets.size(); i++) close_set(sets[i]);
+        sets.resize(1);
+    }
+
+    void phase_begin(Phase /*phase*/) override {
+        for (auto& set : sets)
+            for (uint32_t e = 0; e < EVENT_COUNT; e++)
+                read(set.fds[e], set.begin[e]);
+    }
+
+    void phase_end(Phase phase) override {
+        for (auto& set : sets) {
+            for (uint32_t e = 0; e < EVENT_COUNT; e++) {
+                Sample end;
+                if (!read(set.fds[e], end)) continue;
+                const Sample& begin = set.begin[e];
+                double value = double(end.value - begin.value);
+                uint64_t enabled = end.enabled - begin.enabled;
+                uint64_t running = end.running - begin.running;
+                // multiplexed: extrapolate to the full phase
+                if (running && running < enabled)
+                    value *= double(enabled) / double(running);
+                counts[uint32_t(phase)][e] += value;
+            }
+        }
+        calls[uint32_t(phase)]++;
+    }
+
+   private:
+    struct Sample {
+        uint64_t value = 0;
+        uint64_t enabled = 0;
+        uint64_t running = 0;
+    };
+
+    // one set per counted thread, the first is the one that created us
+    struct Set {
+        int fds[EVENT_COUNT];
+        Sample begin[EVENT_COUNT];
+
+        Set() {
+            for (auto& fd : fds) fd = -1;
+        }
+    };
+
+    std::vector<Set> sets;
+
+    static int open_event(uint32_t e, int tid) {
+#ifdef __linux__
+        struct Config {
+            uint32_t type;
+            uint64_t config;
+        };
+        constexpr auto cache = [](uint64_t id, uint64_t result) {
+            return id | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (result << 16);
+        };
+        const Config configs[EVENT_COUNT] = {
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_L1D,
+                                       PERF_COUNT_HW_CACHE_RESULT_MISS)},
+            {PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_LL,
+                                       PERF_COUNT_HW_CACHE_RESULT_MISS)},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+            {PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_DTLB,
+                                       PERF_COUNT_HW_CACHE_RESULT_MISS)},
+            {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+        };
+
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = configs[e].type;
+        attr.config = configs[e].config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format =
+            PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        int fd = int(syscall(SYS_perf_event_open, &attr, tid, -1, -1, 0));
+        if (fd < 0) return -1;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        return fd;
+#else
+        (void)e;
+        (void)tid;
+        return -1;
+#endif
+    }
+
+    static void close_set(Set& set) {
+#ifdef __linux__
+        for (auto& fd : set.fds)
+            if (fd >= 0) close(fd);
+#endif
+        for (auto& fd : set.fds) fd = -1;
+    }
+
+    static bool read(int fd, Sample& sample) {
+#ifdef __linux__
+        if (fd < 0) return false;
+        return ::read(fd, &sample, sizeof(sample)) == sizeof(sample);
+#else
+        (void)fd;
+        (void)sample;
+        return false;
+#endif
+    }
+};
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Phase markers in the kernels cost a null check each. Build with
+// ENABLE_PROFILING=0 to compile them out entirely (the wasm build does).
+#ifndef ENABLE_PROFILING
+#ifdef __EMSCRIPTEN__
+#define ENABLE_PROFILING 0
+#else
+#define ENABLE_PROFILING 1
+#endif
+#endif
+
+// Kernel phases, reported to whatever listener the benchmark installs.
+enum class Phase : uint8_t { Update, Compaction, Spawn, MapEdit };
+constexpr uint32_t PHASE_COUNT = 4;
+
+static inline const char* phase_name(Phase phase) {
+    constexpr const char* names[PHASE_COUNT] = {"update", "compaction",
+                                                "spawn", "map_edit"};
+    return names[uint32_t(phase)];
+}
+
+struct PhaseListener {
+    virtual void tick_begin() {}
+    virtual void tick_end() {}
+    virtual void phase_begin(Phase phase) = 0;
+    virtual void phase_end(Phase phase) = 0;
+    // threads that work on behalf of the one reporting the phases
+    virtual void attach_threads(const std::vector<int>& /*tids*/) {}
+    virtual void detach_threads() {}
+};
+
+// fans out to several listeners, e.g. counters and timers at once
+struct PhaseListenerChain : PhaseListener {
+    std::vector<PhaseListener*> listeners;
+
+    void tick_begin() override {
+        for (auto l : listeners) l->tick_begin();
+    }
+    void tick_end() override {
+        for (auto l : listeners) l->tick_end();
+    }
+    void phase_begin(Phase phase) override {
+        for (auto l : listeners) l->phase_begin(phase);
+    }
+    void phase_end(Phase phase) override {
+        for (auto l : listeners) l->phase_end(phase);
+    }
+    void attach_threads(const std::vector<int>& tids) override {
+        for (auto l : listeners) l->attach_threads(tids);
+    }
+    void detach_threads() override {
+        for (auto l : listeners) l->detach_threads();
+    }
+};
+
+// null unless the benchmark is collecting counters or timings
+inline PhaseListener* phase_listener = nullptr;
+
+#if ENABLE_PROFILING
+
+static inline void profile_begin(Phase phase) {
+    if (phase_listener) phase_listener->phase_begin(phase);
+}
+static inline void profile_end(Phase phase) {
+    if (phase_listener) phase_listener->phase_end(phase);
+}
+static inline void profile_tick_begin() {
+    if (phase_listener) phase_listener->tick_begin();
+}
+static inline void profile_tick_end() {
+    if (phase_listener) phase_listener->tick_end();
+}
+
+class PhaseScope {
+    Phase phase;
+
+   public:
+    explicit PhaseScope(Phase phase) : phase(phase) { profile_begin(phase); }
+    ~PhaseScope() { profile_end(phase); }
+    PhaseScope(const PhaseScope&) = delete;
+    PhaseScope& operator=(const PhaseScope&) = delete;
+};
+
+#define PHASE_CONCAT_(a, b) a##b
+#define PHASE_CONCAT(a, b) PHASE_CONCAT_(a, b)
+// scoped, or explicit begin/end around a loop
+#define PROFILE_PHASE(phase) \
+    PhaseScope PHASE_CONCAT(phase_scope_, __LINE__)(phase)
+#define PROFILE_BEGIN(phase) profile_begin(phase)
+#define PROFILE_END(phase) profile_end(phase)
+#define PROFILE_TICK_BEGIN() profile_tick_begin()
+#define PROFILE_TICK_END() profile_tick_end()
+
+#else
+
+#define PROFILE_PHASE(phase) ((void)0)
+#define PROFILE_BEGIN(phase) ((void)0)
+#define PROFILE_END(phase) ((void)0)
+#define PROFILE_TICK_BEGIN() ((void)0)
+#define PROFILE_TICK_END() ((void)0)
+
+#endif
@@ -0,0 +1,153 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "headers.hpp"
+
+// Cells are 32x32 tiles. 32 tiles are 65536 raw fixed_20_11 units, so every
+// position in a cell is an exact int16 offset from the cell centre.
+constexpr int32_t CELL_SHIFT = 16;
+
+static inline int32_t cell_of(int32_t raw) {
+    return int32_t((int64_t(raw) + 0x8000) >> CELL_SHIFT);
+}
+
+// The asteroids of one cell. Offsets and velocities are all the update pass
+// reads (8 bytes) and the offsets all it writes (4 bytes). Columns are padded
+// to a multiple of 64 so the AVX2 kernel can run past count.
+struct AsteroidBucket {
+    int32_t cell_x = 0;
+    int32_t cell_y = 0;
+    uint32_t count = 0;
+
+    vector<int16_t> offset_x;
+    vector<int16_t> offset_y;
+    vector<fixed_4_11> velocity_x;
+    vector<fixed_4_11> velocity_y;
+    // cold
+    vector<uint32_t> state;
+    // population index, only used to line up with the reference
+    vector<uint32_t> id;
+    // removed, or moved to another cell
+    DeadSlotMap removed;
+
+    int32_t base_x() const { return cell_x * (1 << CELL_SHIFT); }
+    int32_t base_y() const { return cell_y * (1 << CELL_SHIFT); }
+    size_t size() const { return count; }
+
+    // x and y must be inside the cell
+    void push(uint32_t index, uint32_t flags, int32_t x, int32_t y,
+              fixed_4_11 vx, fixed_4_11 vy) {
+        if (count == offset_x.size()) grow(count + 64);
+        offset_x[count] = int16_t(x - base_x());
+        offset_y[count] = int16_t(y - base_y());
+        velocity_x[count] = vx;
+        velocity_y[count] = vy;
+        state[count] = flags;
+        id[count] = index;
+        removed.set(count, false);
+        count++;
+    }
+
+    // stable, like the stride sweep
+    void compact() {
+        uint32_t write = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            if (removed.test(i)) continue;
+            offset_x[write] = offset_x[i];
+            offset_y[write] = offset_y[i];
+            velocity_x[write] = velocity_x[i];
+            velocity_y[write] = velocity_y[i];
+            state[write] = state[i];
+            id[write] = id[i];
+            write++;
+        }
+        count = write;
+        removed.clear();
+    }
+
+   private:
+    void grow(size_t n) {
+        offset_x.resize(n);
+        offset_y.resize(n);
+        velocity_x.resize(n);
+        velocity_y.resize(n);
+        state.resize(n);
+        id.resize(n);
+        removed.resize(count, count, n);
+    }
+};
+
+// Compact store: one bucket per occupied cell with 16 bit positions relative
+// to the cell, half the bytes of AsteroidStrideArray per tick. An asteroid
+// that leaves its cell is flagged in its bucket by the kernel and re-based
+// exactly into the bucket of its new cell after the pass, so positions stay
+// bit-identical to the fixed_20_11 kernels. Only the order changes, id keeps
+// the population order.
+class AsteroidQuantizedArray {
+    // (cell_x, cell_y) -> bucket
+    std::unordered_map<uint64_t, uint32_t> index;
+
+   public:
+    vector<AsteroidBucket> buckets;
+    uint32_t tick = 0;
+
+    // left their cell during the pass, absolute positions
+    struct Migrant {
+        uint32_t id;
+        uint32_t state;
+        int32_t x, y;
+        fixed_4_11 vx, vy;
+    };
+    vector<Migrant> migrants;
+    uint64_t migrated = 0;
+    // asteroids populate_asteroids will put in
+    size_t populate_count = 0;
+
+    // slots, including removed asteroids not compacted yet
+    size_t size() const {
+        size_t n = 0;
+        for (auto& b : buckets) n += b.size();
+        return n;
+    }
+
+    // drops everything, populate_asteroids fills in n new ones
+    void resize(size_t n) {
+        buckets.clear();
+        index.clear();
+        migrants.clear();
+        populate_count = n;
+    }
+
+    AsteroidBucket& bucket_at(int32_t x, int32_t y) {
+        int32_t cx = cell_of(x), cy = cell_of(y);
+        uint64_t key = (uint64_t(uint32_t(cx)) << 32) | uint32_t(cy);
+        auto [it, added] = index.try_emplace(key, uint32_t(buckets.size()));
+        if (added) {
+            buckets.emplace_back();
+            buckets.back().cell_x = cx;
+            buckets.back().cell_y = cy;
+        }
+        return buckets[it->second];
+    }
+
+    void insert(uint32_t id, uint32_t state, int32_t x, int32_t y,
+                fixed_4_11 vx, fixed_4_11 vy) {
+        bucket_at(x, y).push(id, state, x, y, vx, vy);
+    }
+};
+
+// After the update pass: re-bases the migrants and compacts every bucket on
+// the interval ticks.
+static inline void settle_asteroids(AsteroidQuantizedArray& asteroids) {
+    for (auto& m : asteroids.migrants)
+        asteroids.insert(m.id, m.state, m.x, m.y, m.vx, m.vy);
+    asteroids.migrated += asteroids.migrants.size();
+    asteroids.migrants.clear();
+
+    if (++asteroids.tick % COMPACTION_INTERVAL) return;
+    PROFILE_PHASE(Phase::Compaction);
+    for (auto& b : asteroids.buckets) b.compact();
+}
@@ -0,0 +1,380 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#ifdef __linux__
+#include <sys/utsname.h>
+#endif
+
+#include "histogram.hpp"
+
+struct MachineInfo {
+    std::string cpu = "unknown";
+    std::string os = "unknown";
+    std::string compiler = "unknown";
+    uint32_t logical_cores = 0;
+    // bytes, 0 if unknown
+    size_t l1d = 0;
+    size_t l2 = 0;
+    size_t l3 = 0;
+    bool avx2 = false;
+    bool avx512 = false;  // F + VL + DQ + BW
+};
+
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+static inline void cpuid(uint32_t leaf, uint32_t sub, uint32_t out[4]) {
+#if defined(_MSC_VER)
+    int regs[4];
+    __cpuidex(regs, int(leaf), int(sub));
+    for (int i = 0; i < 4; i++) out[i] = uint32_t(regs[i]);
+#else
+    __cpuid_count(leaf, sub, out[0], out[1], out[2], out[3]);
+#endif
+}
+
+static inline uint64_t xgetbv0() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return (uint64_t(hi) << 32) | lo;
+#endif
+}
+#define HAS_CPUID 1
+#endif
+
+static inline void query_isa(MachineInfo& info) {
+#ifdef HAS_CPUID
+    uint32_t r[4];
+    cpuid(0, 0, r);
+    if (r[0] < 7) return;
+    cpuid(1, 0, r);
+    bool osxsave = r[2] & (1u << 27);
+    if (!osxsave) return;
+    uint64_t xcr0 = xgetbv0();
+    bool ymm = (xcr0 & 0x6) == 0x6;
+    bool zmm = (xcr0 & 0xE6) == 0xE6;
+    cpuid(7, 0, r);
+    info.avx2 = ymm && (r[1] & (1u << 5));
+    // F, DQ, BW, VL
+    constexpr uint32_t avx512_bits =
+        (1u << 16) | (1u << 17) | (1u << 30) | (1u << 31);
+    info.avx512 = zmm && (r[1] & avx512_bits) == avx512_bits;
+#endif
+}
+
+static inline void query_cpu_name(MachineInfo& info) {
+#ifdef HAS_CPUID
+    uint32_t r[4];
+    cpuid(0x80000000, 0, r);
+    if (r[0] < 0x80000004) return;
+    char brand[49] = {};
+    for (uint32_t i = 0; i < 3; i++) {
+        cpuid(0x80000002 + i, 0, r);
+        memcpy(brand + i * 16, r, 16);
+    }
+    std::string s = brand;
+    s.erase(0, s.find_first_not_of(' '));
+    s.erase(s.find_last_not_of(' ') + 1);
+    if (!s.empty()) info.cpu = s;
+#endif
+}
+
+static inline void query_caches(MachineInfo& info) {
+#if defined(_WIN32)
+    DWORD len = 0;
+    GetLogicalProcessorInformation(nullptr, &len);
+    std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> buf(
+        len / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+    if (!GetLogicalProcessorInformation(buf.data(), &len)) return;
+    for (auto& e : buf) {
+        if (e.Relationship != RelationCache) continue;
+        auto& c = e.Cache;
+        if (c.Level == 1 && c.Type == CacheData) info.l1d = c.Size;
+        if (c.Level == 2) info.l2 = c.Size;
+        if (c.Level == 3) info.l3 = c.Size;
+    }
+#elif defined(__linux__)
+    for (int i = 0; i < 8; i++) {
+        std::string dir =
+            "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(i);
+        auto read = [&](const char* file) {
+            std::string s;
+            if (FILE* f = fopen((dir + "/" + file).c_str(), "r")) {
+                char line[64] = {};
+                if (fgets(line, sizeof(line), f)) s = line;
+                fclose(f);
+            }
+            while (!s.empty() && (s.back() == '\n' || s.back() == ' '))
+                s.pop_back();
+            return s;
+        };
+        auto level = read("level");
+        if (level.empty()) break;
+        auto type = read("type");
+        auto size_str = read("size");
+        size_t size = strtoull(size_str.c_str(), nullptr, 10);
+        if (!size_str.empty() && size_str.back() == 'K') size *= 1024;
+        if (!size_str.empty() && size_str.back() == 'M') size *= 1024 * 1024;
+        if (level == "1" && type == "Data") info.l1d = size;
+        if (level == "2") info.l2 = size;
+        if (level == "3") info.l3 = size;
+    }
+#endif
+}
+
+static inline MachineInfo query_machine_info() {
+    MachineInfo info;
+    info.logical_cores = std::thread::hardware_concurrency();
+    query_isa(info);
+    query_cpu_name(info);
+    query_caches(info);
+
+#if defined(_WIN32)
+    info.os = "windows";
+#elif defined(__EMSCRIPTEN__)
+    info.os = "wasm";
+#elif defined(__linux__)
+    struct utsname u;
+    info.os = uname(&u) == 0 ? std::string(u.sysname) + " " + u.release
+                             : "linux";
+#endif
+
+#if defined(_MSC_VER)
+    info.compiler = "msvc " + std::to_string(_MSC_FULL_VER);
+#elif defined(__clang__)
+    info.compiler = std::string("clang ") + __clang_version__;
+#elif defined(__GNUC__)
+    info.compiler = std::string("gcc ") + __VERSION__;
+#endif
+#ifndef NDEBUG
+    info.compiler += " (debug)";
+#endif
+    return info;
+}
+
+// min/median/max over repetitions
+struct Stats {
+    double min = 0;
+    double median = 0;
+    double max = 0;
+
+    static Stats of(std::vector<double> v) {
+        Stats s;
+        if (v.empty()) return s;
+        std::sort(v.begin(), v.end());
+        s.min = v.front();
+        s.max = v.back();
+        auto n = v.size();
+        s.median = n & 1 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) * 0.5;
+        return s;
+    }
+};
+
+struct BenchRecord {
+    std::string kernel;
+    uint64_t asteroids = 0;  // initial population
+    int32_t platform = 0;    // platform half-size in tiles
+    std::string shape;       // platform layout, see --shape
+    double velocity = 0;     // platform velocity in tiles/tick
+    uint32_t ticks = 0;
+    uint32_t reps = 0;
+    uint64_t remaining = 0;  // population after the last rep
+    uint32_t bytes_per_asteroid = 0;
+    Stats ns_per_asteroid_tick;
+    Stats gb_per_sec;
+    Stats ms_total;
+    // -1 not validated, 0 failed, 1 passed
+    int32_t valid = -1;
+    // additional named metrics (counters, latency percentiles, ...)
+    std::vector<std::pair<std::string, double>> metrics;
+    // slowest ticks across all reps, if latency was recorded
+    std::vector<TickSample> worst_ticks;
+};
+
+enum class ReportFormat { Text, Json, Csv };
+
+static inline void json_string(FILE* out, const std::string& s) {
+    fputc('"', out);
+    for (char c : s) {
+        if (c == '"' || c == '\\') fputc('\\', out);
+        if (uint8_t(c) < 0x20) {
+            fprintf(out, "\\u%04x", c);
+            continue;
+        }
+        fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+static inline void json_stats(FILE* out, const char* key, const Stats& s) {
+    fprintf(out, "\"%s\": {\"min\": %.6g, \"median\": %.6g, \"max\": %.6g}",
+            key, s.min, s.median, s.max);
+}
+
+static inline void print_report(FILE* out, ReportFormat format,
+                                const MachineInfo& info,
+                                const std::vector<BenchRecord>& records) {
+    // union of extra metric names, in first-seen order
+    std::vector<std::string> metric_names;
+    for (auto& r : records)
+        for (auto& m : r.metrics)
+            if (std::find(metric_names.begin(), metric_names.end(),
+                          m.first) == metric_names.end())
+                metric_names.push_back(m.first);
+
+    auto metric = [](const BenchRecord& r, const std::string& name,
+                     double& value) {
+        for (auto& m : r.metrics)
+            if (m.first == name) return value = m.second, true;
+        return false;
+    };
+
+    if (format == ReportFormat::Json) {
+        fprintf(out, "{\n  \"machine\": {\"cpu\": ");
+        json_string(out, info.cpu);
+        fprintf(out, ", \"os\": ");
+        json_string(out, info.os);
+        fprintf(out, ", \"compiler\": ");
+        json_string(out, info.compiler);
+        fprintf(out,
+                ", \"logical_cores\": %u, \"l1d\": %zu, \"l2\": %zu, "
+                "\"l3\": %zu, \"avx2\": %s, \"avx512\": %s},\n",
+                info.logical_cores, info.l1d, info.l2, info.l3,
+                info.avx2 ? "true" : "false", info.avx512 ? "true" : "false");
+        fprintf(out, "  \"results\": [");
+        for (size_t i = 0; i < records.size(); i++) {
+            auto& r = records[i];
+            fprintf(out, "%s\n    {\"kernel\": ", i ? "," : "");
+            json_string(out, r.kernel);
+            fprintf(out, ", \"asteroids\": %llu, \"platform\": %d, \"shape\": ",
+                    (unsigned long long)r.asteroids, r.platform);
+            json_string(out, r.shape);
+            fprintf(out,
+                    ", \"velocity\": %.6g, \"ticks\": %u, \"reps\": %u, "
+                    "\"remaining\": %llu, \"bytes_per_asteroid\": %u, ",
+                    r.velocity, r.ticks, r.reps,
+                    (unsigned long long)r.remaining, r.bytes_per_asteroid);
+            json_stats(out, "ns_per_asteroid_tick", r.ns_per_asteroid_tick);
+            fprintf(out, ", ");
+            json_stats(out, "gb_per_sec", r.gb_per_sec);
+            fprintf(out, ", ");
+            json_stats(out, "ms_total", r.ms_total);
+            if (r.valid >= 0)
+                fprintf(out, ", \"valid\": %s", r.valid ? "true" : "false");
+            for (auto& m : r.metrics) {
+                fprintf(out, ", ");
+                json_string(out, m.first);
+                fprintf(out, ": %.6g", m.second);
+            }
+            if (!r.worst_ticks.empty()) {
+                fprintf(out, ", \"worst_ticks\": [");
+                for (size_t j = 0; j < r.worst_ticks.size(); j++) {
+                    auto& t = r.worst_ticks[j];
+                    fprintf(out, "%s{\"tick\": %llu, \"us\": %.6g",
+                            j ? ", " : "", (unsigned long long)t.tick,
+                            t.total_ns * 1e-3);
+                    for (uint32_t p = 0; p < PHASE_COUNT; p++)
+                        fprintf(out, ", \"%s_us\": %.6g",
+                                phase_name(Phase(p)), t.phase_ns[p] * 1e-3);
+                    fprintf(out, "}");
+                }
+                fprintf(out, "]");
+            }
+            fprintf(out, "}");
+        }
+        fprintf(out, "\n  ]\n}\n");
+        return;
+    }
+
+    if (format == ReportFormat::Csv) {
+        fprintf(out, "# cpu=%s; os=%s; compiler=%s; cores=%u; l1d=%zu; "
+                "l2=%zu; l3=%zu\n",
+                info.cpu.c_str(), info.os.c_str(), info.compiler.c_str(),
+                info.logical_cores, info.l1d, info.l2, info.l3);
+        fprintf(out,
+                "kernel,asteroids,platform,shape,velocity,ticks,reps,remaining,"
+                "bytes_per_asteroid,ns_min,ns_median,ns_max,gbps_min,"
+                "gbps_median,gbps_max,ms_min,ms_median,ms_max,valid");
+        for (auto& name : metric_names) fprintf(out, ",%s", name.c_str());
+        fprintf(out, "\n");
+        for (auto& r : records) {
+            fprintf(out,
+                    "%s,%llu,%d,%s,%.6g,%u,%u,%llu,%u,%.6g,%.6g,%.6g,%.6g,"
+                    "%.6g,%.6g,%.6g,%.6g,%.6g,%s",
+                    r.kernel.c_str(), (unsigned long long)r.asteroids,
+                    r.platform, r.shape.c_str(), r.velocity, r.ticks, r.reps,
+                    (unsigned long long)r.remaining, r.bytes_per_asteroid,
+                    r.ns_per_asteroid_tick.min, r.ns_per_asteroid_tick.median,
+                    r.ns_per_asteroid_tick.max, r.gb_per_sec.min,
+                    r.gb_per_sec.median, r.gb_per_sec.max, r.ms_total.min,
+                    r.ms_total.median, r.ms_total.max,
+                    r.valid < 0 ? "" : (r.valid ? "true" : "false"));
+            for (auto& name : metric_names) {
+                double v;
+                if (metric(r, name, v))
+                    fprintf(out, ",%.6g", v);
+                else
+                    fprintf(out, ",");
+            }
+            fprintf(out, "\n");
+        }
+        return;
+    }
+
+    fprintf(out, "CPU: %s (%u threads, avx2: %s, avx512: %s)\n",
+            info.cpu.c_str(), info.logical_cores, info.avx2 ? "yes" : "no",
+            info.avx512 ? "yes" : "no");
+    fprintf(out, "Cache: L1d %zu KB, L2 %zu KB, L3 %zu KB\n", info.l1d >> 10,
+            info.l2 >> 10, info.l3 >> 10);
+    fprintf(out, "OS: %s, compiler: %s\n\n", info.os.c_str(),
+            info.compiler.c_str());
+    fprintf(out, "%-16s %10s %6s %-9s %8s %10s %26s %8s %10s %6s\n",
+            "kernel", "N", "plat", "shape", "vel", "remain",
+            "ns/asteroid/tick min/med/max", "GB/s", "ms (med)", "valid");
+    for (auto& r : records) {
+        char ns[64];
+        snprintf(ns, sizeof(ns), "%.3f/%.3f/%.3f", r.ns_per_asteroid_tick.min,
+                 r.ns_per_asteroid_tick.median, r.ns_per_asteroid_tick.max);
+        fprintf(out,
+                "%-16s %10llu %6d %-9s %8.4f %10llu %26s %8.2f %10.2f %6s\n",
+                r.kernel.c_str(), (unsigned long long)r.asteroids, r.platform,
+                r.shape.c_str(), r.velocity, (unsigned long long)r.remaining,
+                ns, r.gb_per_sec.median, r.ms_total.median,
+                r.valid < 0 ? "-" : (r.valid ? "ok" : "FAIL"));
+        for (auto& m : r.metrics)
+            fprintf(out, "    %-36s %.4f\n", m.first.c_str(), m.second);
+        if (!r.worst_ticks.empty()) fprintf(out, "    worst ticks (us):\n");
+        for (auto& t : r.worst_ticks) {
+            fprintf(out, "      #%-6llu %10.1f  ", (unsigned long long)t.tick,
+                    t.total_ns * 1e-3);
+            for (uint32_t p = 0; p < PHASE_COUNT; p++)
+                if (t.phase_ns[p])
+                    fprintf(out, " %s %.1f", phase_name(Phase(p)),
+                            t.phase_ns[p] * 1e-3);
+            fprintf(out, "\n");
+        }
+    }
+}
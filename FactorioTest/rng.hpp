@@ -0,0 +1,142 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#ifndef __EMSCRIPTEN__
+#include <thread>
+#endif
+
+#include "headers.hpp"
+
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2,
+// 3"). Counter based: a block only depends on (key, counter), so any range
+// of asteroids can be generated on its own, by any thread, with any ISA, and
+// come out bit-identical.
+constexpr uint32_t PHILOX_M0 = 0xD2511F53;
+constexpr uint32_t PHILOX_M1 = 0xCD9E8D57;
+constexpr uint32_t PHILOX_W0 = 0x9E3779B9;
+constexpr uint32_t PHILOX_W1 = 0xBB67AE85;
+
+static inline void philox4x32(uint32_t ctr[4], uint32_t k0, uint32_t k1) {
+    for (uint32_t r = 0; r < 10; r++) {
+        uint64_t p0 = uint64_t(PHILOX_M0) * ctr[0];
+        uint64_t p1 = uint64_t(PHILOX_M1) * ctr[2];
+        uint32_t c1 = ctr[1], c3 = ctr[3];
+        ctr[0] = uint32_t(p1 >> 32) ^ c1 ^ k0;
+        ctr[1] = uint32_t(p1);
+        ctr[2] = uint32_t(p0 >> 32) ^ c3 ^ k1;
+        ctr[3] = uint32_t(p0);
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+}
+
+// independent streams under the same seed
+enum RngStream : uint32_t { RNG_POPULATE = 0, RNG_SPAWN = 1, RNG_RECYCLE = 2 };
+
+// Where asteroids appear, raw fixed point, bounds inclusive.
+struct SpawnBox {
+    int32_t min_x, max_x;
+    int32_t min_y, max_y;
+    int16_t max_v;
+    uint16_t prototypes = 4;
+
+    static SpawnBox from(double min_x, double max_x, double min_y,
+                         double max_y, double max_v) {
+        SpawnBox box;
+        box.min_x = fixed_20_11(min_x).raw_value();
+        box.max_x = std::max(box.min_x, fixed_20_11(max_x).raw_value());
+        box.min_y = fixed_20_11(min_y).raw_value();
+        box.max_y = std::max(box.min_y, fixed_20_11(max_y).raw_value());
+        box.max_v = int16_t(std::abs(fixed_4_11(max_v).raw_value()));
+        return box;
+    }
+};
+
+// SoA destination, element 0 is asteroid `first`
+struct AsteroidColumns {
+    uint32_t* state;
+    fixed_20_11* position_x;
+    fixed_20_11* position_y;
+    fixed_4_11* velocity_x;
+    fixed_4_11* velocity_y;
+
+    AsteroidColumns offset(size_t i) const {
+        return {state + i, position_x + i, position_y + i, velocity_x + i,
+                velocity_y + i};
+    }
+};
+
+static inline AsteroidColumns columns_of(AsteroidStrideArray& asteroids) {
+    return {asteroids.state.data(), asteroids.position_x.data(),
+            asteroids.position_y.data(), asteroids.velocity_x.data(),
+            asteroids.velocity_y.data()};
+}
+
+using GenerateFn = void (*)(const SpawnBox& box, uint32_t seed,
+                            uint32_t stream, uint64_t first, uint32_t n,
+                            const AsteroidColumns& out);
+
+// One philox block per asteroid, counter (index, stream), key (seed, 0):
+//   r0 -> prototype from the top bits, the low 15 bits kept as state
+//   r1, r2 -> position, multiply-shift into the box
+//   r3 -> velocity x from the low half, y from the high half
+// The AVX2 version computes exactly the same thing 8 lanes at a time.
+static inline void generate_asteroids_scalar(const SpawnBox& box,
+                                             uint32_t seed, uint32_t stream,
+                                             uint64_t first, uint32_t n,
+                                             const AsteroidColumns& out) {
+    const uint32_t rx = uint32_t(box.max_x - box.min_x) + 1;
+    const uint32_t ry = uint32_t(box.max_y - box.min_y) + 1;
+    const uint32_t rv = uint32_t(box.max_v) * 2 + 1;
+    for (uint32_t i = 0; i < n; i++) {
+        uint64_t index = first + i;
+        uint32_t r[4] = {uint32_t(index), uint32_t(index >> 32), stream, 0};
+        philox4x32(r, seed, 0);
+
+        out.state[i] =
+            (uint32_t((uint64_t(r[0]) * box.prototypes) >> 32) << 16) |
+            (r[0] & (0xFFFF ^ REMOVE_BIT));
+        out.position_x[i] = fixed_20_11::from_raw_value(
+            box.min_x + int32_t((uint64_t(r[1]) * rx) >> 32));
+        out.position_y[i] = fixed_20_11::from_raw_value(
+            box.min_y + int32_t((uint64_t(r[2]) * ry) >> 32));
+        out.velocity_x[i] = fixed_4_11::from_raw_value(
+            int16_t(int32_t(((r[3] & 0xFFFF) * rv) >> 16) - box.max_v));
+        out.velocity_y[i] = fixed_4_11::from_raw_value(
+            int16_t(int32_t(((r[3] >> 16) * rv) >> 16) - box.max_v));
+    }
+}
+
+#ifndef __EMSCRIPTEN__
+void generate_asteroids_avx2(const SpawnBox& box, uint32_t seed,
+                             uint32_t stream, uint64_t first, uint32_t n,
+                             const AsteroidColumns& out);
+#endif
+
+// scalar unless the benchmark found AVX2, results are the same either way
+inline GenerateFn generate_asteroids = generate_asteroids_scalar;
+
+// Calls fn(first, count) over [0, n) split into contiguous ranges, one per
+// thread. Ranges are multiples of 64 so threads never share a cache line.
+template <typename Fn>
+static inline void parallel_ranges(size_t n, uint32_t threads, Fn&& fn) {
+#ifdef __EMSCRIPTEN__
+    threads = 1;
+#else
+    if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+#endif
+    size_t per = ((n + threads - 1) / threads + 63) & ~size_t(63);
+    if (threads == 1 || n <= per) {
+        fn(size_t(0), n);
+        return;
+    }
+#ifndef __EMSCRIPTEN__
+    std::vector<std::thread> workers;
+    for (size_t first = 0; first < n; first += per)
+        workers.emplace_back(fn, first, std::min(per, n - first));
+    for (auto& w : workers) w.join();
+#endif
+}
@@ -0,0 +1,195 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "fpm/fixed.hpp"
+#include "fpm/simd.hpp"
+
+// fpm/simd.hpp against scalar fpm::fixed and int32_t on random lanes, every
+// operation of fixed_batch and int_batch for the instruction set this
+// translation unit builds Width lanes with. The tick kernels only add and
+// convert, so mul, compare and shift are checked nowhere else. Returns the
+// lanes that differ, printing the first one of every operation. Arch is a
+// parameter so the instantiations of two translation units stay apart.
+template <unsigned int Width, typename Arch = fpm::simd::native_t<Width>>
+uint64_t simd_check(const char* name, uint32_t seed, uint32_t rounds) {
+    using Wide = fpm::fixed<int32_t, int64_t, 11>;
+    using Trunc = fpm::fixed<int32_t, int64_t, 11, false>;
+    using Narrow = fpm::fixed<int16_t, int32_t, 11>;
+    using Coarse = fpm::fixed<int32_t, int64_t, 8>;
+    using Fine = fpm::fixed<int32_t, int64_t, 14>;
+    using WideB = fpm::fixed_batch<int32_t, int64_t, 11, Width, true, Arch>;
+    using TruncB = fpm::fixed_batch<int32_t, int64_t, 11, Width, false, Arch>;
+    using NarrowB = fpm::fixed_batch<int16_t, int32_t, 11, Width, true, Arch>;
+    using CoarseB = fpm::fixed_batch<int32_t, int64_t, 8, Width, true, Arch>;
+    using FineB = fpm::fixed_batch<int32_t, int64_t, 14, Width, true, Arch>;
+    using Int = fpm::int_batch<Width, Arch>;
+
+    uint64_t failed = 0;
+    std::vector<const char*> reported;
+    auto expect = [&](const char* op, uint32_t j, int64_t got, int64_t want,
+                      int32_t a, int32_t b) {
+        if (got == want) return;
+        failed++;
+        for (auto r : reported)
+            if (r == op) return;
+        reported.push_back(op);
+        fprintf(stderr,
+                "simd check %s x%u: %s of %d, %d gives %lld in lane %u, "
+                "scalar %lld\n",
+                name, Width, op, a, b, (long long)got, j, (long long)want);
+    };
+
+    // whole range, small, and the edges, lane by lane
+    std::mt19937 rng(seed);
+    auto draw = [&]() -> int32_t {
+        constexpr int32_t edges[] = {0,    1,     -1,    1023, 1024, -1024,
+                                     2047, -2048, 32767, -32768,
+                                     std::numeric_limits<int32_t>::max(),
+                                     std::numeric_limits<int32_t>::min()};
+        switch (rng() % 4) {
+            case 0:
+                return int32_t(rng());
+            case 1:
+                return int32_t(rng() % 8192) - 4096;
+            case 2:
+                return int32_t(rng() % (1u << 24)) - (1 << 23);
+            default:
+                return edges[rng() % std::size(edges)];
+        }
+    };
+
+    alignas(64) int32_t a[Width], b[Width], ha[Width], hb[Width];
+    alignas(64) int16_t na[Width], nb[Width];
+    for (uint32_t round = 0; round < rounds; round++) {
+        for (uint32_t j = 0; j < Width; j++) {
+            a[j] = draw();
+            b[j] = draw();
+            // no overflow in the scalar sums and left shifts
+            ha[j] = a[j] / 4;
+            hb[j] = b[j] / 4;
+            na[j] = int16_t(a[j]);
+            nb[j] = int16_t(b[j]);
+        }
+        const Int ia = Int::load(a), ib = Int::load(b);
+        const Int iha = Int::load(ha), ihb = Int::load(hb);
+        const int n = int(rng() % 32);
+
+        // int_batch, wrapping like the unsigned arithmetic
+        {
+            const Int add = ia + ib, sub = ia - ib, mul = ia * ib;
+            const Int neg = -ia, and_ = ia & ib, or_ = ia | ib, xor_ = ia ^ ib;
+            const Int sra = ia >> n, sll = ia << n;
+            const Int lo = min(ia, ib), hi = max(ia, ib);
+            const uint32_t eq = ia == ib, ne = ia != ib, gt = ia > ib,
+                           lt = ia < ib, le = ia <= ib, ge = ia >= ib;
+            const Int from16 = Int::load(na);
+            for (uint32_t j = 0; j < Width; j++) {
+                const int32_t x = a[j], y = b[j];
+                const uint32_t ux = uint32_t(x), uy = uint32_t(y);
+                expect("int +", j, add[j], int32_t(ux + uy), x, y);
+                expect("int -", j, sub[j], int32_t(ux - uy), x, y);
+                expect("int *", j, mul[j], int32_t(ux * uy), x, y);
+                expect("int neg", j, neg[j], int32_t(0u - ux), x, y);
+                expect("int &", j, and_[j], x & y, x, y);
+                expect("int |", j, or_[j], x | y, x, y);
+                expect("int ^", j, xor_[j], x ^ y, x, y);
+                expect("int >>", j, sra[j], x >> n, x, n);
+                expect("int <<", j, sll[j], int32_t(ux << n), x, n);
+                expect("int min", j, lo[j], std::min(x, y), x, y);
+                expect("int max", j, hi[j], std::max(x, y), x, y);
+                expect("int ==", j, (eq >> j) & 1, x == y, x, y);
+                expect("int !=", j, (ne >> j) & 1, x != y, x, y);
+                expect("int >", j, (gt >> j) & 1, x > y, x, y);
+                expect("int <", j, (lt >> j) & 1, x < y, x, y);
+                expect("int <=", j, (le >> j) & 1, x <= y, x, y);
+                expect("int >=", j, (ge >> j) & 1, x >= y, x, y);
+                expect("int load16", j, from16[j], na[j], na[j], 0);
+            }
+        }
+
+        // int32 fixed, the sums on the quartered lanes
+        {
+            const WideB x = WideB::from_raw_value(ia);
+            const WideB y = WideB::from_raw_value(ib);
+            const WideB hx = WideB::from_raw_value(iha);
+            const WideB hy = WideB::from_raw_value(ihb);
+            const WideB add = hx + hy, sub = hx - hy, mul = x * y, neg = -hx;
+            const TruncB tmul =
+                TruncB::from_raw_value(ia) * TruncB::from_raw_value(ib);
+            const WideB lo = min(x, y), hi = max(x, y);
+            const Int floor = ifloor(x), whole = Int(x);
+            const CoarseB coarse(x);
+            const FineB fine(WideB::from_raw_value(Int::load(ha) >> 4));
+            const NarrowB narrow(x);
+            const uint32_t eq = x == y, ne = x != y, gt = x > y, lt = x < y,
+                           le = x <= y, ge = x >= y;
+            for (uint32_t j = 0; j < Width; j++) {
+                const Wide sx = Wide::from_raw_value(a[j]);
+                const Wide sy = Wide::from_raw_value(b[j]);
+                const Wide shx = Wide::from_raw_value(ha[j]);
+                const Wide shy = Wide::from_raw_value(hb[j]);
+                const int32_t u = a[j], v = b[j];
+                expect("fixed +", j, add[j].raw_value(),
+                       (shx + shy).raw_value(), ha[j], hb[j]);
+                expect("fixed -", j, sub[j].raw_value(),
+                       (shx - shy).raw_value(), ha[j], hb[j]);
+                expect("fixed *", j, mul[j].raw_value(), (sx * sy).raw_value(),
+                       u, v);
+                expect("fixed * truncating", j, tmul[j].raw_value(),
+                       (Trunc::from_raw_value(u) * Trunc::from_raw_value(v))
+                           .raw_value(),
+                       u, v);
+                expect("fixed neg", j, neg[j].raw_value(), (-shx).raw_value(),
+                       ha[j], 0);
+                expect("fixed min", j, lo[j].raw_value(),
+                       std::min(sx, sy).raw_value(), u, v);
+                expect("fixed max", j, hi[j].raw_value(),
+                       std::max(sx, sy).raw_value(), u, v);
+                expect("fixed ifloor", j, floor[j], u >> 11, u, 0);
+                expect("fixed to int", j, whole[j], int32_t(sx), u, 0);
+                expect("fixed to 8 bits", j, coarse[j].raw_value(),
+                       Coarse(sx).raw_value(), u, 0);
+                expect("fixed to 14 bits", j, fine[j].raw_value(),
+                       Fine(Wide::from_raw_value(ha[j] >> 4)).raw_value(),
+                       ha[j] >> 4, 0);
+                expect("fixed to int16", j, narrow[j].raw_value(),
+                       Narrow(sx).raw_value(), u, 0);
+                expect("fixed ==", j, (eq >> j) & 1, sx == sy, u, v);
+                expect("fixed !=", j, (ne >> j) & 1, sx != sy, u, v);
+                expect("fixed >", j, (gt >> j) & 1, sx > sy, u, v);
+                expect("fixed <", j, (lt >> j) & 1, sx < sy, u, v);
+                expect("fixed <=", j, (le >> j) & 1, sx <= sy, u, v);
+                expect("fixed >=", j, (ge >> j) & 1, sx >= sy, u, v);
+            }
+        }
+
+        // int16 fixed, wrapped back after every operation
+        {
+            const NarrowB x = NarrowB::load(
+                reinterpret_cast<const typename NarrowB::value_type*>(na));
+            const NarrowB y = NarrowB::load(
+                reinterpret_cast<const typename NarrowB::value_type*>(nb));
+            const NarrowB add = x + y, sub = x - y, mul = x * y, neg = -x;
+            const WideB wide(x);
+            for (uint32_t j = 0; j < Width; j++) {
+                const Narrow sx = Narrow::from_raw_value(na[j]);
+                const Narrow sy = Narrow::from_raw_value(nb[j]);
+                expect("int16 +", j, add[j].raw_value(),
+                       (sx + sy).raw_value(), na[j], nb[j]);
+                expect("int16 -", j, sub[j].raw_value(),
+                       (sx - sy).raw_value(), na[j], nb[j]);
+                expect("int16 *", j, mul[j].raw_value(),
+                       (sx * sy).raw_value(), na[j], nb[j]);
+                expect("int16 neg", j, neg[j].raw_value(), (-sx).raw_value(),
+                       na[j], 0);
+                expect("int16 to int32", j, wide[j].raw_value(),
+                       Wide(sx).raw_value(), na[j], 0);
+            }
+        }
+    }
+    return failed;
+}
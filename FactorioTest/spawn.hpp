@@ -0,0 +1,105 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+
+#include "headers.hpp"
+#include "rng.hpp"
+
+// New asteroids are drawn this many at a time into SoA buffers, then
+// scattered into the holes.
+struct SpawnBatch {
+    static constexpr uint32_t SIZE = 256;
+
+    uint32_t state[SIZE];
+    fixed_20_11 position_x[SIZE];
+    fixed_20_11 position_y[SIZE];
+    fixed_4_11 velocity_x[SIZE];
+    fixed_4_11 velocity_y[SIZE];
+
+    AsteroidColumns columns() {
+        return {state, position_x, position_y, velocity_x, velocity_y};
+    }
+};
+
+// Spawns come from the philox RNG_SPAWN stream, the n-th asteroid spawned
+// under a seed is always the same one.
+struct PhiloxSpawn {
+    SpawnBox box;
+    uint32_t seed;
+    // spawned so far, persists between calls
+    uint64_t& counter;
+
+    void draw(uint32_t n, SpawnBatch& out) {
+        generate_asteroids(box, seed, RNG_SPAWN, counter, n, out.columns());
+        counter += n;
+    }
+};
+
+// Respawns up to count removed asteroids below end, lowest slots first, and
+// returns how many it placed. Holes come from the removal bitmap, so the
+// cost follows count rather than the array size. The gap an incremental
+// sweep is leaving behind is not a hole, it gets cut off on the interval
+// tick.
+template <typename Dist>
+static inline uint32_t spawn_batch(AsteroidStrideArray& asteroids,
+                                   uint32_t count, Dist& dist,
+                                   size_t end = SIZE_MAX) {
+    end = std::min(end, asteroids.size());
+    const auto& c = asteroids.compaction;
+    size_t gap_begin = end, gap_end = end;
+    if (c.mode == CompactionMode::Incremental && c.write < c.read) {
+        gap_begin = std::min<size_t>(c.write, end);
+        gap_end = std::min<size_t>(c.read, end);
+    }
+
+    SpawnBatch batch;
+    uint32_t slots[SpawnBatch::SIZE];
+    size_t next = 0;
+    uint32_t spawned = 0;
+    while (spawned < count) {
+        if (next >= gap_begin && next < gap_end) next = gap_end;
+        uint32_t n = asteroids.dead_slots.take(
+            std::min(count - spawned, SpawnBatch::SIZE), next,
+            next < gap_begin ? gap_begin : end, slots);
+        if (!n) {
+            if (next < end) continue;
+            break;
+        }
+
+        dist.draw(n, batch);
+        for (uint32_t k = 0; k < n; k++) {
+            auto i = slots[k];
+            asteroids.state[i] = batch.state[k];
+            asteroids.position_x[i] = batch.position_x[k];
+            asteroids.position_y[i] = batch.position_y[k];
+            asteroids.velocity_x[i] = batch.velocity_x[k];
+            asteroids.velocity_y[i] = batch.velocity_y[k];
+            if (!asteroids.sleep.empty()) asteroids.sleep[i] = 0;
+        }
+        spawned += n;
+    }
+    return spawned;
+}
+
+// Recycle mode: a removed asteroid is replaced in the same slot during the
+// update pass. The new one comes from the RNG_RECYCLE stream at index
+// (generation, slot), so the scalar and AVX2 kernels agree on it.
+struct RecycleConfig {
+    SpawnBox box;
+    uint32_t seed = 0;
+    // bumped by the kernel every tick
+    uint32_t generation = 0;
+    uint64_t recycled = 0;
+
+    uint64_t index(uint32_t slot) const {
+        return (uint64_t(generation) << 32) | slot;
+    }
+};
+
+static inline void recycle_slot(AsteroidStrideArray& asteroids,
+                                RecycleConfig& recycle, uint32_t i) {
+    generate_asteroids_scalar(recycle.box, recycle.seed, RNG_RECYCLE,
+                              recycle.index(i), 1,
+                              columns_of(asteroids).offset(i));
+    recycle.recycled++;
+}
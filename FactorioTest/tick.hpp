@@ -0,0 +1,1124 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "blocks.hpp"
+#include "compaction.hpp"
+#include "fpm/simd.hpp"
+#include "map.hpp"
+#include "rng.hpp"
+#include "spawn.hpp"
+
+// One update pass for every layout and instruction set,
+// tick_asteroids<Simd, Layout, Compaction, Collision, MapT>:
+//
+// Simd is ScalarSimd below, Avx2Simd in avx2.cpp or Avx512Simd in
+// avx512.cpp, each compiled with its own /arch. A step covers LANES
+// asteroids, I32 holds one int32 per lane and Mask one compare result per
+// lane.
+// Layout is AosLayout, SoaLayout or AosoaLayout<W>: how a step's lanes are
+// loaded and stored, and how one asteroid is moved.
+// Compaction is InPlaceCompaction, moving the survivors down during the
+// pass like the AoS kernels always did, or DeferredCompaction, flagging the
+// removed ones in the layout's DeadSlotMap and leaving them to its sweep.
+// Collision is ChunkCollision, through the chunk index like Map::set,
+// FlatCollision, one bitmap over the whole grid, SpanCollision, the runs of
+// set tiles on each row, QuadCollision, the masks as uniform or stored 8x8
+// sub-blocks, RadiusCollision, the chunk lookup in masks dilated by the
+// asteroid's radius, SweptCollision, every tile on the way from the old
+// position to the new one, or SleepCollision, the chunk lookup skipped while
+// Map::distance says no lane can reach a tile.
+// MapT is the chunk size and grid, Map (32, dense) unless the kernel asks
+// for BasicMap<16>, BasicMap<64> or the superchunk blocks of SparseMap.
+//
+// TICK_KERNELS_* at the bottom lists every instantiation. The backend's
+// translation unit instantiates its list and main.cpp registers them all as
+// benchmark kernels.
+
+struct ScalarSimd {
+    static constexpr uint32_t LANES = 1;
+    using I32 = int32_t;
+    using Mask = bool;
+
+    static I32 set1(int32_t v) { return v; }
+    static I32 load(const fixed_20_11* p) { return p->raw_value(); }
+    static I32 load(const fixed_4_11* p) { return p->raw_value(); }
+    static I32 load(const uint32_t* p) { return int32_t(*p); }
+    static void store(fixed_20_11* p, I32 v) {
+        *p = fixed_20_11::from_raw_value(v);
+    }
+
+    static I32 add(I32 a, I32 b) { return a + b; }
+    static I32 sub(I32 a, I32 b) { return a - b; }
+    static I32 mullo(I32 a, I32 b) { return a * b; }
+    static I32 min(I32 a, I32 b) { return std::min(a, b); }
+    static I32 max(I32 a, I32 b) { return std::max(a, b); }
+    static I32 and_(I32 a, I32 b) { return a & b; }
+    template <int N>
+    static I32 srai(I32 a) {
+        return a >> N;
+    }
+    template <int N>
+    static I32 slli(I32 a) {
+        return int32_t(uint32_t(a) << N);
+    }
+    // a >> n, shifting in zeros, and a << n, for 0 <= n < 32
+    static I32 srlv(I32 a, I32 n) { return int32_t(uint32_t(a) >> n); }
+    static I32 sllv(I32 a, I32 n) { return int32_t(uint32_t(a) << n); }
+
+    static Mask gt(I32 a, I32 b) { return a > b; }
+    static Mask or_(Mask a, Mask b) { return a | b; }
+    // b and not a
+    static Mask andnot(Mask a, Mask b) { return !a & b; }
+    static uint32_t bits(Mask m) { return m; }
+
+    // dx * vx + dy * vy > 0, in 64 bits
+    static Mask dot_gt0(I32 dx, I32 dy, I32 vx, I32 vy) {
+        return int64_t(dx) * vx + int64_t(dy) * vy > 0;
+    }
+    static I32 gather(const int32_t* base, I32 index) { return base[index]; }
+    // bit `bit` of word
+    static Mask test_bit(I32 word, I32 bit) {
+        return (uint32_t(word) >> bit) & 1;
+    }
+    // a / b rounded down, for 0 <= a and 0 < b below 2^24
+    static I32 quotient(I32 a, I32 b) { return a / b; }
+    // the same for any 0 <= a
+    static I32 quotient_wide(I32 a, I32 b) { return a / b; }
+
+    // AoS records: positions, velocity x | y << 16 in v, and what store_records
+    // needs to write them back unchanged in pad
+    static void load_records(const AsteroidFixed* r, I32& px, I32& py, I32& v,
+                             I32& pad) {
+        px = r->position.x.raw_value();
+        py = r->position.y.raw_value();
+        memcpy(&v, &r->velocity, 4);
+        pad = 0;
+    }
+    static void store_records(AsteroidFixed* r, I32 px, I32 py, I32, I32) {
+        r->position = {fixed_20_11::from_raw_value(px),
+                       fixed_20_11::from_raw_value(py)};
+    }
+    static I32 low16(I32 v) { return int16_t(v); }
+    static I32 high16(I32 v) { return v >> 16; }
+
+    static void generate(const SpawnBox& box, uint32_t seed, uint32_t stream,
+                         uint64_t first, uint32_t n,
+                         const AsteroidColumns& out) {
+        generate_asteroids_scalar(box, seed, stream, first, n, out);
+    }
+};
+
+struct Avx2Simd;
+struct Avx512Simd;
+
+// vector<AsteroidFixed>: the 32 byte records as they are, see load_records.
+// A short last step goes through a padded copy.
+struct AosLayout {
+    using Store = vector<AsteroidFixed>;
+    static constexpr bool FLAGS = false;
+    static constexpr bool RECYCLE = false;
+    static constexpr uint32_t BYTES = 32 + 32;
+
+    template <typename Simd>
+    struct Step {
+        using I32 = typename Simd::I32;
+        AsteroidFixed* out;
+        AsteroidFixed* records;
+        uint32_t n;
+        AsteroidFixed tail[Simd::LANES];
+        I32 px, py, vx, vy, v, pad;
+
+        Step(Store& s, uint32_t i, uint32_t n)
+            : out(s.data() + i), records(out), n(n) {
+            if (n < Simd::LANES) {
+                memset(tail, 0, sizeof(tail));
+                memcpy(tail, out, n * sizeof(AsteroidFixed));
+                records = tail;
+            }
+            Simd::load_records(records, px, py, v, pad);
+            vx = Simd::low16(v);
+            vy = Simd::high16(v);
+        }
+
+        void store(I32 new_px, I32 new_py) {
+            Simd::store_records(records, new_px, new_py, v, pad);
+            if (records != out) memcpy(out, records, n * sizeof(AsteroidFixed));
+        }
+    };
+
+    static void move(Store& s, uint32_t to, uint32_t from) {
+        memcpy(&s[to], &s[from], sizeof(AsteroidFixed));
+    }
+    static void truncate(Store& s, uint32_t n) { s.resize(n); }
+};
+
+// AsteroidStrideArray. The columns are padded to 64, so a step can run past
+// the size.
+struct SoaLayout {
+    using Store = AsteroidStrideArray;
+    static constexpr bool FLAGS = true;
+    static constexpr bool RECYCLE = true;
+    static constexpr uint32_t BYTES = 12 + 8;
+
+    template <typename Simd>
+    struct Step {
+        using I32 = typename Simd::I32;
+        fixed_20_11* x;
+        fixed_20_11* y;
+        I32 px, py, vx, vy;
+
+        Step(Store& s, uint32_t i, uint32_t)
+            : x(s.position_x.data() + i),
+              y(s.position_y.data() + i),
+              px(Simd::load(x)),
+              py(Simd::load(y)),
+              vx(Simd::load(s.velocity_x.data() + i)),
+              vy(Simd::load(s.velocity_y.data() + i)) {}
+
+        void store(I32 new_px, I32 new_py) {
+            Simd::store(x, new_px);
+            Simd::store(y, new_py);
+        }
+    };
+
+    static void move(Store& s, uint32_t to, uint32_t from) {
+        s.state[to] = s.state[from];
+        s.position_x[to] = s.position_x[from];
+        s.position_y[to] = s.position_y[from];
+        s.velocity_x[to] = s.velocity_x[from];
+        s.velocity_y[to] = s.velocity_y[from];
+    }
+    static void truncate(Store& s, uint32_t n) {
+        s.resize(n);
+        s.dead_slots.clear();
+    }
+    static void settle(Store& s, uint32_t dead) { compact_asteroids(s, dead); }
+
+    // Respawns the dead lanes of the step at i in place: all lanes are drawn
+    // at recycle->index(i), so every backend agrees on them.
+    template <typename Simd>
+    static void recycle(Store& s, uint32_t i, uint32_t dead_lanes) {
+        auto r = s.recycle;
+        uint32_t state[Simd::LANES];
+        fixed_20_11 x[Simd::LANES], y[Simd::LANES];
+        fixed_4_11 vx[Simd::LANES], vy[Simd::LANES];
+        Simd::generate(r->box, r->seed, RNG_RECYCLE, r->index(i), Simd::LANES,
+                       {state, x, y, vx, vy});
+        for (uint32_t m = dead_lanes; m; m &= m - 1) {
+            uint32_t j = std::countr_zero(m);
+            s.state[i + j] = state[j];
+            s.position_x[i + j] = x[j];
+            s.position_y[i + j] = y[j];
+            s.velocity_x[i + j] = vx[j];
+            s.velocity_y[i + j] = vy[j];
+            if (!s.sleep.empty()) s.sleep[i + j] = 0;
+        }
+        r->recycled += std::popcount(dead_lanes);
+    }
+};
+
+// AsteroidBlockArray<W>, a step is all or part of one block.
+template <uint32_t W>
+struct AosoaLayout {
+    using Store = AsteroidBlockArray<W>;
+    static constexpr bool FLAGS = true;
+    static constexpr bool RECYCLE = false;
+    // state shares the cache lines
+    static constexpr uint32_t BYTES = 16 + 16;
+
+    template <typename Simd>
+    struct Step {
+        static_assert(W % Simd::LANES == 0, "a step stays in one block");
+        using I32 = typename Simd::I32;
+        fixed_20_11* x;
+        fixed_20_11* y;
+        I32 px, py, vx, vy;
+
+        Step(Store& s, uint32_t i, uint32_t)
+            : x(s.block_of(i).position_x + i % W),
+              y(s.block_of(i).position_y + i % W),
+              px(Simd::load(x)),
+              py(Simd::load(y)),
+              vx(Simd::load(s.block_of(i).velocity_x + i % W)),
+              vy(Simd::load(s.block_of(i).velocity_y + i % W)) {}
+
+        void store(I32 new_px, I32 new_py) {
+            Simd::store(x, new_px);
+            Simd::store(y, new_py);
+        }
+    };
+
+    static void move(Store& s, uint32_t to, uint32_t from) {
+        auto& dst = s.block_of(to);
+        auto& src = s.block_of(from);
+        dst.state[to % W] = src.state[from % W];
+        dst.position_x[to % W] = src.position_x[from % W];
+        dst.position_y[to % W] = src.position_y[from % W];
+        dst.velocity_x[to % W] = src.velocity_x[from % W];
+        dst.velocity_y[to % W] = src.velocity_y[from % W];
+    }
+    static void truncate(Store& s, uint32_t n) {
+        s.resize(n);
+        s.dead_slots.clear();
+    }
+    static void settle(Store& s, uint32_t) { settle_blocks(s); }
+};
+
+struct InPlaceCompaction {};
+struct DeferredCompaction {};
+
+// The map side of a step, everything in raw fixed_20_11.
+template <typename Simd>
+struct TickBounds {
+    using I32 = typename Simd::I32;
+    I32 min_x, max_x, min_y, max_y;
+    I32 center_x, center_y;
+    I32 platform_vel;
+
+    template <typename MapT>
+    TickBounds(const MapT* map, int32_t platform_vel) {
+        const int32_t x0 = (map->platform_bound.left - BORDER) << FRACTION_BITS;
+        const int32_t x1 = (map->platform_bound.right + BORDER)
+                           << FRACTION_BITS;
+        const int32_t y0 = (map->platform_bound.bottom - BORDER)
+                           << FRACTION_BITS;
+        const int32_t y1 = (map->platform_bound.top + BORDER) << FRACTION_BITS;
+        min_x = Simd::set1(x0);
+        max_x = Simd::set1(x1);
+        min_y = Simd::set1(y0);
+        max_y = Simd::set1(y1);
+        center_x = Simd::set1((x0 + x1) / 2);
+        center_y = Simd::set1((y0 + y1) / 2);
+        this->platform_vel = Simd::set1(platform_vel);
+    }
+};
+
+// The chunk's tile index is looked up in the grid, or through its
+// superchunk's block on a SparseMap, then the tile mask a 32 bit word at a
+// time. Rows are CHUNK bits, so a word is part of a 64 tile row, one 32 tile
+// row or two 16 tile rows.
+template <typename Simd, typename MapT = Map>
+struct ChunkCollision {
+    static constexpr bool SLEEP = false;
+    static constexpr bool SIZED = false;
+    static constexpr bool SWEPT = false;
+    using I32 = typename Simd::I32;
+    static constexpr uint32_t CHUNK = MapT::CHUNK_SIZE;
+    static constexpr int SHIFT = int(MapT::CHUNK_SHIFT);
+    static constexpr int SUPER_SHIFT = int(MapT::SUPER_SHIFT);
+    static constexpr int SUPER_CHUNK_SHIFT = int(MapT::SUPER_CHUNK_SHIFT);
+    // log2 of the words in a TileMask
+    static constexpr int TILE_SHIFT = 2 * SHIFT - 5;
+    const int32_t* supers;
+    const int32_t* tile_indices;
+    const int32_t* tile_words;
+    // the grid's first chunk and its width, on a SparseMap its first
+    // superchunk and its width in superchunks
+    I32 ox, oy, gw;
+
+    explicit ChunkCollision(const MapT* map)
+        : supers(reinterpret_cast<const int32_t*>(map->supers.data())),
+          tile_indices(reinterpret_cast<const int32_t*>(map->tiles.data())),
+          tile_words(reinterpret_cast<const int32_t*>(map->tile_data.data())),
+          ox(Simd::set1(MapT::SPARSE_GRID ? map->super_x : map->x_offset)),
+          oy(Simd::set1(MapT::SPARSE_GRID ? map->super_y : map->y_offset)),
+          gw(Simd::set1(int32_t(MapT::SPARSE_GRID ? map->super_w
+                                                  : map->grid_w))) {}
+
+    // SparseMap, block of the superchunk holding tile (x, y)
+    I32 block(I32 x, I32 y) const {
+        using S = Simd;
+        I32 super = S::add(
+            S::sub(S::template srai<SUPER_SHIFT>(x), ox),
+            S::mullo(S::sub(S::template srai<SUPER_SHIFT>(y), oy), gw));
+        return S::gather(supers, super);
+    }
+
+    // slot of the chunk holding tile (x, y) in Map::tiles
+    I32 slot(I32 x, I32 y) const {
+        using S = Simd;
+        if constexpr (!MapT::SPARSE_GRID)
+            return S::add(
+                S::sub(S::template srai<SHIFT>(x), ox),
+                S::mullo(S::sub(S::template srai<SHIFT>(y), oy), gw));
+        const I32 chunks = S::set1(int32_t(MapT::SUPER_CHUNKS - 1));
+        return S::add(
+            S::template slli<2 * SUPER_CHUNK_SHIFT>(block(x, y)),
+            S::add(S::template slli<SUPER_CHUNK_SHIFT>(
+                       S::and_(S::template srai<SHIFT>(y), chunks)),
+                   S::and_(S::template srai<SHIFT>(x), chunks)));
+    }
+
+    // tile index of the chunk holding tile (x, y)
+    I32 tile(I32 x, I32 y) const {
+        return Simd::gather(tile_indices, slot(x, y));
+    }
+
+    // what the lookup reads besides the chunk index, for the report
+    static size_t tile_bytes(const MapT& map) {
+        return map.tile_data.size() * sizeof(typename MapT::TileMask);
+    }
+
+    // x and y in tiles, inside the grid
+    typename Simd::Mask hit(I32 x, I32 y) const {
+        return test(tile_words, tile(x, y), x, y);
+    }
+
+    // bit (x, y) of mask `tile` of the masks at words
+    static typename Simd::Mask test(const int32_t* words, I32 tile, I32 x,
+                                    I32 y) {
+        using S = Simd;
+        const I32 mask = S::set1(int32_t(CHUNK - 1));
+        I32 tx = S::and_(x, mask), ty = S::and_(y, mask);
+        I32 row, bit;
+        if constexpr (CHUNK == 16) {
+            // rows 2k and 2k + 1 share word k
+            row = S::template srai<1>(ty);
+            bit = S::add(S::template slli<4>(S::and_(ty, S::set1(1))), tx);
+        } else if constexpr (CHUNK == 32) {
+            row = ty;
+            bit = tx;
+        } else {
+            row = S::add(S::template slli<1>(ty), S::template srai<5>(tx));
+            bit = S::and_(tx, S::set1(31));
+        }
+        I32 word =
+            S::gather(words, S::add(S::template slli<TILE_SHIFT>(tile), row));
+        return S::test_bit(word, bit);
+    }
+};
+
+// The grid as one bitmap, a row of words per row of tiles, so the lookup is
+// one load instead of two dependent ones. Rebuilt from the chunks when the
+// map's serial moved.
+struct FlatTiles {
+    uint64_t serial = 0;
+    int32_t x0 = 0, y0 = 0;
+    uint32_t row_words = 0;
+    std::vector<int32_t> words;
+
+    template <typename MapT>
+    void build(const MapT& map) {
+        constexpr uint32_t CHUNK = MapT::CHUNK_SIZE;
+        x0 = map.x_offset * int32_t(CHUNK);
+        y0 = map.y_offset * int32_t(CHUNK);
+        row_words = (map.grid_w * CHUNK + 31) / 32;
+        words.assign(size_t(row_words) * map.grid_h * CHUNK, 0);
+        for (uint32_t cy = 0; cy < map.grid_h; cy++)
+            for (uint32_t cx = 0; cx < map.grid_w; cx++) {
+                auto& tile = map.tile_data[map.tile_at(
+                    map.x_offset + int32_t(cx), map.y_offset + int32_t(cy))];
+                for (uint32_t ty = 0; ty < CHUNK; ty++) {
+                    auto* row =
+                        &words[(cy * CHUNK + ty) * size_t(row_words)];
+                    // 16 bits at a time, a chunk starts on a 16 bit boundary
+                    for (uint32_t b = 0; b < CHUNK; b += 16) {
+                        uint32_t x = cx * CHUNK + b;
+                        uint32_t bits = uint32_t(tile.rows[ty] >> b) & 0xFFFF;
+                        row[x >> 5] |= int32_t(bits << (x & 31));
+                    }
+                }
+            }
+        serial = map.serial;
+    }
+};
+
+// one per thread and chunk size, the NUMA workers tick concurrently
+template <typename MapT>
+static inline const FlatTiles& flat_tiles(const MapT* map) {
+    thread_local FlatTiles flat;
+    if (flat.serial != map->serial) flat.build(*map);
+    return flat;
+}
+
+template <typename Simd, typename MapT = Map>
+struct FlatCollision {
+    static constexpr bool SLEEP = false;
+    static constexpr bool SIZED = false;
+    static constexpr bool SWEPT = false;
+    using I32 = typename Simd::I32;
+    const int32_t* words;
+    I32 x0, y0, row_words;
+
+    explicit FlatCollision(const MapT* map) {
+        const auto& flat = flat_tiles(map);
+        words = flat.words.data();
+        x0 = Simd::set1(flat.x0);
+        y0 = Simd::set1(flat.y0);
+        row_words = Simd::set1(int32_t(flat.row_words));
+    }
+
+    static size_t tile_bytes(const MapT& map) {
+        return flat_tiles(&map).words.size() * sizeof(int32_t);
+    }
+
+    typename Simd::Mask hit(I32 x, I32 y) const {
+        using S = Simd;
+        I32 dx = S::sub(x, x0);
+        I32 index = S::add(S::mullo(S::sub(y, y0), row_words),
+                           S::template srai<5>(dx));
+        return S::test_bit(S::gather(words, index), S::and_(dx, S::set1(31)));
+    }
+};
+
+// Map::row_spans: two independent loads per lane instead of the chunk
+// lookup's two dependent ones, and two range compares. A step with a lane
+// on a row of more than two runs goes through ChunkCollision.
+template <typename Simd, typename MapT = Map>
+struct SpanCollision : ChunkCollision<Simd, MapT> {
+    using I32 = typename Simd::I32;
+    const int32_t* spans;
+    I32 x0, y0;
+
+    explicit SpanCollision(const MapT* map)
+        : ChunkCollision<Simd, MapT>(map),
+          spans(map->row_spans.data()),
+          x0(Simd::set1(map->x_offset * int32_t(MapT::CHUNK_SIZE))),
+          y0(Simd::set1(map->y_offset * int32_t(MapT::CHUNK_SIZE))) {}
+
+    typename Simd::Mask hit(I32 x, I32 y) const {
+        using S = Simd;
+        I32 row = S::template slli<1>(S::sub(y, y0));
+        I32 first = S::gather(spans, row);
+        I32 second = S::gather(spans, S::add(row, S::set1(1)));
+        if (S::bits(S::gt(second, S::set1(MapT::COMPLEX_SPAN - 1))))
+            return ChunkCollision<Simd, MapT>::hit(x, y);
+        I32 dx = S::sub(x, x0);
+        // x0 <= dx <= x1
+        auto inside = [&](I32 span) {
+            I32 lo = S::and_(span, S::set1(0xFFFF));
+            I32 hi = S::template srai<16>(span);
+            return S::andnot(S::gt(lo, dx), S::gt(S::add(hi, S::set1(1)), dx));
+        };
+        return S::or_(inside(first), inside(second));
+    }
+};
+
+// The tile masks again with every 8x8 sub-block of a chunk empty, full or
+// stored. A tile index has two words: its descriptor, bit s set if
+// sub-block s (row major, four to a row) is stored and bit 16 + s if it is
+// full, and the end of its stored sub-blocks in `blocks`, which holds them
+// in order at two words each, rows 0-3 and 4-7 a byte per row. A chunk along
+// the platform's edge costs 8 bytes plus 8 per mixed sub-block instead of a
+// 128 byte TileMask. Rebuilt from tile_data when the map's serial moved.
+struct QuadTiles {
+    static constexpr uint32_t SUB = 8;
+    static constexpr uint32_t SUBS = 16;
+    uint64_t serial = 0;
+    std::vector<int32_t> descriptors;
+    std::vector<int32_t> blocks;
+
+    // sub-blocks of 8 tiles are 16 to a chunk of 32
+    void build(const Map& map) {
+        std::vector<bool> unused(map.tile_data.size());
+        for (uint32_t i : map.free_indices) unused[i] = true;
+        descriptors.assign(2 * map.tile_data.size(), 0);
+        blocks.clear();
+        for (size_t i = 0; i < map.tile_data.size(); i++) {
+            const auto& tile = map.tile_data[i];
+            uint32_t desc = 0;
+            for (uint32_t s = 0; s < SUBS && !unused[i]; s++) {
+                const uint32_t x = s % 4 * SUB, y = s / 4 * SUB;
+                uint32_t words[2] = {0, 0};
+                for (uint32_t r = 0; r < SUB; r++)
+                    words[r / 4] |= (tile.rows[y + r] >> x & 0xFF)
+                                    << (r % 4 * 8);
+                if ((words[0] & words[1]) == ~0u) {
+                    desc |= 1u << (SUBS + s);
+                } else if (words[0] | words[1]) {
+                    desc |= 1u << s;
+                    blocks.push_back(int32_t(words[0]));
+                    blocks.push_back(int32_t(words[1]));
+                }
+            }
+            descriptors[2 * i] = int32_t(desc);
+            descriptors[2 * i + 1] = int32_t(blocks.size() / 2);
+        }
+        // an empty one, what a lane on an unstored sub-block after the last
+        // stored one loads
+        blocks.resize(blocks.size() + 2, 0);
+        serial = map.serial;
+    }
+
+    size_t bytes() const {
+        return (descriptors.size() + blocks.size()) * sizeof(int32_t);
+    }
+};
+
+// one per thread, like flat_tiles
+static inline const QuadTiles& quad_tiles(const Map* map) {
+    thread_local QuadTiles quad;
+    if (quad.serial != map->serial) quad.build(*map);
+    return quad;
+}
+
+// QuadTiles after the chunk index: the descriptor and the end of the stored
+// sub-blocks are two loads from one line, then one load of the sub-block,
+// the uniform cases folded into the word without a branch. The stored
+// sub-block's place is the end minus those stored from it on, a popcount.
+template <typename Simd, typename MapT = Map>
+struct QuadCollision : ChunkCollision<Simd, MapT> {
+    static_assert(MapT::CHUNK_SIZE == 32, "16 sub-blocks to a chunk");
+    using I32 = typename Simd::I32;
+    const int32_t* descriptors;
+    const int32_t* blocks;
+
+    explicit QuadCollision(const MapT* map)
+        : ChunkCollision<Simd, MapT>(map),
+          descriptors(quad_tiles(map).descriptors.data()),
+          blocks(quad_tiles(map).blocks.data()) {}
+
+    static size_t tile_bytes(const MapT& map) {
+        return quad_tiles(&map).bytes();
+    }
+
+    // set bits of the low 16
+    static I32 popcount16(I32 v) {
+        using S = Simd;
+        v = S::sub(v, S::and_(S::template srai<1>(v), S::set1(0x5555)));
+        v = S::add(S::and_(v, S::set1(0x3333)),
+                   S::and_(S::template srai<2>(v), S::set1(0x3333)));
+        v = S::and_(S::add(v, S::template srai<4>(v)), S::set1(0x0F0F));
+        return S::and_(S::add(v, S::template srai<8>(v)), S::set1(0x1F));
+    }
+
+    typename Simd::Mask hit(I32 x, I32 y) const {
+        using S = Simd;
+        const I32 one = S::set1(1), zero = S::set1(0);
+        I32 index = S::template slli<1>(this->tile(x, y));
+        I32 desc = S::gather(descriptors, index);
+        I32 end = S::gather(descriptors, S::add(index, one));
+        // sub-block s to bit 0, its full bit to bit 16
+        I32 s = S::add(S::and_(S::template srai<1>(y), S::set1(12)),
+                       S::and_(S::template srai<3>(x), S::set1(3)));
+        I32 d = S::srlv(desc, s);
+        I32 from = popcount16(S::srlv(S::and_(desc, S::set1(0xFFFF)), s));
+        I32 word = S::gather(
+            blocks, S::add(S::template slli<1>(S::sub(end, from)),
+                           S::and_(S::template srai<2>(y), one)));
+        // the word if stored, 0 if empty, all ones if full
+        I32 stored = S::sub(zero, S::and_(d, one));
+        I32 full = S::sub(zero, S::and_(S::template srai<16>(d), one));
+        word = S::add(S::and_(word, stored), full);
+        return S::test_bit(
+            word, S::add(S::template slli<3>(S::and_(y, S::set1(3))),
+                         S::and_(x, S::set1(7))));
+    }
+};
+
+// Sized collision through Map::radius_tiles: the chunk slot as for the
+// point lookup, then the tile index of the lane's layer and a word of its
+// dilated mask, so the loads are ChunkCollision's. The layer comes from
+// the prototype in the state column, which the step loads for it.
+template <typename Simd, typename MapT = Map>
+struct RadiusCollision : ChunkCollision<Simd, MapT> {
+    static constexpr bool SIZED = true;
+    using I32 = typename Simd::I32;
+    static constexpr int LAYER_SHIFT =
+        std::countr_zero(MapT::RADIUS_LAYERS);
+    const int32_t* layer_tiles;
+    const int32_t* layer_words;
+    I32 prototype_layers;
+    // the current step's
+    I32 layer;
+
+    explicit RadiusCollision(const MapT* map)
+        : ChunkCollision<Simd, MapT>(map),
+          layer_tiles(reinterpret_cast<const int32_t*>(map->radius_tiles())),
+          layer_words(
+              reinterpret_cast<const int32_t*>(map->dilation.data.data())),
+          prototype_layers(Simd::set1(int32_t(map->prototype_layers))) {}
+
+    // the layers' tile indices and masks
+    static size_t tile_bytes(const MapT& map) {
+        map.radius_tiles();
+        return map.dilation_bytes();
+    }
+
+    // before the step, the lanes' state
+    void prototypes(I32 state) {
+        using S = Simd;
+        I32 p = S::min(S::template srai<16>(state),
+                       S::set1(int32_t(MapT::MAX_PROTOTYPES - 1)));
+        layer = S::and_(S::srlv(prototype_layers, S::template slli<1>(p)),
+                        S::set1(int32_t(MapT::RADIUS_LAYERS - 1)));
+    }
+
+    typename Simd::Mask hit(I32 x, I32 y) const {
+        using S = Simd;
+        I32 tile = S::gather(
+            layer_tiles,
+            S::add(S::template slli<LAYER_SHIFT>(this->slot(x, y)), layer));
+        return this->test(layer_words, tile, x, y);
+    }
+};
+
+// Every tile the segment from the lane's old position to its new one passes
+// through but the old one, which the last tick tested, so an asteroid
+// faster than a tile per tick cannot cross a thin wall. Only a step with a
+// lane passing through more than its old and new tiles, diagonally or over
+// a tile, takes the slow path, the others are ChunkCollision's lookup of
+// the new tile.
+// The slow path walks the rows the lanes cross, all lanes together, and
+// tests the segment's x span on the row as a bit mask against the row's
+// word of the chunk, and of the next chunk if the span reaches it. The span
+// ends are where the segment crosses the row's edges, a DDA over the raw
+// units keeping t * |dx| / |dy| as quotient and remainder, so they are
+// exact but conservative at tile corners: a segment crossing a row edge
+// right at a corner also counts the tile on the far side of the corner,
+// which it only touches. main.cpp's reference allows for that. Both ends
+// are clamped to the bounds like the point lookup's: a tick moves less
+// than BORDER tiles, so a segment with an end outside them never reaches a
+// set tile either way.
+template <typename Simd, typename MapT = Map>
+struct SweptCollision : ChunkCollision<Simd, MapT> {
+    static constexpr bool SWEPT = true;
+    using I32 = typename Simd::I32;
+    static_assert(MapT::CHUNK_SIZE == 32, "a chunk row is one word");
+    // the current step's old position
+    I32 start_x, start_y;
+
+    explicit SweptCollision(const MapT* map)
+        : ChunkCollision<Simd, MapT>(map) {}
+
+    // before the step, the lanes' positions
+    void from(I32 px, I32 py) {
+        start_x = px;
+        start_y = py;
+    }
+
+    // end_x and end_y raw, clamped to the bounds
+    typename Simd::Mask sweep(const TickBounds<Simd>& b, I32 end_x,
+                              I32 end_y) const {
+        using S = Simd;
+        constexpr int F = FRACTION_BITS;
+        const I32 zero = S::set1(0);
+        const I32 tx1 = S::template srai<F>(end_x);
+        const I32 ty1 = S::template srai<F>(end_y);
+        // the old position unclamped, a lane coming in from outside the
+        // bounds may take the slow path for nothing
+        const I32 tx = S::sub(tx1, S::template srai<F>(start_x));
+        const I32 ty = S::sub(ty1, S::template srai<F>(start_y));
+        const I32 moved = S::add(S::max(tx, S::sub(zero, tx)),
+                           S::max(ty, S::sub(zero, ty)));
+        if (!S::bits(S::gt(moved, S::set1(1)))) return this->hit(tx1, ty1);
+        return walk(b, end_x, end_y);
+    }
+
+    // the slow path, out of line to keep the pass's loop small
+    NOINLINE typename Simd::Mask walk(const TickBounds<Simd>& b, I32 end_x,
+                                      I32 end_y) const {
+        using S = Simd;
+        constexpr int F = FRACTION_BITS;
+        const I32 zero = S::set1(0), one = S::set1(1), ones = S::set1(-1);
+        auto abs = [&](I32 v) { return S::max(v, S::sub(zero, v)); };
+        const I32 x0 = S::max(b.min_x, S::min(start_x, b.max_x));
+        const I32 y0 = S::max(b.min_y, S::min(start_y, b.max_y));
+        const I32 rows =
+            abs(S::sub(S::template srai<F>(end_y), S::template srai<F>(y0)));
+        const I32 moved = S::add(
+            abs(S::sub(S::template srai<F>(end_x), S::template srai<F>(x0))),
+            rows);
+        const I32 dx = S::sub(end_x, x0), dy = S::sub(end_y, y0);
+        // -1 or 1, 1 for 0
+        auto sign = [&](I32 v) {
+            return S::add(S::template slli<1>(S::template srai<31>(v)), one);
+        };
+        const I32 sx = sign(dx), sy = sign(dy);
+        const I32 left_x = S::template srai<31>(dx);
+        const I32 ax = abs(dx), ay = S::max(abs(dy), one);
+        // t, the raw distance along y, of the first row edge: 2048 - f up,
+        // f down, f being y0 within its tile
+        const I32 f = S::and_(y0, S::set1((1 << F) - 1));
+        const I32 first = S::add(
+            S::sub(S::set1(1 << F), f),
+            S::and_(S::template srai<31>(dy),
+                    S::sub(S::template slli<1>(f), S::set1(1 << F))));
+        // x offset at the next row edge, t * ax / ay rounded down, and the
+        // remainder, and what the next row adds to them
+        I32 a = S::mullo(first, ax);
+        I32 q = S::quotient_wide(a, ay);
+        I32 r = S::sub(a, S::mullo(q, ay));
+        a = S::template slli<F>(ax);
+        const I32 step_q = S::quotient_wide(a, ay);
+        const I32 step_r = S::sub(a, S::mullo(step_q, ay));
+        // the old tile is left out of row 0's span, unless it is the new one
+        const I32 gone = S::template srai<31>(S::sub(zero, moved));
+        I32 skip_lo = S::and_(S::template srai<1>(S::add(sx, one)), gone);
+        I32 skip_hi = S::and_(S::sub(one, skip_lo), gone);
+
+        I32 lo = zero;
+        typename Simd::Mask hit = S::gt(zero, zero);
+        for (int32_t k = 0;; k++) {
+            const I32 kk = S::set1(k);
+            // rounded away from x0, so x is rounded down, when going left
+            const I32 hi = S::min(
+                S::sub(q, S::and_(left_x, S::template srai<31>(
+                                              S::sub(zero, r)))),
+                ax);
+            const I32 ca = S::template srai<F>(S::add(x0, S::mullo(sx, lo)));
+            const I32 cb = S::template srai<F>(S::add(x0, S::mullo(sx, hi)));
+            const I32 c0 = S::add(S::min(ca, cb), skip_lo);
+            const I32 c1 = S::sub(S::max(ca, cb), skip_hi);
+            const I32 row = S::add(S::template srai<F>(y0),
+                                   S::mullo(sy, S::min(kk, rows)));
+            // all ones for a lane with a span left on this row
+            const I32 live = S::and_(
+                S::template srai<31>(S::sub(c0, S::add(c1, one))),
+                S::template srai<31>(S::sub(kk, S::add(rows, one))));
+
+            const I32 bit0 = S::and_(c0, S::set1(31));
+            const I32 bit1 =
+                S::max(S::min(S::add(S::sub(c1, c0), bit0), S::set1(31)), zero);
+            const I32 mask = S::and_(
+                live, S::and_(S::sllv(ones, bit0),
+                              S::srlv(ones, S::sub(S::set1(31), bit1))));
+            // looked up inside [ca, cb] even for an empty span
+            const I32 x = S::min(c0, S::max(ca, cb));
+            I32 word = S::gather(
+                this->tile_words,
+                S::add(S::template slli<5>(this->tile(x, row)),
+                       S::and_(row, S::set1(31))));
+            word = S::and_(word, mask);
+            hit = S::or_(hit, S::or_(S::gt(word, zero), S::gt(zero, word)));
+
+            // the span running into the next chunk
+            const I32 next = S::sub(S::template srai<5>(c0),
+                                    S::template srai<5>(c1));
+            if (S::bits(S::gt(zero, next))) {
+                const I32 mask1 = S::and_(
+                    S::and_(live, S::template srai<31>(next)),
+                    S::srlv(ones, S::sub(S::set1(31),
+                                         S::and_(c1, S::set1(31)))));
+                I32 word1 = S::gather(
+                    this->tile_words,
+                    S::add(S::template slli<5>(
+                               this->tile(S::max(c1, S::min(ca, cb)), row)),
+                           S::and_(row, S::set1(31))));
+                word1 = S::and_(word1, mask1);
+                hit = S::or_(hit,
+                             S::or_(S::gt(word1, zero), S::gt(zero, word1)));
+            }
+
+            if (!S::bits(S::gt(rows, kk))) return hit;
+            skip_lo = skip_hi = zero;
+            lo = hi;
+            q = S::add(q, step_q);
+            r = S::add(r, step_r);
+            // carry the remainder, all ones if r >= ay
+            const I32 carry = S::template srai<31>(S::sub(S::sub(ay, one), r));
+            q = S::sub(q, carry);
+            r = S::sub(r, S::and_(carry, ay));
+        }
+    }
+};
+
+// ChunkCollision, skipping the lookup for a step whose lanes all sleep.
+// A lane's counter is how many more ticks it cannot reach a set tile: it is
+// at least Map::distance tiles from one and moves at most max(|vx|, |vy +
+// platform|) per tick along either axis (clamping to the bounds only
+// shortens that), so it stays clear for (distance - 1) tiles of travel.
+// The counters start over when the map or the platform velocity changes and
+// for every asteroid spawned into a slot, so the removals are exactly
+// ChunkCollision's.
+template <typename Simd, typename MapT = Map>
+struct SleepCollision : ChunkCollision<Simd, MapT> {
+    static constexpr bool SLEEP = true;
+    using I32 = typename Simd::I32;
+    using Counter = fpm::int_batch<Simd::LANES>;
+    static constexpr int CELL_SHIFT = int(MapT::CELL_SHIFT);
+    static constexpr int SUPER_CELL_SHIFT = int(MapT::SUPER_CELL_SHIFT);
+    const int32_t* distance;
+    // the grid's first cell and its width in cells, for a dense Map
+    I32 cx, cy, cw;
+    int16_t* counters = nullptr;
+    int32_t platform_vel = 0;
+    // the current step's
+    int16_t* step_counters = nullptr;
+    Counter speed;
+
+    explicit SleepCollision(const MapT* map)
+        : ChunkCollision<Simd, MapT>(map),
+          distance(map->distance.data()),
+          cx(Simd::set1(map->x_offset * int32_t(MapT::CELLS))),
+          cy(Simd::set1(map->y_offset * int32_t(MapT::CELLS))),
+          cw(Simd::set1(int32_t(map->distance_w))) {}
+
+    // slot of the cell holding tile (x, y) in Map::distance
+    I32 cell(I32 x, I32 y) const {
+        using S = Simd;
+        if constexpr (!MapT::SPARSE_GRID)
+            return S::add(
+                S::sub(S::template srai<CELL_SHIFT>(x), cx),
+                S::mullo(S::sub(S::template srai<CELL_SHIFT>(y), cy), cw));
+        const I32 cells = S::set1(int32_t(MapT::SUPER_CELLS - 1));
+        return S::add(
+            S::template slli<2 * SUPER_CELL_SHIFT>(this->block(x, y)),
+            S::add(S::template slli<SUPER_CELL_SHIFT>(
+                       S::and_(S::template srai<CELL_SHIFT>(y), cells)),
+                   S::and_(S::template srai<CELL_SHIFT>(x), cells)));
+    }
+
+    // before the pass
+    void begin(AsteroidStrideArray& s, uint64_t serial, int32_t vel) {
+        if (s.sleep.size() < s.capacity) s.sleep.resize(s.capacity);
+        if (s.sleep_serial != serial || s.sleep_platform_vel != vel) {
+            std::fill(s.sleep.begin(), s.sleep.end(), int16_t(0));
+            s.sleep_serial = serial;
+            s.sleep_platform_vel = vel;
+        }
+        counters = s.sleep.data();
+        platform_vel = vel;
+    }
+
+    // before the step at i, vy without the platform velocity
+    void at(uint32_t i, I32 vx, I32 vy) {
+        const Counter x(vx), y = Counter(vy) + platform_vel;
+        step_counters = counters + i;
+        speed = max(max(x, -x), max(y, -y));
+    }
+
+    typename Simd::Mask hit(I32 x, I32 y) const {
+        using S = Simd;
+        Counter sleep = Counter::load(step_counters);
+        if ((sleep > 0) == Counter::all_lanes) {
+            (sleep - 1).store(step_counters);
+            return S::gt(x, x);
+        }
+        const Counter d = S::gather(distance, cell(x, y));
+        const Counter budget = max(d - 1, 0) << FRACTION_BITS;
+        const Counter ticks =
+            S::quotient(budget.native(), max(speed, 1).native());
+        min(ticks, INT16_MAX).store(step_counters);
+        return ChunkCollision<Simd, MapT>::hit(x, y);
+    }
+
+    // Removed lanes must not keep their step awake until the sweep. Whatever
+    // takes the slot, spawn or recycle, resets it.
+    void forget(uint32_t i, uint32_t lanes) {
+        for (; lanes; lanes &= lanes - 1)
+            counters[i + std::countr_zero(lanes)] = INT16_MAX;
+    }
+};
+
+// Bit j set if lane j hit a tile, or is out of bounds and not flying back
+// in. vy without the platform velocity.
+template <typename Simd, typename Collision>
+static inline uint32_t removed_lanes(const TickBounds<Simd>& b,
+                                     const Collision& collision,
+                                     typename Simd::I32 new_px,
+                                     typename Simd::I32 new_py,
+                                     typename Simd::I32 vx,
+                                     typename Simd::I32 vy) {
+    using S = Simd;
+    using I32 = typename Simd::I32;
+    auto clamped =
+        S::or_(S::or_(S::gt(b.min_x, new_px), S::gt(new_px, b.max_x)),
+               S::or_(S::gt(b.min_y, new_py), S::gt(new_py, b.max_y)));
+    I32 end_x = S::max(b.min_x, S::min(new_px, b.max_x));
+    I32 end_y = S::max(b.min_y, S::min(new_py, b.max_y));
+    typename Simd::Mask hit;
+    if constexpr (Collision::SWEPT)
+        hit = collision.sweep(b, end_x, end_y);
+    else
+        hit = collision.hit(S::template srai<FRACTION_BITS>(end_x),
+                            S::template srai<FRACTION_BITS>(end_y));
+
+    I32 dx = S::template srai<FRACTION_BITS>(S::sub(b.center_x, new_px));
+    I32 dy = S::template srai<FRACTION_BITS>(S::sub(b.center_y, new_py));
+    auto approaching = S::dot_gt0(dx, dy, vx, S::add(vy, b.platform_vel));
+
+    return S::bits(S::or_(hit, S::andnot(approaching, clamped)));
+}
+
+template <typename Simd, typename Layout, typename Compaction,
+          template <typename, typename> class Collision, typename MapT = Map>
+NOINLINE void tick_asteroids(typename Layout::Store& asteroids,
+                             const MapT* map, double platform_vel_double) {
+    using I32 = typename Simd::I32;
+    constexpr uint32_t N = Simd::LANES;
+    constexpr bool IN_PLACE = std::is_same_v<Compaction, InPlaceCompaction>;
+    static_assert(IN_PLACE || Layout::FLAGS, "deferred needs a DeadSlotMap");
+
+    // the lanes as the fixed point numbers of AsteroidFixed
+    using Position = fpm::fixed_batch<int32_t, int64_t, FRACTION_BITS, N>;
+    using Velocity = fpm::fixed_batch<int16_t, int32_t, FRACTION_BITS, N>;
+
+    const fixed_20_11 platform_vel_fixed(platform_vel_double);
+    const Position platform_vel(platform_vel_fixed);
+    const TickBounds<Simd> bounds(map, platform_vel_fixed.raw_value());
+    Collision<Simd, MapT> collision(map);
+    constexpr bool SLEEP = Collision<Simd, MapT>::SLEEP;
+    static_assert(!SLEEP || (std::is_same_v<Layout, SoaLayout> && !IN_PLACE),
+                  "the sleep counters only move with the stride sweep");
+    if constexpr (SLEEP)
+        collision.begin(asteroids, map->serial, platform_vel_fixed.raw_value());
+    constexpr bool SIZED = Collision<Simd, MapT>::SIZED;
+    static_assert(!SIZED || std::is_same_v<Layout, SoaLayout>,
+                  "the prototype comes from the state column");
+    RecycleConfig* recycle = nullptr;
+    if constexpr (Layout::RECYCLE) recycle = asteroids.recycle;
+
+    const uint32_t end = uint32_t(asteroids.size());
+    uint32_t write_index = 0;
+    uint32_t dead = 0;
+    uint64_t dead_bits = 0;
+    uint64_t removed = 0;
+
+    PROFILE_BEGIN(Phase::Update);
+    for (uint32_t i = 0; i < end; i += N) {
+        const uint32_t n = std::min(end - i, N);
+        const uint32_t lanes = (1u << n) - 1;
+        typename Layout::template Step<Simd> step(asteroids, i, n);
+        if constexpr (SLEEP) collision.at(i, step.vx, step.vy);
+        if constexpr (SIZED)
+            collision.prototypes(Simd::load(asteroids.state.data() + i));
+        if constexpr (Collision<Simd, MapT>::SWEPT)
+            collision.from(step.px, step.py);
+
+        const Position x = Position::from_raw_value(step.px) +
+                           Position(Velocity::from_raw_value(step.vx));
+        const Position y = Position::from_raw_value(step.py) +
+                           Position(Velocity::from_raw_value(step.vy)) +
+                           platform_vel;
+        I32 new_px = x.raw_value().native();
+        I32 new_py = y.raw_value().native();
+        uint32_t dead_lanes = removed_lanes(bounds, collision, new_px, new_py,
+                                            step.vx, step.vy);
+        if constexpr (Layout::FLAGS) {
+            // removal flags come in a word at a time
+            if (!(i & 63)) removed = asteroids.dead_slots.words[i >> 6];
+            dead_lanes |= uint32_t(removed >> (i & 63));
+        }
+        // don't count the padding past end
+        dead_lanes &= lanes;
+        if constexpr (SLEEP)
+            if (dead_lanes) collision.forget(i, dead_lanes);
+        step.store(new_px, new_py);
+
+        if constexpr (Layout::RECYCLE)
+            if (recycle && dead_lanes) {
+                Layout::template recycle<Simd>(asteroids, i, dead_lanes);
+                dead_lanes = 0;
+            }
+
+        if constexpr (IN_PLACE) {
+            uint32_t live = ~dead_lanes & lanes;
+            if (write_index == i && live == lanes) {
+                write_index += n;
+                continue;
+            }
+            for (; live; live &= live - 1) {
+                uint32_t k = i + std::countr_zero(live);
+                if (write_index != k) Layout::move(asteroids, write_index, k);
+                write_index++;
+            }
+        } else {
+            dead += std::popcount(dead_lanes);
+            dead_bits |= uint64_t(dead_lanes) << (i & 63);
+            if (!((i + N) & 63) || i + N >= end) {
+                asteroids.dead_slots.store(i >> 6, dead_bits);
+                dead_bits = 0;
+            }
+        }
+    }
+    PROFILE_END(Phase::Update);
+
+    if (recycle) {
+        recycle->generation++;
+    } else if constexpr (IN_PLACE) {
+        if (write_index != end) Layout::truncate(asteroids, write_index);
+    } else {
+        Layout::settle(asteroids, dead);
+    }
+}
+
+// Every instantiation, X(name, Simd, Layout, Compaction, Collision, MapT).
+// AoS has no removal bitmap, so it only compacts in place; AVX-512 steps are
+// 16 lanes and only fit 16 lane blocks.
+#define TICK_LAYOUTS(X, SIMD, PREFIX)                                     \
+    X(PREFIX "-aos-inplace-chunk", SIMD, AosLayout, InPlaceCompaction,    \
+      ChunkCollision, Map)                                                \
+    X(PREFIX "-aos-inplace-flat", SIMD, AosLayout, InPlaceCompaction,     \
+      FlatCollision, Map)                                                 \
+    X(PREFIX "-soa-inplace-chunk", SIMD, SoaLayout, InPlaceCompaction,    \
+      ChunkCollision, Map)                                                \
+    X(PREFIX "-soa-inplace-flat", SIMD, SoaLayout, InPlaceCompaction,     \
+      FlatCollision, Map)                                                 \
+    X(PREFIX "-soa-deferred-chunk", SIMD, SoaLayout, DeferredCompaction,  \
+      ChunkCollision, Map)                                                \
+    X(PREFIX "-soa-deferred-flat", SIMD, SoaLayout, DeferredCompaction,   \
+      FlatCollision, Map)                                                 \
+    X(PREFIX "-soa-deferred-sleep", SIMD, SoaLayout, DeferredCompaction,  \
+      SleepCollision, Map)                                                \
+    X(PREFIX "-soa-deferred-span", SIMD, SoaLayout, DeferredCompaction,   \
+      SpanCollision, Map)                                                 \
+    X(PREFIX "-soa-deferred-quad", SIMD, SoaLayout, DeferredCompaction,   \
+      QuadCollision, Map)                                                 \
+    X(PREFIX "-soa-deferred-radius", SIMD, SoaLayout, DeferredCompaction, \
+      RadiusCollision, Map)                                               \
+    X(PREFIX "-soa-deferred-swept", SIMD, SoaLayout, DeferredCompaction,  \
+      SweptCollision, Map)                                                \
+    X(PREFIX "-aosoa16-inplace-chunk", SIMD, AosoaLayout<16>,             \
+      InPlaceCompaction, ChunkCollision, Map)                             \
+    X(PREFIX "-aosoa16-inplace-flat", SIMD, AosoaLayout<16>,              \
+      InPlaceCompaction, FlatCollision, Map)                              \
+    X(PREFIX "-aosoa16-deferred-chunk", SIMD, AosoaLayout<16>,            \
+      DeferredCompaction, ChunkCollision, Map)                            \
+    X(PREFIX "-aosoa16-deferred-flat", SIMD, AosoaLayout<16>,             \
+      DeferredCompaction, FlatCollision, Map)
+
+#define TICK_LAYOUTS_8(X, SIMD, PREFIX)                      \
+    X(PREFIX "-aosoa8-inplace-chunk", SIMD, AosoaLayout<8>,  \
+      InPlaceCompaction, ChunkCollision, Map)                \
+    X(PREFIX "-aosoa8-inplace-flat", SIMD, AosoaLayout<8>,   \
+      InPlaceCompaction, FlatCollision, Map)                 \
+    X(PREFIX "-aosoa8-deferred-chunk", SIMD, AosoaLayout<8>, \
+      DeferredCompaction, ChunkCollision, Map)               \
+    X(PREFIX "-aosoa8-deferred-flat", SIMD, AosoaLayout<8>,  \
+      DeferredCompaction, FlatCollision, Map)
+
+// the chunk sizes besides 32 and the superchunk grid, for the chunk lookup
+// on the stride layout
+#define TICK_CHUNKS(X, SIMD, PREFIX)                                       \
+    X(PREFIX "-soa-deferred-chunk16", SIMD, SoaLayout, DeferredCompaction, \
+      ChunkCollision, BasicMap<16>)                                        \
+    X(PREFIX "-soa-deferred-chunk64", SIMD, SoaLayout, DeferredCompaction, \
+      ChunkCollision, BasicMap<64>)                                        \
+    X(PREFIX "-soa-deferred-sparse", SIMD, SoaLayout, DeferredCompaction,  \
+      ChunkCollision, SparseMap)                                           \
+    X(PREFIX "-soa-deferred-sparse-sleep", SIMD, SoaLayout,                \
+      DeferredCompaction, SleepCollision, SparseMap)
+
+#define TICK_KERNELS_SCALAR(X)              \
+    TICK_LAYOUTS(X, ScalarSimd, "scalar")   \
+    TICK_LAYOUTS_8(X, ScalarSimd, "scalar") \
+    TICK_CHUNKS(X, ScalarSimd, "scalar")
+#define TICK_KERNELS_AVX2(X)            \
+    TICK_LAYOUTS(X, Avx2Simd, "avx2")   \
+    TICK_LAYOUTS_8(X, Avx2Simd, "avx2") \
+    TICK_CHUNKS(X, Avx2Simd, "avx2")
+#define TICK_KERNELS_AVX512(X)            \
+    TICK_LAYOUTS(X, Avx512Simd, "avx512") \
+    TICK_CHUNKS(X, Avx512Simd, "avx512")
+
+// explicit instantiation, for the backend's translation unit
+#define TICK_INSTANTIATE(NAME, SIMD, LAYOUT, COMPACTION, COLLISION, MAP)    \
+    template void tick_asteroids<SIMD, LAYOUT, COMPACTION, COLLISION, MAP>( \
+        LAYOUT::Store&, const MAP*, double);
+
+// everywhere else, main.cpp only sees the backends declared
+#define TICK_EXTERN(NAME, SIMD, LAYOUT, COMPACTION, COLLISION, MAP) \
+    extern template void                                            \
+    tick_asteroids<SIMD, LAYOUT, COMPACTION, COLLISION, MAP>(       \
+        LAYOUT::Store&, const MAP*, double);
+
+TICK_KERNELS_SCALAR(TICK_EXTERN)
+#ifndef __EMSCRIPTEN__
+TICK_KERNELS_AVX2(TICK_EXTERN)
+TICK_KERNELS_AVX512(TICK_EXTERN)
+#endif